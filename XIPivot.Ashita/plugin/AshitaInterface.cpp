@@ -28,7 +28,10 @@
 
 #include "AshitaInterface.h"
 #include "MemCache.h"
+#include "HookTracer.h"
 
+#include <cctype>
+#include <cerrno>
 #include <regex>
 
 #define _XI_RESET    "\x1E\x01"
@@ -60,6 +63,26 @@ static std::vector<std::string> split(const std::string &input, const std::strin
 	return { first, last };
 }
 
+/* parse a plain decimal overlay priority, rejecting signs, whitespace and trailing garbage */
+static bool parsePriority(const std::string &input, size_t &prio)
+{
+	if (input.empty() || isdigit(static_cast<unsigned char>(input[0])) == 0)
+	{
+		return false;
+	}
+
+	char *end = nullptr;
+	errno = 0;
+	const auto value = strtoul(input.c_str(), &end, 10);
+	if (errno == ERANGE || *end != '\0')
+	{
+		return false;
+	}
+
+	prio = value;
+	return true;
+}
+
 namespace XiPivot
 {
 	plugininfo_t *AshitaInterface::s_pluginInfo = nullptr;
@@ -96,7 +119,8 @@ namespace XiPivot
 		m_pluginId = id;
 		m_config = (core ? core->GetConfigurationManager() : nullptr);
 
-		instance().setLogProvider(this);
+		m_asyncLog.start(this);
+		instance().setLogProvider(&m_asyncLog);
 
 		if (m_config != nullptr)
 		{
@@ -113,9 +137,11 @@ namespace XiPivot
 
 				if (m_settings.cacheEnabled)
 				{
-					Core::MemCache::instance().setLogProvider(this);
+					Core::MemCache::instance().setLogProvider(&m_asyncLog);
 					Core::MemCache::instance().setDebugLog(m_settings.debugLog);
 					Core::MemCache::instance().setCacheAllocation(m_settings.cacheSize);
+					Core::MemCache::instance().setCacheMode(m_settings.cacheMapped ? Core::MemCache::CacheMode::Mapped : Core::MemCache::CacheMode::Heap);
+					Core::MemCache::instance().setEvictionPolicy(Core::EvictionPolicy::create(m_settings.cachePolicy));
 
 					if (initialized)
 					{
@@ -129,8 +155,10 @@ namespace XiPivot
 		if (m_settings.cacheEnabled)
 		{
 			initialized &= Core::MemCache::instance().setupHooks();
+			Core::MemCache::instance().setPrefetch(m_settings.cachePrefetch, m_settings.rootPath);
 		}
 		initialized &= instance().setupHooks();
+		instance().prefetchRedirects();
 		return initialized;
 	}
 
@@ -138,9 +166,12 @@ namespace XiPivot
 	{
 		if (m_settings.cacheEnabled)
 		{
+			Core::MemCache::instance().setPrefetch(false, "");
 			Core::MemCache::instance().releaseHooks();
 		}
 		instance().releaseHooks();
+		Core::HookTracer::instance().stop();
+		m_asyncLog.stop();
 	}
 
 	bool AshitaInterface::HandleCommand(const char *command, int32_t /*type*/)
@@ -179,12 +210,48 @@ namespace XiPivot
 						m_settings.save(m_config);
 					}
 				}
+				else if ((args[1] == "t" || args[1] == "telemetry") && args[2] == "reset")
+				{
+					Core::MemCache::instance().resetTelemetry();
+				}
+				else if (args[1] == "trace" && args[2] == "start")
+				{
+					if (Core::HookTracer::instance().start(m_settings.rootPath + "/pivot-hooks.bin") == false)
+					{
+						chatPrintf("$cs(7)failed to start the hook trace.$cr");
+					}
+				}
+				else if (args[1] == "trace" && args[2] == "stop")
+				{
+					Core::HookTracer::instance().stop();
+				}
+			}
+			else if (args.size() == 4 && (args[1] == "m" || args[1] == "move"))
+			{
+				size_t prio = 0;
+				if (parsePriority(args[3], prio) == false)
+				{
+					chatPrintf("$cs(7)invalid priority '$cs(9)%s$cs(7)'.$cr", args[3].c_str());
+				}
+				else if (instance().moveOverlay(args[2], prio))
+				{
+					m_settings.overlays = instance().overlayList();
+					m_settings.save(m_config);
+				}
+				else
+				{
+					chatPrintf("$cs(7)failed to move '$cs(9)%s$cs(7)'.$cr", args[2].c_str());
+				}
 			}
 			else if (args.size() == 2 && (args[1] == "h" || args[1] == "help"))
 			{
 				chatPrintf("$cs(16)%s$cs(19) v.$cs(16)%.2f$cs(19) by $cs(14)%s$cr", s_pluginInfo->Name, s_pluginInfo->PluginVersion, s_pluginInfo->Author);
 				chatPrintf("   $cs(9)a$cs(16)dd overlay_dir $cs(19)- Adds a path to be searched for DAT overlays$cr");
 				chatPrintf("   $cs(9)r$cs(16)emove overlay_dir $cs(19)- Removes a path from the DAT overlays$cr");
+				chatPrintf("   $cs(9)m$cs(16)ove overlay_dir prio $cs(19)- Moves an active overlay to a new priority (0 is the highest)$cr");
+				chatPrintf("   $cs(9)c$cs(16)ache $cs(19)- Toggles the cache statistics overlay$cr");
+				chatPrintf("   $cs(9)t$cs(16)elemetry [reset] $cs(19)- Prints (or resets) cache latencies and the most opened files$cr");
+				chatPrintf("   $cs(16)trace start|stop $cs(19)- Starts or stops the binary trace of all file operations (pivot-hooks.bin)$cr");
 				chatPrintf("   $cs(16)-$cr");
 				chatPrintf("   $cs(19)Adding or removing overlays at runtime can cause $cs(16)all kinds of unexpected behaviour.$cr");
 				chatPrintf("   $cs(19)It is recommended to edit XIPivot.xml instead - $cs(16)you have been warned.$cr");
@@ -193,6 +260,10 @@ namespace XiPivot
 			{
 				m_showCacheWindow = !m_showCacheWindow;
 			}
+			else if (args.size() == 2 && (args[1] == "t" || args[1] == "telemetry") && m_settings.cacheEnabled == true)
+			{
+				dumpCacheTelemetry();
+			}
 			else
 			{
 				m_uiConfig.debugState = m_settings.debugLog;
@@ -201,6 +272,9 @@ namespace XiPivot
 
 				m_uiConfig.applyCacheChanges = false;
 				m_uiConfig.cacheState = m_settings.cacheEnabled;
+				m_uiConfig.cacheMapped = m_settings.cacheMapped;
+				m_uiConfig.cachePrefetch = m_settings.cachePrefetch;
+				m_uiConfig.cacheS3Fifo = m_settings.cachePolicy == "s3fifo";
 				m_uiConfig.cacheSizeMB = m_settings.cacheSize / 0x100000;
 				m_uiConfig.cachePurgeDelay = m_settings.cachePurgeDelay;
 
@@ -240,11 +314,19 @@ namespace XiPivot
 			m_uiConfig.applyCacheChanges = false;
 
 			m_settings.cacheEnabled    = m_uiConfig.cacheState;
+			m_settings.cacheMapped     = m_uiConfig.cacheMapped;
+			m_settings.cachePrefetch   = m_uiConfig.cachePrefetch;
+			m_settings.cachePolicy     = m_uiConfig.cacheS3Fifo ? "s3fifo" : "lru";
 			m_settings.cacheSize       = m_uiConfig.cacheSizeMB * 0x100000; // cacheSize is in bytes internally
 			m_settings.cachePurgeDelay = m_uiConfig.cachePurgeDelay;
 			m_settings.save(m_config);
 
 			Core::MemCache::instance().setCacheAllocation(m_settings.cacheSize);
+			Core::MemCache::instance().setCacheMode(m_settings.cacheMapped ? Core::MemCache::CacheMode::Mapped : Core::MemCache::CacheMode::Heap);
+			if (m_settings.cachePolicy != Core::MemCache::instance().getEvictionPolicy())
+			{
+				Core::MemCache::instance().setEvictionPolicy(Core::EvictionPolicy::create(m_settings.cachePolicy));
+			}
 			if (m_settings.cacheEnabled == true && Core::MemCache::instance().hooksActive() == false)
 			{
 				m_settings.cacheEnabled = Core::MemCache::instance().setupHooks();
@@ -254,6 +336,13 @@ namespace XiPivot
 			{
 				Core::MemCache::instance().releaseHooks();
 			}
+
+			const bool prefetch = m_settings.cacheEnabled && m_settings.cachePrefetch;
+			if (prefetch != Core::MemCache::instance().getPrefetch())
+			{
+				Core::MemCache::instance().setPrefetch(prefetch, m_settings.rootPath);
+				instance().prefetchRedirects();
+			}
 		}
 
 		if (m_settings.cacheEnabled == true)
@@ -313,13 +402,38 @@ namespace XiPivot
 		}
 	}
 
+	void AshitaInterface::dumpCacheTelemetry(void)
+	{
+		const auto telemetry = Core::MemCache::instance().getTelemetry(10);
+
+		chatPrintf("$cs(16)cache telemetry$cr");
+		for (size_t i = 0; i < telemetry.latency.size(); ++i)
+		{
+			const auto& latency = telemetry.latency[i];
+			chatPrintf("   $cs(9)%s$cs(19): %llu, mean %lluus, p50 %lluus, p95 %lluus, p99 %lluus, max %lluus$cr",
+				Core::CacheTelemetry::operationName(static_cast<Core::CacheTelemetry::Operation>(i)), latency.count, latency.meanUs(),
+				latency.percentileUs(0.5), latency.percentileUs(0.95), latency.percentileUs(0.99), latency.maxUs);
+		}
+
+		chatPrintf("   $cs(9)served$cs(19): %.2fmb from cache, %.2fmb from disk$cr", telemetry.bytesFromCache / 1048576.0f, telemetry.bytesFromDisk / 1048576.0f);
+		for (size_t i = 0; i < telemetry.evictions.size(); ++i)
+		{
+			chatPrintf("   $cs(9)evicted (%s)$cs(19): %u$cr", Core::CacheTelemetry::evictReasonName(static_cast<Core::CacheTelemetry::EvictReason>(i)), telemetry.evictions[i]);
+		}
+
+		for (const auto& key : telemetry.topKeys)
+		{
+			chatPrintf("   $cs(9)key %d$cs(19): opened %u times$cr", key.first, key.second);
+		}
+	}
+
 	/* IDelegate */
 	void AshitaInterface::logMessage(Core::IDelegate::LogLevel level, std::string msg)
 	{
-		logMessageF(level, msg);
+		logMessageF(level, "%s", msg.c_str());
 	}
 
-	void AshitaInterface::logMessageF(Core::IDelegate::LogLevel level, std::string msg, ...)
+	void AshitaInterface::logMessageF(Core::IDelegate::LogLevel level, const char* msg, ...)
 	{
 		if (level != Core::IDelegate::LogLevel::Discard)
 		{
@@ -351,7 +465,7 @@ namespace XiPivot
 			va_list args;
 			va_start(args, msg);
 
-			vsnprintf_s(msgBuf, 511, msg.c_str(), args);
+			vsnprintf_s(msgBuf, 511, msg, args);
 			m_logManager->Log(static_cast<uint32_t>(ashitaLevel), "XiPivot", msgBuf);
 
 			va_end(args);
@@ -371,6 +485,9 @@ namespace XiPivot
 		overlays.clear();
 		debugLog = false;
 		cacheEnabled = false;
+		cacheMapped = false;
+		cachePrefetch = false;
+		cachePolicy = "lru";
 		cacheSize = 0;
 		cachePurgeDelay = 600;
 	}
@@ -393,6 +510,11 @@ namespace XiPivot
 			}
 
 			cacheEnabled = config->get_bool("XIPivot", "cache_enabled", false);
+			const char *cM = config->get_string("XIPivot", "cache_mode");
+			cacheMapped = (cM != nullptr && strcmp(cM, "mapped") == 0);
+			cachePrefetch = config->get_bool("XIPivot", "cache_prefetch", false);
+			const char *cP = config->get_string("XIPivot", "cache_policy");
+			cachePolicy = (cP != nullptr && Core::EvictionPolicy::create(cP) != nullptr) ? cP : "lru";
 			cacheSize = config->get_int32("XIPivot", "cache_size", 2048) * 0x100000; // 2gb
 			cachePurgeDelay = config->get_int32("XIPivot", "cache_max_age", 600); // 10min
 
@@ -406,6 +528,9 @@ namespace XiPivot
 		config->set_value("XIPivot", "overlays", join(overlays.begin(), overlays.end(), ",").c_str());
 	
 		config->set_value("XIPivot", "cache_enabled", cacheEnabled ? "true" : "false");
+		config->set_value("XIPivot", "cache_mode", cacheMapped ? "mapped" : "heap");
+		config->set_value("XIPivot", "cache_prefetch", cachePrefetch ? "true" : "false");
+		config->set_value("XIPivot", "cache_policy", cachePolicy.c_str());
 
 		char val[32];
 		snprintf(val, 31, "%u", cacheSize / 0x100000);
@@ -626,6 +751,9 @@ namespace XiPivot
 	void AshitaInterface::renderMemCacheConfigUI(IGuiManager* imgui)
 	{
 		imgui->Checkbox(u8"use cache", &m_uiConfig.cacheState);
+		imgui->Checkbox(u8"memory-mapped files", &m_uiConfig.cacheMapped);
+		imgui->Checkbox(u8"prefetch in background", &m_uiConfig.cachePrefetch);
+		imgui->Checkbox(u8"S3-FIFO eviction", &m_uiConfig.cacheS3Fifo);
 		imgui->SliderInt(u8"reserved size", &m_uiConfig.cacheSizeMB, 1, 4096, "%.0f mb");
 		imgui->SliderInt(u8"purge interval", &m_uiConfig.cachePurgeDelay, 1, 600, "%.0f sec");
 
@@ -638,6 +766,9 @@ namespace XiPivot
 		imgui->TextDisabled(u8"Reducing the cache size will not instantly take effect if the currently");
 		imgui->TextDisabled(u8"used cache size is larger then the new maximum.");
 		imgui->TextDisabled(u8"Cached files that have no open handle will be removed after the purge delay.");
+		imgui->TextDisabled(u8"Memory-mapped files leave caching to Windows instead of keeping a private copy.");
+		imgui->TextDisabled(u8"Prefetching loads overlay DATs and frequently used files while XI is idle.");
+		imgui->TextDisabled(u8"S3-FIFO keeps files XI opens only once from pushing out frequently used ones.");
 
 		if (m_settings.cacheEnabled == true)
 		{
@@ -659,6 +790,23 @@ namespace XiPivot
 		imgui->LabelText(u8"used size", "%.2fmb", stats.used / 1048576.0f);
 		imgui->LabelText(u8"objects", "%d", stats.activeObjects);
 		imgui->LabelText(u8"ignored", "%d", stats.cacheIgnored);
+		imgui->LabelText(u8"evicted", "%d", stats.evictedObjects);
+		imgui->LabelText(u8"compressed", "%d (%.2fmb)", stats.compressedObjects, stats.compressedSize / 1048576.0f);
+		imgui->Separator();
+
+		imgui->LabelText(u8"policy", "%s", stats.policy);
+		imgui->LabelText(u8"policy hits", "%.1f%%", stats.policyHitRatio * 100.0f);
+		imgui->Separator();
+
+		const auto telemetry = Core::MemCache::instance().getTelemetry(0);
+		for (size_t i = 0; i < telemetry.latency.size(); ++i)
+		{
+			const auto& latency = telemetry.latency[i];
+			imgui->LabelText(Core::CacheTelemetry::operationName(static_cast<Core::CacheTelemetry::Operation>(i)), "p50 %lluus p99 %lluus (%llu)",
+				latency.percentileUs(0.5), latency.percentileUs(0.99), latency.count);
+		}
+		imgui->LabelText(u8"from cache", "%.2fmb", telemetry.bytesFromCache / 1048576.0f);
+		imgui->LabelText(u8"from disk", "%.2fmb", telemetry.bytesFromDisk / 1048576.0f);
 		imgui->Separator();
 
 		imgui->LabelText(u8"next purge in", "%ds", m_nextCachePurge - time(nullptr));
@@ -30,6 +30,7 @@
 
 #include "ADK_v3/Ashita.h"
 #include "Redirector.h"
+#include "AsyncDelegate.h"
 
 namespace XiPivot
 {
@@ -55,7 +56,7 @@ namespace XiPivot
 
 		/* IDelegate */
 		void logMessage(Core::IDelegate::LogLevel level, std::string msg);
-		void logMessageF(Core::IDelegate::LogLevel level, std::string msg, ...);
+		void logMessageF(Core::IDelegate::LogLevel level, const char* msg, ...);
 
 	public:
 		static plugininfo_t *s_pluginInfo;
@@ -70,6 +71,9 @@ namespace XiPivot
 		void renderMemCacheConfigUI(IGuiManager* imgui);
 		void renderCacheStatsUI(IGuiManager* imgui);
 
+		/* print the cache telemetry to the chat log */
+		void dumpCacheTelemetry(void);
+
 		std::vector<std::string> listAvailableOverlays() const;
 
 		struct Settings
@@ -84,6 +88,9 @@ namespace XiPivot
 			std::vector<std::string> overlays;
 
 			bool cacheEnabled;
+			bool cacheMapped;
+			bool cachePrefetch;
+			std::string cachePolicy;
 			uint32_t cacheSize;
 			uint32_t cachePurgeDelay;
 		};
@@ -106,6 +113,9 @@ namespace XiPivot
 
 			/* cache */
 			bool                     cacheState;
+			bool                     cacheMapped;
+			bool                     cachePrefetch;
+			bool                     cacheS3Fifo;
 			int32_t                  cacheSizeMB;
 			int32_t                  cachePurgeDelay;
 			bool                     applyCacheChanges;
@@ -118,6 +128,9 @@ namespace XiPivot
 		ILogManager           *m_logManager;
 		IDirect3DDevice8      *m_direct3DDevice;
 		IConfigurationManager *m_config;
+
+		/* Core logs through this, messages reach m_logManager from a background thread */
+		Core::AsyncDelegate    m_asyncLog;
 	};
 }
 
@@ -74,7 +74,8 @@ namespace XiPivot
 			m_ashitaCore = core;
 			m_logManager = log;
 
-			redirector.setLogProvider(this);
+			m_asyncLog.start(this);
+			redirector.setLogProvider(&m_asyncLog);
 
 			// we support only a single argument which is the config file basename and defaults to 'pivot'
 			auto configFileName = std::filesystem::path(m_pluginArgs.at(0)).stem().replace_extension(".ini").string();
@@ -119,6 +120,7 @@ namespace XiPivot
 		void AshitaInterface::Release(void)
 		{
 			Core::Redirector::instance().releaseHooks();
+			m_asyncLog.stop();
 			IPolPlugin::Release();
 		}
 
@@ -171,10 +173,10 @@ namespace XiPivot
 
 		void AshitaInterface::logMessage(Core::IDelegate::LogLevel level, std::string msg)
 		{
-			logMessageF(level, msg);
+			logMessageF(level, "%s", msg.c_str());
 		}
 
-		void AshitaInterface::logMessageF(Core::IDelegate::LogLevel level, std::string msg, ...)
+		void AshitaInterface::logMessageF(Core::IDelegate::LogLevel level, const char* msg, ...)
 		{
 			if (level != Core::IDelegate::LogLevel::Discard)
 			{
@@ -206,7 +208,7 @@ namespace XiPivot
 				va_list args;
 				va_start(args, msg);
 
-				vsnprintf_s(msgBuf, 511, msg.c_str(), args);
+				vsnprintf_s(msgBuf, 511, msg, args);
 				m_logManager->Log(static_cast<uint32_t>(ashitaLevel), GetName(), msgBuf);
 
 				va_end(args);
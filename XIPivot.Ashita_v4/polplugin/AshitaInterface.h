@@ -31,6 +31,7 @@
 #include "ADK_v4/Ashita.h"
 
 #include "Redirector.h"
+#include "AsyncDelegate.h"
 #include "UserInterface.h"
 #include <filesystem>
 
@@ -72,7 +73,7 @@ namespace XiPivot
 
 			/* IDelegate */
 			void logMessage(Core::IDelegate::LogLevel level, std::string msg) override;
-			void logMessageF(Core::IDelegate::LogLevel level, std::string msg, ...) override;
+			void logMessageF(Core::IDelegate::LogLevel level, const char* msg, ...) override;
 
 		protected:
 			virtual bool runFOpenSHook(const char* path) override;
@@ -106,6 +107,9 @@ namespace XiPivot
 			std::filesystem::path    m_settingsPath;
 			Settings                 m_settings;
 			UserInterface            m_ui;
+
+			/* Core logs through this, messages reach m_logManager from a background thread */
+			Core::AsyncDelegate      m_asyncLog;
 		};
 	}
 }
@@ -31,10 +31,32 @@
 #include "AshitaInterface.h"
 #include "Redirector.h"
 
+#include <cctype>
+#include <cerrno>
 #include <fstream>
 
 #define IS_PARAM(arg, abbr, full) if((arg) == (abbr) || (arg) == (full))
 
+/* parse a plain decimal overlay priority, rejecting signs, whitespace and trailing garbage */
+static bool parsePriority(const std::string& input, size_t& prio)
+{
+	if (input.empty() || isdigit(static_cast<unsigned char>(input[0])) == 0)
+	{
+		return false;
+	}
+
+	char* end = nullptr;
+	errno = 0;
+	const auto value = strtoul(input.c_str(), &end, 10);
+	if (errno == ERANGE || *end != '\0')
+	{
+		return false;
+	}
+
+	prio = value;
+	return true;
+}
+
 namespace XiPivot
 {
 	namespace Pol
@@ -68,6 +90,7 @@ namespace XiPivot
 
 						m_guiState.state.addOverlayName.clear();
 						m_guiState.state.deleteOverlayName.clear();
+						m_guiState.state.moveOverlayName.clear();
 						m_guiState.state.applyCLIChanges = false;
 					}
 					break;
@@ -161,6 +184,38 @@ namespace XiPivot
 					}
 					break;
 
+				case 3:
+					IS_PARAM(args.at(0), "m", "move")
+					{
+						const auto& overlayList = Core::Redirector::instance().overlayList();
+						std::ostringstream msg;
+
+						size_t prio = 0;
+
+						msg << Ashita::Chat::Header(PluginCommand);
+						if (std::find(overlayList.begin(), overlayList.end(), args.at(1)) == overlayList.end())
+						{
+							msg << Ashita::Chat::Error("Not an active overlay: ") << Ashita::Chat::Message(args.at(1));
+						}
+						else if (parsePriority(args.at(2), prio) == false || prio >= overlayList.size())
+						{
+							msg << Ashita::Chat::Error("Invalid priority: ") << Ashita::Chat::Message(args.at(2));
+						}
+						else
+						{
+							/* the actual move happens during the next ProcessUI call,
+							 * both the overlay and the priority are validated so it can't fail there */
+							m_guiState.state.moveOverlayName = args.at(1);
+							m_guiState.state.moveOverlayIndex = prio;
+
+							msg << Ashita::Chat::Message(args.at(1)) << ": moving to priority " << Ashita::Chat::Message(args.at(2));
+						}
+						chat->AddChatMessage(1, false, msg.str().c_str());
+						break;
+					}
+					PrintHelp(chat);
+					break;
+
 				default:
 					PrintHelp(chat);
 					break;
@@ -219,6 +274,16 @@ namespace XiPivot
 				settingsChanged = true;
 			}
 
+			if (m_guiState.state.moveOverlayName.empty() == false)
+			{
+				/* reorder overlays - this can be requested by both the CLI and the GUI */
+				if (redirector.moveOverlay(m_guiState.state.moveOverlayName, m_guiState.state.moveOverlayIndex))
+				{
+					settingsChanged = true;
+				}
+				m_guiState.state.moveOverlayName.clear();
+			}
+
 			/* copy the current live cache stats and overlays for RenderUI */
 			m_guiState.constants.activeOverlays = redirector.overlayList();
 		}
@@ -316,6 +381,10 @@ namespace XiPivot
 			msg << Ashita::Chat::Header(PluginCommand) << Ashita::Chat::Color1(0x3, "q")         << "ery <PATH>           - print the overlay <PATH> is redirected to (if any).";
 			chat->AddChatMessage(1, false, msg.str().c_str());
 
+			msg.str("");
+			msg << Ashita::Chat::Header(PluginCommand) << Ashita::Chat::Color1(0x3, "m")         << "ove <OVERLAY> <PRIO> - move an active overlay to priority <PRIO> (0 is the highest).";
+			chat->AddChatMessage(1, false, msg.str().c_str());
+
 			msg.str("");
 			msg << Ashita::Chat::Header(PluginCommand) << Ashita::Chat::Color1(0x3, "<no args>") << "              - open the configuration UI.";
 			chat->AddChatMessage(1, false, msg.str().c_str());
@@ -329,15 +398,16 @@ namespace XiPivot
 			imgui->Text("active overlays:");
 			imgui->BeginChild("overlay_list", ImVec2(0, 200));
 			{
-				if (imgui->BeginTable("active_overlays_table", 3, ImGuiTableFlags_NoSavedSettings))
+				if (imgui->BeginTable("active_overlays_table", 4, ImGuiTableFlags_NoSavedSettings))
 				{
 
+					imgui->TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed, 0);
 					imgui->TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed, 0);
 					imgui->TableSetupColumn("Priority", ImGuiTableColumnFlags_WidthFixed, 0);
 					imgui->TableSetupColumn("Overlay", ImGuiTableColumnFlags_WidthStretch, 1);
 					imgui->TableHeadersRow();
 
-					if (m_guiState.state.deleteOverlayName.empty() == true)
+					if (m_guiState.state.deleteOverlayName.empty() == true && m_guiState.state.moveOverlayName.empty() == true)
 					{
 						int prio = 0;
 						for (const auto& path : m_guiState.constants.activeOverlays)
@@ -353,6 +423,22 @@ namespace XiPivot
 								m_guiState.state.deleteOverlayName = path;
 							}
 
+							/* same for the priority buttons, ' ^ ##a' / ' v ##a' */
+							char upBtnId[] = { ' ', '^', ' ', '#', '#', static_cast<char>(prio + 'a'), '\0' };
+							char downBtnId[] = { ' ', 'v', ' ', '#', '#', static_cast<char>(prio + 'a'), '\0' };
+							imgui->TableNextColumn();
+							if (imgui->Button(upBtnId) && prio > 0)
+							{
+								m_guiState.state.moveOverlayName = path;
+								m_guiState.state.moveOverlayIndex = prio - 1;
+							}
+							imgui->SameLine();
+							if (imgui->Button(downBtnId) && prio + 1 < static_cast<int>(m_guiState.constants.activeOverlays.size()))
+							{
+								m_guiState.state.moveOverlayName = path;
+								m_guiState.state.moveOverlayIndex = prio + 1;
+							}
+
 							imgui->TableNextColumn();
 							imgui->Text("%02d", prio++);
 
@@ -77,6 +77,8 @@ namespace XiPivot
 					{
 						std::string addOverlayName = "";
 						std::string deleteOverlayName = "";
+						std::string moveOverlayName = "";
+						size_t      moveOverlayIndex = 0;
 
 						bool showConfigWindow = false;
 						bool applyCLIChanges = false;
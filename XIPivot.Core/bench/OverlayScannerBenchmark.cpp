@@ -0,0 +1,189 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MemoryFileSystem.h"
+#include "OverlayScanner.h"
+#include "PathClassifier.h"
+#include "PathIndex.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+using namespace XiPivot::Core;
+
+namespace
+{
+	constexpr size_t sRomRoots    = 9;   /* ROM, ROM2 .. ROM9 */
+	constexpr size_t sRomDirs     = 100; /* per root, the lookups also use the next 100 for misses */
+	constexpr size_t sFilesPerDir = 128;
+
+	const std::string sOverlay = "C:/Games/FINAL FANTASY XI/polplugins/DATs/bench";
+	const std::string sGame = "C:\\Games\\FINAL FANTASY XI";
+
+	std::string romName(size_t root)
+	{
+		return root == 0 ? "ROM" : "ROM" + std::to_string(root + 1);
+	}
+
+	/* an overlay with sRomRoots * sRomDirs * sFilesPerDir DATs plus a few sound files */
+	MemoryFileSystem& syntheticOverlay(void)
+	{
+		static MemoryFileSystem *fs = nullptr;
+		if (fs == nullptr)
+		{
+			fs = new MemoryFileSystem();
+			for (size_t root = 0; root < sRomRoots; ++root)
+			{
+				const std::string rom = sOverlay + "/" + romName(root);
+
+				fs->addFile(rom + "/VTABLE" + (root == 0 ? "" : std::to_string(root + 1)) + ".DAT");
+				fs->addFile(rom + "/FTABLE" + (root == 0 ? "" : std::to_string(root + 1)) + ".DAT");
+				for (size_t dir = 0; dir < sRomDirs; ++dir)
+				{
+					for (size_t file = 0; file < sFilesPerDir; ++file)
+					{
+						fs->addFile(rom + "/" + std::to_string(dir) + "/" + std::to_string(file) + ".DAT");
+					}
+				}
+			}
+
+			for (size_t se = 0; se < 100; ++se)
+			{
+				char name[32];
+				snprintf(name, sizeof(name), "se%03zu/se%03zu%03zu.spw", se, se, size_t(1));
+				fs->addFile(sOverlay + "/sound2/win/se/" + name);
+			}
+		}
+		return *fs;
+	}
+
+	RedirectTable scanOverlay(const IFileSystem &fs)
+	{
+		std::vector<RedirectTable> redirects;
+		std::vector<char> valid;
+
+		OverlayScanner(fs, DummyDelegate::instance(), IDelegate::LogLevel::Discard).scan({ sOverlay }, redirects, valid);
+		return std::move(redirects.front());
+	}
+
+	/* the same steps Redirector::findRedirect takes for a path handed to CreateFileA */
+	const char* lookup(const RedirectTable &redirects, const char *path)
+	{
+		const auto pathClass = PathClassifier::classify(path);
+		if (pathClass.romSuffix != nullptr)
+		{
+			return redirects.find(PathIndex::pathToIndex(pathClass.romSuffix));
+		}
+		if (pathClass.lastRomSuffix != nullptr)
+		{
+			return redirects.find(PathIndex::romSuffixToIndex(pathClass.lastRomSuffix + 4));
+		}
+		if (pathClass.audioSuffix != nullptr)
+		{
+			return redirects.find(PathIndex::pathToIndexAudio(pathClass.audioSuffix));
+		}
+		return nullptr;
+	}
+
+	/* game paths in the client's "//ROM" notation, firstDir selects hits (0) or misses (sRomDirs) */
+	std::vector<std::string> gamePaths(size_t firstDir)
+	{
+		std::vector<std::string> paths;
+		for (size_t root = 0; root < sRomRoots; ++root)
+		{
+			for (size_t dir = firstDir; dir < firstDir + sRomDirs; dir += 7)
+			{
+				for (size_t file = 0; file < sFilesPerDir; file += 13)
+				{
+					paths.emplace_back(sGame + "//" + romName(root) + "/" + std::to_string(dir) + "/" + std::to_string(file) + ".DAT");
+				}
+			}
+		}
+		return paths;
+	}
+
+	void resetIndex(const MemoryFileSystem &fs)
+	{
+		fs.replaceFile(OverlayScanner::indexPath(sOverlay), {});
+	}
+}
+
+static void BM_ScanOverlay(benchmark::State &state)
+{
+	const auto &fs = syntheticOverlay();
+
+	size_t redirects = 0;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		resetIndex(fs);
+		state.ResumeTiming();
+
+		redirects = scanOverlay(fs).size();
+	}
+	state.counters["redirects"] = static_cast<double>(redirects);
+	state.SetItemsProcessed(state.iterations() * redirects);
+}
+BENCHMARK(BM_ScanOverlay)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_ScanOverlayIndexed(benchmark::State &state)
+{
+	const auto &fs = syntheticOverlay();
+
+	resetIndex(fs);
+	scanOverlay(fs);
+
+	size_t redirects = 0;
+	for (auto _ : state)
+	{
+		redirects = scanOverlay(fs).size();
+	}
+	state.counters["redirects"] = static_cast<double>(redirects);
+	state.SetItemsProcessed(state.iterations() * redirects);
+}
+BENCHMARK(BM_ScanOverlayIndexed)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_Lookup(benchmark::State &state)
+{
+	const auto &fs = syntheticOverlay();
+
+	resetIndex(fs);
+	const auto redirects = scanOverlay(fs);
+	const auto paths = gamePaths(state.range(0) != 0 ? 0 : sRomDirs);
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(lookup(redirects, paths[i].c_str()));
+		i = (i + 1 < paths.size()) ? i + 1 : 0;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Lookup)->ArgName("hit")->Arg(1)->Arg(0);
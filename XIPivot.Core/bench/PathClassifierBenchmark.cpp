@@ -0,0 +1,113 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "PathClassifier.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+using namespace XiPivot::Core;
+
+namespace
+{
+	const std::string sGame = "C:\\Program Files (x86)\\PlayOnline\\SquareEnix\\FINAL FANTASY XI";
+
+	/* the kind of paths the hooks see while zoning: mostly game DATs,
+	 * mixed with sound files and the odd DLL, config or addon file.
+	 */
+	const std::vector<std::string>& pathCorpus(void)
+	{
+		static std::vector<std::string> paths;
+		if (paths.empty())
+		{
+			for (size_t i = 0; i < 256; ++i)
+			{
+				const std::string rom = (i % 9) == 0 ? "ROM" : "ROM" + std::to_string(i % 9 + 1);
+				const std::string dat = std::to_string(i % 120) + "/" + std::to_string(i % 128) + ".DAT";
+
+				paths.emplace_back(sGame + "//" + rom + "/" + dat);
+				if (i % 4 == 0)
+				{
+					paths.emplace_back(sGame + "\\" + rom + "\\" + std::to_string(i % 120) + "\\" + std::to_string(i % 128) + ".DAT");
+				}
+				if (i % 8 == 0)
+				{
+					paths.emplace_back(sGame + "\\sound2\\win\\se\\se" + std::to_string(100 + i) + "\\se" + std::to_string(100 + i) + "001.spw");
+					paths.emplace_back(sGame + "\\sound\\win\\music\\data\\music" + std::to_string(100 + i) + ".bgw");
+				}
+				if (i % 16 == 0)
+				{
+					paths.emplace_back("C:\\Windows\\SysWOW64\\d3d8.dll");
+					paths.emplace_back("C:\\Ashita\\config\\boot\\Ashita.ini");
+					paths.emplace_back("C:\\Ashita\\addons\\distance\\distance.lua");
+					paths.emplace_back(sGame + "\\USER\\12345678\\mss.dat");
+				}
+			}
+		}
+		return paths;
+	}
+
+	template<typename Classify>
+	void classifyCorpus(benchmark::State &state, Classify classify)
+	{
+		const auto &paths = pathCorpus();
+
+		size_t bytes = 0;
+		for (const auto &path : paths)
+		{
+			bytes += path.size();
+		}
+
+		for (auto _ : state)
+		{
+			for (const auto &path : paths)
+			{
+				benchmark::DoNotOptimize(classify(path.c_str()));
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * paths.size());
+		state.SetBytesProcessed(state.iterations() * bytes);
+	}
+}
+
+static void BM_ClassifyScalar(benchmark::State &state)
+{
+	classifyCorpus(state, &PathClassifier::classifyScalar);
+}
+BENCHMARK(BM_ClassifyScalar);
+
+#if defined(XIPIVOT_PATH_CLASSIFIER_SSE2)
+static void BM_ClassifySSE2(benchmark::State &state)
+{
+	classifyCorpus(state, &PathClassifier::classifySSE2);
+}
+BENCHMARK(BM_ClassifySSE2);
+#endif
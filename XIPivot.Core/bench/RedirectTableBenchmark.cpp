@@ -0,0 +1,140 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "PathIndex.h"
+#include "RedirectTable.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace XiPivot::Core;
+
+namespace
+{
+	constexpr size_t sRomRoots    = 4;
+	constexpr size_t sRomDirs     = 100; /* the lookups also use the next 100 for misses */
+	constexpr size_t sFilesPerDir = 125; /* 4 * 100 * 125 = 50k entries */
+
+	const std::string sOverlay = "C:/Games/FINAL FANTASY XI/polplugins/DATs/bench";
+
+	std::string romPath(size_t root, size_t dir, size_t file)
+	{
+		return "//" + (root == 0 ? std::string("ROM") : "ROM" + std::to_string(root + 1)) +
+			"/" + std::to_string(dir) + "/" + std::to_string(file) + ".DAT";
+	}
+
+	/* the redirects as a RedirectTable and as the unordered_map it replaced */
+	struct Redirects
+	{
+		RedirectTable                            table;
+		std::unordered_map<int32_t, std::string> map;
+	};
+
+	const Redirects& redirects(void)
+	{
+		static Redirects *res = nullptr;
+		if (res == nullptr)
+		{
+			RedirectTable::Builder builder;
+
+			res = new Redirects();
+			for (size_t root = 0; root < sRomRoots; ++root)
+			{
+				for (size_t dir = 0; dir < sRomDirs; ++dir)
+				{
+					for (size_t file = 0; file < sFilesPerDir; ++file)
+					{
+						const std::string rom = romPath(root, dir, file);
+						const int32_t key = PathIndex::pathToIndex(rom.c_str());
+
+						builder.add(key, sOverlay + rom.substr(1), sOverlay + rom.substr(1));
+						res->map.emplace(key, sOverlay + rom.substr(1));
+					}
+				}
+			}
+			res->table = builder.build();
+		}
+		return *res;
+	}
+
+	/* lookup keys spread over the table, firstDir selects hits (0) or misses (sRomDirs) */
+	std::vector<int32_t> lookupKeys(size_t firstDir)
+	{
+		std::vector<int32_t> keys;
+		for (size_t root = 0; root < sRomRoots; ++root)
+		{
+			for (size_t dir = firstDir; dir < firstDir + sRomDirs; dir += 3)
+			{
+				for (size_t file = 0; file < sFilesPerDir; file += 7)
+				{
+					keys.push_back(PathIndex::pathToIndex(romPath(root, dir, file).c_str()));
+				}
+			}
+		}
+		return keys;
+	}
+}
+
+static void BM_RedirectTableFind(benchmark::State &state)
+{
+	const auto &table = redirects().table;
+	const auto keys = lookupKeys(state.range(0) != 0 ? 0 : sRomDirs);
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(table.find(keys[i]));
+		i = (i + 1 < keys.size()) ? i + 1 : 0;
+	}
+	state.counters["entries"] = static_cast<double>(table.size());
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RedirectTableFind)->ArgName("hit")->Arg(1)->Arg(0);
+
+static void BM_UnorderedMapFind(benchmark::State &state)
+{
+	const auto &map = redirects().map;
+	const auto keys = lookupKeys(state.range(0) != 0 ? 0 : sRomDirs);
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		/* the same "path or nullptr" result RedirectTable::find gives */
+		const auto it = map.find(keys[i]);
+		benchmark::DoNotOptimize(it != map.end() ? it->second.c_str() : nullptr);
+		i = (i + 1 < keys.size()) ? i + 1 : 0;
+	}
+	state.counters["entries"] = static_cast<double>(map.size());
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UnorderedMapFind)->ArgName("hit")->Arg(1)->Arg(0);
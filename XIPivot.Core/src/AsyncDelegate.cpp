@@ -0,0 +1,664 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AsyncDelegate.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		namespace
+		{
+			static constexpr int sDeliverInterval = 20; // ms between draining the ring
+
+			enum class LengthModifier
+			{
+				None, Char, Short, Long, LongLong, Size, PtrDiff, IntMax
+			};
+
+			/* one printf conversion, split so the argument can be stored and formatted later */
+			struct FormatSpec
+			{
+				const char*    begin;        /* the '%' */
+				const char*    lengthBegin;  /* end of flags, width and precision */
+				const char*    end;          /* one past the conversion character */
+				bool           starWidth;
+				bool           starPrecision;
+				LengthModifier length;
+				char           conversion;
+			};
+
+			/* parse the conversion at p (pointing at a '%'), false at the end of the string */
+			bool parse_spec(const char* p, FormatSpec& spec)
+			{
+				spec.begin = p++;
+				spec.starWidth = false;
+				spec.starPrecision = false;
+				spec.length = LengthModifier::None;
+
+				while (*p != '\0' && strchr("-+ #0", *p) != nullptr)
+				{
+					++p;
+				}
+
+				if (*p == '*')
+				{
+					spec.starWidth = true;
+					++p;
+				}
+				while (*p >= '0' && *p <= '9')
+				{
+					++p;
+				}
+
+				if (*p == '.')
+				{
+					++p;
+					if (*p == '*')
+					{
+						spec.starPrecision = true;
+						++p;
+					}
+					while (*p >= '0' && *p <= '9')
+					{
+						++p;
+					}
+				}
+
+				spec.lengthBegin = p;
+				switch (*p)
+				{
+					case 'h': spec.length = (p[1] == 'h') ? LengthModifier::Char : LengthModifier::Short; p += (p[1] == 'h') ? 2 : 1; break;
+					case 'l': spec.length = (p[1] == 'l') ? LengthModifier::LongLong : LengthModifier::Long; p += (p[1] == 'l') ? 2 : 1; break;
+					case 'z': spec.length = LengthModifier::Size; ++p; break;
+					case 't': spec.length = LengthModifier::PtrDiff; ++p; break;
+					case 'j': spec.length = LengthModifier::IntMax; ++p; break;
+					case 'L': ++p; break;
+					case 'I':
+						if (p[1] == '6' && p[2] == '4')
+						{
+							spec.length = LengthModifier::LongLong;
+							p += 3;
+						}
+						else if (p[1] == '3' && p[2] == '2')
+						{
+							p += 3;
+						}
+						else
+						{
+							spec.length = LengthModifier::Size;
+							++p;
+						}
+						break;
+				}
+
+				if (*p == '\0')
+				{
+					return false;
+				}
+
+				spec.conversion = *p;
+				spec.end = p + 1;
+				return true;
+			}
+
+			bool is_signed_conversion(char c)   { return c == 'd' || c == 'i'; }
+			bool is_unsigned_conversion(char c) { return c == 'u' || c == 'o' || c == 'x' || c == 'X' || c == 'c'; }
+			bool is_float_conversion(char c)    { return strchr("fFeEgGaA", c) != nullptr; }
+
+			template<typename T>
+			void append_formatted(std::string& out, const std::string& spec, T value)
+			{
+				char buf[128];
+				const int len = snprintf(buf, sizeof(buf), spec.c_str(), value);
+				if (len < 0)
+				{
+					return;
+				}
+
+				if (static_cast<size_t>(len) < sizeof(buf))
+				{
+					out.append(buf, static_cast<size_t>(len));
+				}
+				else
+				{
+					/* long %s arguments like full paths */
+					const size_t offset = out.size();
+					out.resize(offset + len + 1);
+					snprintf(&out[offset], len + 1, spec.c_str(), value);
+					out.resize(offset + len);
+				}
+			}
+
+			/* the raw argument bits widened according to the conversion they were passed for */
+			int64_t signed_argument(uint64_t raw, LengthModifier length)
+			{
+				switch (length)
+				{
+					case LengthModifier::Char:     return static_cast<signed char>(raw);
+					case LengthModifier::Short:    return static_cast<short>(raw);
+					case LengthModifier::Long:     return static_cast<long>(static_cast<unsigned long>(raw));
+					case LengthModifier::LongLong:
+					case LengthModifier::IntMax:   return static_cast<int64_t>(raw);
+					case LengthModifier::Size:
+					case LengthModifier::PtrDiff:  return static_cast<ptrdiff_t>(static_cast<size_t>(raw));
+					default:                       return static_cast<int>(static_cast<unsigned int>(raw));
+				}
+			}
+
+			uint64_t unsigned_argument(uint64_t raw, LengthModifier length)
+			{
+				switch (length)
+				{
+					case LengthModifier::Char:     return static_cast<unsigned char>(raw);
+					case LengthModifier::Short:    return static_cast<unsigned short>(raw);
+					case LengthModifier::Long:     return static_cast<unsigned long>(raw);
+					case LengthModifier::LongLong:
+					case LengthModifier::IntMax:   return raw;
+					case LengthModifier::Size:
+					case LengthModifier::PtrDiff:  return static_cast<size_t>(raw);
+					default:                       return static_cast<unsigned int>(raw);
+				}
+			}
+		}
+
+		AsyncDelegate::AsyncDelegate(void)
+			: m_sink(nullptr),
+			  m_running(false),
+			  m_ring(new Record[sRingSize]),
+			  m_enqueuePos(0),
+			  m_dequeuePos(0),
+			  m_dropped(0),
+			  m_layouts(new ArgumentLayout[sLayoutSlots]),
+			  m_stop(false)
+		{
+			for (size_t i = 0; i < sRingSize; ++i)
+			{
+				m_ring[i].sequence.store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+			}
+
+			for (size_t i = 0; i < sLayoutSlots; ++i)
+			{
+				m_layouts[i].fmt.store(nullptr, std::memory_order_relaxed);
+				m_layouts[i].ready.store(false, std::memory_order_relaxed);
+			}
+		}
+
+		AsyncDelegate::~AsyncDelegate(void)
+		{
+			stop();
+		}
+
+		void AsyncDelegate::start(IDelegate* sink)
+		{
+			stop();
+
+			m_sink.store(sink);
+			m_stop = false;
+			m_worker = std::thread(&AsyncDelegate::logWorker, this);
+			m_running.store(true, std::memory_order_release);
+		}
+
+		void AsyncDelegate::stop(void)
+		{
+			if (m_worker.joinable())
+			{
+				/* anything logged from here on is delivered directly,
+				 * a message that was already being written when this flips is delivered by the next start
+				 */
+				m_running.store(false, std::memory_order_release);
+				{
+					std::lock_guard<std::mutex> lock(m_stopLock);
+					m_stop = true;
+				}
+				m_stopSignal.notify_all();
+				m_worker.join();
+			}
+		}
+
+		void AsyncDelegate::logMessage(LogLevel level, std::string message)
+		{
+			IDelegate* sink = m_sink.load();
+			if (level == LogLevel::Discard || sink == nullptr)
+			{
+				return;
+			}
+
+			if (m_running.load(std::memory_order_acquire) == false)
+			{
+				/* no worker, deliver on the calling thread */
+				sink->logMessage(level, std::move(message));
+				return;
+			}
+
+			uint32_t position = 0;
+			Record* record = claimRecord(position);
+			if (record == nullptr)
+			{
+				++m_dropped;
+				return;
+			}
+
+			record->level = level;
+			captureMessage(*record, message);
+			record->sequence.store(position + 1, std::memory_order_release);
+		}
+
+		void AsyncDelegate::logMessageF(LogLevel level, const char* fmt, ...)
+		{
+			IDelegate* sink = m_sink.load();
+			if (level == LogLevel::Discard || fmt == nullptr || sink == nullptr)
+			{
+				return;
+			}
+
+			va_list args;
+			va_start(args, fmt);
+
+			if (m_running.load(std::memory_order_acquire) == false)
+			{
+				/* no worker, format and deliver on the calling thread */
+				va_list sizeArgs;
+				va_copy(sizeArgs, args);
+				const int len = vsnprintf(nullptr, 0, fmt, sizeArgs);
+				va_end(sizeArgs);
+
+				std::string message;
+				if (len > 0)
+				{
+					message.resize(static_cast<size_t>(len) + 1);
+					vsnprintf(&message[0], message.size(), fmt, args);
+					message.resize(static_cast<size_t>(len));
+				}
+				va_end(args);
+
+				sink->logMessage(level, std::move(message));
+				return;
+			}
+
+			ArgumentLayout local;
+			const ArgumentLayout& layout = argumentLayout(fmt, local);
+
+			uint32_t position = 0;
+			Record* record = claimRecord(position);
+			if (record == nullptr)
+			{
+				va_end(args);
+				++m_dropped;
+				return;
+			}
+
+			record->level = level;
+			record->fmt = fmt;
+			captureArguments(*record, layout, args);
+			va_end(args);
+
+			record->sequence.store(position + 1, std::memory_order_release);
+		}
+
+		bool AsyncDelegate::runFOpenSHook(const char* path)
+		{
+			/* a decision, not a message - it has to be answered right away */
+			IDelegate* sink = m_sink.load();
+			return sink != nullptr && sink->runFOpenSHook(path);
+		}
+
+		/* private stuff */
+
+		const AsyncDelegate::ArgumentLayout& AsyncDelegate::argumentLayout(const char* fmt, ArgumentLayout& local)
+		{
+			/* format strings are literals, their address is as good as their contents */
+			const size_t hash = static_cast<size_t>((reinterpret_cast<uintptr_t>(fmt) >> 2) * 2654435761u);
+
+			for (size_t probe = 0; probe < sLayoutSlots; ++probe)
+			{
+				ArgumentLayout& layout = m_layouts[(hash + probe) & (sLayoutSlots - 1)];
+
+				const char* owner = layout.fmt.load(std::memory_order_acquire);
+				if (owner == nullptr && layout.fmt.compare_exchange_strong(owner, fmt, std::memory_order_acq_rel))
+				{
+					parseLayout(fmt, layout);
+					layout.ready.store(true, std::memory_order_release);
+					return layout;
+				}
+
+				if (owner == fmt)
+				{
+					if (layout.ready.load(std::memory_order_acquire))
+					{
+						return layout;
+					}
+					/* another thread is still filling it in */
+					break;
+				}
+			}
+
+			parseLayout(fmt, local);
+			return local;
+		}
+
+		void AsyncDelegate::parseLayout(const char* fmt, ArgumentLayout& layout)
+		{
+			layout.count = 0;
+
+			FormatSpec spec;
+			for (const char* p = strchr(fmt, '%'); p != nullptr; p = strchr(p, '%'))
+			{
+				if (p[1] == '%')
+				{
+					p += 2;
+					continue;
+				}
+
+				if (parse_spec(p, spec) == false)
+				{
+					return;
+				}
+				p = spec.end;
+
+				ArgumentKind kinds[3];
+				size_t count = 0;
+
+				if (spec.starWidth)
+				{
+					kinds[count++] = ArgumentKind::Int;
+				}
+				if (spec.starPrecision)
+				{
+					kinds[count++] = ArgumentKind::Int;
+				}
+
+				if (is_signed_conversion(spec.conversion) || is_unsigned_conversion(spec.conversion))
+				{
+					switch (spec.length)
+					{
+						case LengthModifier::Long:     kinds[count++] = ArgumentKind::Long; break;
+						case LengthModifier::LongLong:
+						case LengthModifier::IntMax:   kinds[count++] = ArgumentKind::LongLong; break;
+						case LengthModifier::Size:
+						case LengthModifier::PtrDiff:  kinds[count++] = ArgumentKind::Size; break;
+						default:                       kinds[count++] = ArgumentKind::Int; break;
+					}
+				}
+				else if (is_float_conversion(spec.conversion))
+				{
+					kinds[count++] = ArgumentKind::Double;
+				}
+				else if (spec.conversion == 'p')
+				{
+					kinds[count++] = ArgumentKind::Pointer;
+				}
+				else if (spec.conversion == 's')
+				{
+					kinds[count++] = ArgumentKind::String;
+				}
+				else
+				{
+					/* unsupported, the arguments can't be walked any further */
+					return;
+				}
+
+				if (layout.count + count > sMaxArguments)
+				{
+					return;
+				}
+
+				for (size_t i = 0; i < count; ++i)
+				{
+					layout.kinds[layout.count++] = kinds[i];
+				}
+			}
+		}
+
+		AsyncDelegate::Record* AsyncDelegate::claimRecord(uint32_t& position)
+		{
+			uint32_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+			while (true)
+			{
+				Record& record = m_ring[pos & (sRingSize - 1)];
+
+				/* a free record carries the position it can be claimed at */
+				const int32_t diff = static_cast<int32_t>(record.sequence.load(std::memory_order_acquire) - pos);
+				if (diff == 0)
+				{
+					if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						position = pos;
+						return &record;
+					}
+				}
+				else if (diff < 0)
+				{
+					/* the worker hasn't delivered this one yet, the ring is full */
+					return nullptr;
+				}
+				else
+				{
+					pos = m_enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		void AsyncDelegate::captureArguments(Record& record, const ArgumentLayout& layout, va_list args)
+		{
+			record.count = layout.count;
+			record.textSize = 0;
+
+			for (size_t i = 0; i < layout.count; ++i)
+			{
+				uint64_t& raw = record.args[i];
+				switch (layout.kinds[i])
+				{
+					case ArgumentKind::Int:      raw = static_cast<unsigned int>(va_arg(args, int)); break;
+					case ArgumentKind::Long:     raw = static_cast<unsigned long>(va_arg(args, long)); break;
+					case ArgumentKind::LongLong: raw = static_cast<uint64_t>(va_arg(args, long long)); break;
+					case ArgumentKind::Size:     raw = va_arg(args, size_t); break;
+					case ArgumentKind::Pointer:  raw = reinterpret_cast<uintptr_t>(va_arg(args, const void*)); break;
+
+					case ArgumentKind::Double:
+					{
+						const double d = va_arg(args, double);
+						memcpy(&raw, &d, sizeof(d));
+						break;
+					}
+
+					case ArgumentKind::String:
+					{
+						/* the string usually lives on the callers stack, keep a (possibly truncated) copy */
+						const char* str = va_arg(args, const char*);
+						if (str == nullptr)
+						{
+							str = "(null)";
+						}
+
+						const size_t room = sTextSize - record.textSize;
+						if (room == 0)
+						{
+							/* the terminator of the previous string */
+							raw = record.textSize - 1;
+							break;
+						}
+
+						const size_t len = strnlen(str, room - 1);
+						memcpy(&record.text[record.textSize], str, len);
+						record.text[record.textSize + len] = '\0';
+
+						raw = record.textSize;
+						record.textSize = static_cast<uint16_t>(record.textSize + len + 1);
+						break;
+					}
+				}
+			}
+		}
+
+		void AsyncDelegate::captureMessage(Record& record, const std::string& message)
+		{
+			const size_t len = (message.size() < sTextSize) ? message.size() : sTextSize;
+			memcpy(record.text, message.data(), len);
+
+			record.fmt = nullptr;
+			record.count = 0;
+			record.textSize = static_cast<uint16_t>(len);
+		}
+
+		std::string AsyncDelegate::formatRecord(const Record& record)
+		{
+			if (record.fmt == nullptr)
+			{
+				return std::string(record.text, record.textSize);
+			}
+
+			std::string out;
+			out.reserve(strlen(record.fmt) + 64);
+
+			const char* fmt = record.fmt;
+			size_t next = 0;
+
+			FormatSpec spec;
+			for (const char* p = strchr(fmt, '%'); p != nullptr; p = strchr(p, '%'))
+			{
+				out.append(fmt, p);
+
+				if (p[1] == '%')
+				{
+					out.push_back('%');
+					p += 2;
+					fmt = p;
+					continue;
+				}
+
+				if (parse_spec(p, spec) == false || next >= record.count)
+				{
+					fmt = p;
+					break;
+				}
+				p = fmt = spec.end;
+
+				/* rebuild the spec with '*' resolved and all integers widened to long long */
+				std::string convSpec;
+				for (const char* c = spec.begin; c != spec.lengthBegin; ++c)
+				{
+					if (*c == '*' && next < record.count)
+					{
+						convSpec += std::to_string(signed_argument(record.args[next++], LengthModifier::None));
+					}
+					else
+					{
+						convSpec.push_back(*c);
+					}
+				}
+				if (next >= record.count)
+				{
+					break;
+				}
+
+				const uint64_t raw = record.args[next++];
+				if (is_signed_conversion(spec.conversion) || (is_unsigned_conversion(spec.conversion) && spec.conversion != 'c'))
+				{
+					convSpec += "ll";
+					convSpec.push_back(spec.conversion);
+					if (is_signed_conversion(spec.conversion))
+					{
+						append_formatted(out, convSpec, static_cast<long long>(signed_argument(raw, spec.length)));
+					}
+					else
+					{
+						append_formatted(out, convSpec, static_cast<unsigned long long>(unsigned_argument(raw, spec.length)));
+					}
+				}
+				else
+				{
+					convSpec.push_back(spec.conversion);
+					switch (spec.conversion)
+					{
+						case 'c': append_formatted(out, convSpec, static_cast<int>(unsigned_argument(raw, spec.length))); break;
+						case 'p': append_formatted(out, convSpec, reinterpret_cast<const void*>(static_cast<uintptr_t>(raw))); break;
+						case 's': append_formatted(out, convSpec, &record.text[raw]); break;
+						default:
+						{
+							double d;
+							memcpy(&d, &raw, sizeof(d));
+							append_formatted(out, convSpec, d);
+							break;
+						}
+					}
+				}
+			}
+
+			out.append(fmt);
+			return out;
+		}
+
+		void AsyncDelegate::drain(IDelegate* sink)
+		{
+			while (true)
+			{
+				Record& record = m_ring[m_dequeuePos & (sRingSize - 1)];
+				if (record.sequence.load(std::memory_order_acquire) != m_dequeuePos + 1)
+				{
+					/* empty, or the next record is still being written */
+					break;
+				}
+
+				sink->logMessage(record.level, formatRecord(record));
+
+				/* hand the record back to the producers for the next lap */
+				record.sequence.store(m_dequeuePos + static_cast<uint32_t>(sRingSize), std::memory_order_release);
+				++m_dequeuePos;
+			}
+
+			const uint32_t dropped = m_dropped.exchange(0);
+			if (dropped != 0)
+			{
+				sink->logMessage(LogLevel::Warn, "dropped " + std::to_string(dropped) + " log messages");
+			}
+		}
+
+		void AsyncDelegate::logWorker(void)
+		{
+			IDelegate* sink = m_sink.load();
+
+			bool stopping = false;
+			while (stopping == false)
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_stopLock);
+					m_stopSignal.wait_for(lock, std::chrono::milliseconds(sDeliverInterval), [this]() { return m_stop; });
+					stopping = m_stop;
+				}
+
+				/* one last pass after stopping picks up whatever was logged meanwhile */
+				drain(sink);
+			}
+		}
+	}
+}
@@ -0,0 +1,138 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Delegate.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* IDelegate that keeps formatting and delivery out of the hooked threads
+		 *
+		 * logMessageF only keeps the format string (Core only passes literals) and copies
+		 * its raw arguments into a preallocated, lock-free ring of fixed-size records;
+		 * %s arguments and plain messages are copied into the record itself (and truncated
+		 * to sTextSize). the argument layout of every format is worked out once and cached,
+		 * so the hooked thread never parses, allocates or takes a lock.
+		 * a background thread drains the ring every sDeliverInterval ms, formats the records
+		 * and hands them to the sink. while the worker isn't running everything goes straight to the sink.
+		 *
+		 * only the printf conversions used by Core are supported (no %n, %ls or %Lf).
+		 */
+		class AsyncDelegate : public IDelegate
+		{
+		public:
+			AsyncDelegate(void);
+			virtual ~AsyncDelegate(void);
+
+			/* start delivering to sink in the background
+			 * stop delivers everything that is still queued and waits for the worker,
+			 * the sink only changes while the worker is stopped.
+			 */
+			void start(IDelegate* sink);
+			void stop(void);
+
+			/* IDelegate */
+			virtual void logMessage(LogLevel level, std::string message) override;
+			virtual void logMessageF(LogLevel level, const char* fmt, ...) override;
+			virtual bool runFOpenSHook(const char* path) override;
+
+		private:
+			/* messages beyond this are dropped and counted until the worker catches up */
+			static constexpr size_t sRingSize = 1024;     /* records, power of two */
+			static constexpr size_t sMaxArguments = 16;
+			static constexpr size_t sTextSize = 512;      /* inline storage for %s arguments and plain messages */
+			static constexpr size_t sLayoutSlots = 256;   /* cached argument layouts, power of two */
+
+			/* how an argument has to be taken off the va_list */
+			enum class ArgumentKind : uint8_t
+			{
+				Int, Long, LongLong, Size, Double, Pointer, String
+			};
+
+			struct ArgumentLayout
+			{
+				std::atomic<const char*> fmt;
+				std::atomic_bool         ready;
+				uint8_t                  count;
+				ArgumentKind             kinds[sMaxArguments];
+			};
+
+			struct Record
+			{
+				std::atomic<uint32_t> sequence;
+				LogLevel              level;
+				const char*           fmt;     /* nullptr for plain messages */
+				uint8_t               count;
+				uint16_t              textSize;
+				uint64_t              args[sMaxArguments]; /* raw bits, %s arguments are offsets into text */
+				char                  text[sTextSize];
+			};
+
+			/* the cached layout of fmt, local is filled in instead if the cache is full */
+			const ArgumentLayout& argumentLayout(const char* fmt, ArgumentLayout& local);
+			static void parseLayout(const char* fmt, ArgumentLayout& layout);
+			Record* claimRecord(uint32_t& position);
+
+			static void captureArguments(Record& record, const ArgumentLayout& layout, va_list args);
+			static void captureMessage(Record& record, const std::string& message);
+			static std::string formatRecord(const Record& record);
+
+			void drain(IDelegate* sink);
+			void logWorker(void);
+
+			/* read by the hooked threads without holding any lock */
+			std::atomic<IDelegate*>         m_sink;
+			std::atomic_bool                m_running;
+
+			std::unique_ptr<Record[]>       m_ring;
+			std::atomic<uint32_t>           m_enqueuePos;
+			uint32_t                        m_dequeuePos; /* only touched by the worker */
+			std::atomic<uint32_t>           m_dropped;
+
+			std::unique_ptr<ArgumentLayout[]> m_layouts;
+
+			std::mutex                      m_stopLock;
+			std::condition_variable         m_stopSignal;
+			bool                            m_stop;
+
+			std::thread                     m_worker;
+		};
+	}
+}
@@ -0,0 +1,202 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CacheTelemetry.h"
+
+#include <algorithm>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* LatencyHistogram */
+
+		int64_t LatencyHistogram::now(void)
+		{
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			return counter.QuadPart;
+		}
+
+		uint64_t LatencyHistogram::elapsedUs(int64_t start)
+		{
+			static const int64_t frequency = []()
+			{
+				LARGE_INTEGER freq;
+				QueryPerformanceFrequency(&freq);
+				return freq.QuadPart;
+			}();
+
+			const int64_t ticks = now() - start;
+			return ticks > 0 ? static_cast<uint64_t>(ticks) * 1000000 / static_cast<uint64_t>(frequency) : 0;
+		}
+
+		void LatencyHistogram::record(uint64_t us)
+		{
+			size_t bucket = 0;
+			for (uint64_t v = us >> 1; v != 0 && bucket < sBuckets - 1; v >>= 1)
+			{
+				++bucket;
+			}
+
+			++m_buckets[bucket];
+			++m_count;
+			m_totalUs += us;
+
+			uint64_t max = m_maxUs.load(std::memory_order_relaxed);
+			while (us > max && m_maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed) == false)
+			{
+			}
+		}
+
+		LatencyHistogram::Snapshot LatencyHistogram::snapshot(void) const
+		{
+			Snapshot result;
+			for (size_t i = 0; i < sBuckets; ++i)
+			{
+				result.buckets[i] = m_buckets[i];
+			}
+			result.count = m_count;
+			result.totalUs = m_totalUs;
+			result.maxUs = m_maxUs;
+			return result;
+		}
+
+		void LatencyHistogram::reset(void)
+		{
+			for (auto& bucket : m_buckets)
+			{
+				bucket = 0;
+			}
+			m_count = 0;
+			m_totalUs = 0;
+			m_maxUs = 0;
+		}
+
+		uint64_t LatencyHistogram::Snapshot::percentileUs(double p) const
+		{
+			uint64_t total = 0;
+			for (const auto bucket : buckets)
+			{
+				total += bucket;
+			}
+
+			const uint64_t target = static_cast<uint64_t>(p * total + 0.5);
+			uint64_t seen = 0;
+			for (size_t i = 0; i < sBuckets; ++i)
+			{
+				seen += buckets[i];
+				if (seen >= target && seen != 0)
+				{
+					/* the last bucket is open ended */
+					return i < sBuckets - 1 ? std::min<uint64_t>(uint64_t(2) << i, maxUs) : maxUs;
+				}
+			}
+			return 0;
+		}
+
+		/* CacheTelemetry */
+
+		const char* CacheTelemetry::operationName(Operation op)
+		{
+			switch (op)
+			{
+				case Operation::Open:       return "open";
+				case Operation::CachedRead: return "cached read";
+				case Operation::MissRead:   return "miss read";
+				case Operation::Populate:   return "populate";
+				default:                    return "?";
+			}
+		}
+
+		const char* CacheTelemetry::evictReasonName(EvictReason reason)
+		{
+			switch (reason)
+			{
+				case EvictReason::Capacity:   return "capacity";
+				case EvictReason::Age:        return "age";
+				case EvictReason::Compressed: return "compressed";
+				case EvictReason::Stale:      return "stale";
+				default:                      return "?";
+			}
+		}
+
+		void CacheTelemetry::recordOpen(int32_t pathKey)
+		{
+			std::lock_guard<std::mutex> lock(m_keyLock);
+			++m_openCounts[pathKey];
+		}
+
+		CacheTelemetry::Snapshot CacheTelemetry::snapshot(size_t topKeys) const
+		{
+			Snapshot result;
+			for (size_t i = 0; i < m_latency.size(); ++i)
+			{
+				result.latency[i] = m_latency[i].snapshot();
+			}
+
+			result.bytesFromCache = m_bytesFromCache;
+			result.bytesFromDisk = m_bytesFromDisk;
+
+			for (size_t i = 0; i < m_evictions.size(); ++i)
+			{
+				result.evictions[i] = m_evictions[i];
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_keyLock);
+				result.topKeys.assign(m_openCounts.begin(), m_openCounts.end());
+			}
+
+			const size_t keep = std::min(topKeys, result.topKeys.size());
+			std::partial_sort(result.topKeys.begin(), result.topKeys.begin() + keep, result.topKeys.end(),
+				[](const std::pair<int32_t, unsigned>& a, const std::pair<int32_t, unsigned>& b) { return a.second > b.second; });
+			result.topKeys.resize(keep);
+			return result;
+		}
+
+		void CacheTelemetry::reset(void)
+		{
+			for (auto& histogram : m_latency)
+			{
+				histogram.reset();
+			}
+
+			m_bytesFromCache = 0;
+			m_bytesFromDisk = 0;
+
+			for (auto& count : m_evictions)
+			{
+				count = 0;
+			}
+
+			std::lock_guard<std::mutex> lock(m_keyLock);
+			m_openCounts.clear();
+		}
+	}
+}
@@ -0,0 +1,141 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <Windows.h>
+
+#include <unordered_map>
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* lock-free latency histogram with power of two microsecond buckets
+		 *
+		 * bucket 0 holds everything below 2us, bucket i everything in [2^i, 2^(i+1)) us,
+		 * the last bucket everything slower than that.
+		 */
+		class LatencyHistogram
+		{
+		public:
+			static constexpr size_t sBuckets = 24;
+
+			struct Snapshot
+			{
+				uint64_t count = 0;
+				uint64_t totalUs = 0;
+				uint64_t maxUs = 0;
+				std::array<uint32_t, sBuckets> buckets = {};
+
+				/* upper bound of the bucket containing the p-th percentile (0.0 - 1.0) */
+				uint64_t percentileUs(double p) const;
+				uint64_t meanUs(void) const { return count != 0 ? totalUs / count : 0; }
+			};
+
+			LatencyHistogram(void) = default;
+
+			/* QueryPerformanceCounter timestamps */
+			static int64_t now(void);
+			static uint64_t elapsedUs(int64_t start);
+
+			void record(uint64_t us);
+			Snapshot snapshot(void) const;
+			void reset(void);
+
+		private:
+			std::array<std::atomic<uint32_t>, sBuckets> m_buckets = {};
+			std::atomic<uint64_t> m_count = 0;
+			std::atomic<uint64_t> m_totalUs = 0;
+			std::atomic<uint64_t> m_maxUs = 0;
+		};
+
+		/* everything MemCache measures beyond CacheStatus */
+		class CacheTelemetry
+		{
+		public:
+			enum class Operation
+			{
+				Open = 0,    /* tracking a newly opened handle, including creating its object */
+				CachedRead,  /* reads served entirely from resident data */
+				MissRead,    /* reads that had to go to disk first (or fell back to the real ReadFile) */
+				Populate,    /* reading a single chunk from disk */
+				Count
+			};
+
+			enum class EvictReason
+			{
+				Capacity = 0, /* picked by the eviction policy to make room */
+				Age,          /* unused for longer than the purge age */
+				Compressed,   /* moved to the compressed tier instead of being dropped */
+				Stale,        /* read from a path the key no longer resolves to */
+				Count
+			};
+
+			struct Snapshot
+			{
+				std::array<LatencyHistogram::Snapshot, static_cast<size_t>(Operation::Count)> latency;
+
+				uint64_t bytesFromCache = 0;
+				uint64_t bytesFromDisk = 0;
+
+				std::array<unsigned, static_cast<size_t>(EvictReason::Count)> evictions = {};
+
+				/* pathKey, open count - most opened first */
+				std::vector<std::pair<int32_t, unsigned>> topKeys;
+			};
+
+			static const char* operationName(Operation op);
+			static const char* evictReasonName(EvictReason reason);
+
+			void recordLatency(Operation op, int64_t start) { m_latency[static_cast<size_t>(op)].record(LatencyHistogram::elapsedUs(start)); }
+			void recordBytes(bool fromCache, uint64_t bytes) { (fromCache ? m_bytesFromCache : m_bytesFromDisk) += bytes; }
+			void recordEviction(EvictReason reason) { ++m_evictions[static_cast<size_t>(reason)]; }
+			void recordOpen(int32_t pathKey);
+
+			Snapshot snapshot(size_t topKeys) const;
+			void reset(void);
+
+		private:
+			std::array<LatencyHistogram, static_cast<size_t>(Operation::Count)> m_latency;
+
+			std::atomic<uint64_t> m_bytesFromCache = 0;
+			std::atomic<uint64_t> m_bytesFromDisk = 0;
+
+			std::array<std::atomic<unsigned>, static_cast<size_t>(EvictReason::Count)> m_evictions = {};
+
+			mutable std::mutex                    m_keyLock;
+			std::unordered_map<int32_t, unsigned> m_openCounts;
+		};
+	}
+}
@@ -30,6 +30,27 @@
 
 #include <string>
 
+/* logging with the level checked before any of the arguments are evaluated,
+ * a Discard level costs a compare - no formatting, no allocation, no virtual call.
+ */
+#define XIPIVOT_LOG(delegate, level, ...) \
+	do \
+	{ \
+		if ((level) != ::XiPivot::Core::IDelegate::LogLevel::Discard) \
+		{ \
+			(delegate)->logMessageF((level), __VA_ARGS__); \
+		} \
+	} while (0)
+
+/* debug logging from inside the hooks, XIPIVOT_ELIDE_HOOK_LOG compiles it out entirely
+ * (msbuild /p:XIPivotElideHookLog=true)
+ */
+#ifdef XIPIVOT_ELIDE_HOOK_LOG
+#	define XIPIVOT_HOOK_LOG(delegate, level, ...) do { } while (0)
+#else
+#	define XIPIVOT_HOOK_LOG(delegate, level, ...) XIPIVOT_LOG(delegate, level, __VA_ARGS__)
+#endif
+
 namespace XiPivot
 {
 	namespace Core
@@ -48,7 +69,7 @@ namespace XiPivot
 			};
 
 			virtual void logMessage(LogLevel level, std::string message) = 0;
-			virtual void logMessageF(LogLevel level, std::string fmt, ...) = 0;
+			virtual void logMessageF(LogLevel level, const char* fmt, ...) = 0;
 			virtual bool runFOpenSHook(const char*) { return false; };
 		};
 
@@ -59,7 +80,7 @@ namespace XiPivot
 			virtual ~DummyDelegate() {};
 
 			virtual void logMessage(LogLevel, std::string) {};
-			virtual void logMessageF(LogLevel, std::string, ...) {};
+			virtual void logMessageF(LogLevel, const char*, ...) {};
 
 			static DummyDelegate* instance();
 
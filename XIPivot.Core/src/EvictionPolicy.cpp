@@ -0,0 +1,264 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "EvictionPolicy.h"
+
+#include <algorithm>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		namespace
+		{
+			static constexpr uint8_t sMaxFrequency = 3;
+			static constexpr size_t  sSmallQueueRatio = 10; // small queue holds 1/10th of the cached bytes
+		}
+
+		std::unique_ptr<EvictionPolicy> EvictionPolicy::create(const std::string &name)
+		{
+			if (name == "lru")
+			{
+				return std::make_unique<LruPolicy>();
+			}
+			if (name == "s3fifo")
+			{
+				return std::make_unique<S3FifoPolicy>();
+			}
+			return nullptr;
+		}
+
+		/* LruPolicy */
+
+		void LruPolicy::insert(int32_t key, size_t /*size*/)
+		{
+			if (m_entries.find(key) == m_entries.end())
+			{
+				m_order.push_front(key);
+				m_entries.emplace(key, m_order.begin());
+			}
+		}
+
+		void LruPolicy::access(int32_t key)
+		{
+			const auto it = m_entries.find(key);
+			if (it != m_entries.end())
+			{
+				m_order.splice(m_order.begin(), m_order, it->second);
+			}
+		}
+
+		void LruPolicy::remove(int32_t key)
+		{
+			const auto it = m_entries.find(key);
+			if (it != m_entries.end())
+			{
+				m_order.erase(it->second);
+				m_entries.erase(it);
+			}
+		}
+
+		void LruPolicy::demote(int32_t key, size_t /*size*/)
+		{
+			/* the least recently used end is searched first */
+			const auto it = m_entries.find(key);
+			if (it != m_entries.end())
+			{
+				m_order.splice(m_order.end(), m_order, it->second);
+			}
+		}
+
+		int32_t LruPolicy::victim(const Evictable &evictable)
+		{
+			for (auto it = m_order.rbegin(); it != m_order.rend(); ++it)
+			{
+				if (evictable(*it))
+				{
+					return *it;
+				}
+			}
+			return -1;
+		}
+
+		/* S3FifoPolicy */
+
+		void S3FifoPolicy::insert(int32_t key, size_t size)
+		{
+			if (m_entries.find(key) != m_entries.end())
+			{
+				return;
+			}
+
+			Entry entry = { size, 0, false, {} };
+
+			const auto ghost = m_ghostEntries.find(key);
+			if (ghost != m_ghostEntries.end())
+			{
+				/* evicted too early last time */
+				m_ghost.erase(ghost->second);
+				m_ghostEntries.erase(ghost);
+
+				entry.main = true;
+				entry.pos = m_main.insert(m_main.end(), key);
+			}
+			else
+			{
+				entry.pos = m_small.insert(m_small.end(), key);
+				m_smallSize += size;
+			}
+			m_totalSize += size;
+			m_entries.emplace(key, entry);
+		}
+
+		void S3FifoPolicy::access(int32_t key)
+		{
+			const auto it = m_entries.find(key);
+			if (it != m_entries.end())
+			{
+				it->second.freq = std::min<uint8_t>(it->second.freq + 1, sMaxFrequency);
+			}
+		}
+
+		void S3FifoPolicy::remove(int32_t key)
+		{
+			const auto it = m_entries.find(key);
+			if (it == m_entries.end())
+			{
+				return;
+			}
+
+			if (it->second.main)
+			{
+				m_main.erase(it->second.pos);
+			}
+			else
+			{
+				m_small.erase(it->second.pos);
+				m_smallSize -= it->second.size;
+			}
+			m_totalSize -= it->second.size;
+			m_entries.erase(it);
+		}
+
+		void S3FifoPolicy::demote(int32_t key, size_t size)
+		{
+			const auto it = m_entries.find(key);
+			if (it == m_entries.end())
+			{
+				return;
+			}
+
+			/* victim() already remembered keys picked from the small queue as ghosts,
+			 * it didn't leave the cache though - a ghost would send its next insert straight to main.
+			 */
+			const auto ghost = m_ghostEntries.find(key);
+			if (ghost != m_ghostEntries.end())
+			{
+				m_ghost.erase(ghost->second);
+				m_ghostEntries.erase(ghost);
+			}
+
+			/* back to the head of the probationary queue, unless it is opened again it goes next */
+			Entry &entry = it->second;
+			if (entry.main)
+			{
+				m_main.erase(entry.pos);
+			}
+			else
+			{
+				m_small.erase(entry.pos);
+				m_smallSize -= entry.size;
+			}
+			m_totalSize -= entry.size;
+
+			entry.size = size;
+			entry.freq = 0;
+			entry.main = false;
+			entry.pos = m_small.insert(m_small.begin(), key);
+			m_smallSize += size;
+			m_totalSize += size;
+		}
+
+		int32_t S3FifoPolicy::victim(const Evictable &evictable)
+		{
+			/* every entry can be moved or reinserted at most sMaxFrequency + 1 times */
+			size_t steps = m_entries.size() * (sMaxFrequency + 2);
+			while (steps-- > 0)
+			{
+				const bool fromSmall = m_small.empty() == false && (m_smallSize * sSmallQueueRatio >= m_totalSize || m_main.empty());
+				if (fromSmall == false && m_main.empty())
+				{
+					break;
+				}
+
+				const int32_t key = fromSmall ? m_small.front() : m_main.front();
+				Entry &entry = m_entries[key];
+
+				if (fromSmall)
+				{
+					if (entry.freq > 0 || evictable(key) == false)
+					{
+						/* opened again (or still open) while on probation, promote it */
+						m_small.pop_front();
+						m_smallSize -= entry.size;
+
+						entry.main = true;
+						entry.freq = 0;
+						entry.pos = m_main.insert(m_main.end(), key);
+						continue;
+					}
+
+					rememberGhost(key);
+					return key;
+				}
+
+				if (entry.freq > 0 || evictable(key) == false)
+				{
+					/* give it another round */
+					entry.freq = entry.freq > 0 ? entry.freq - 1 : 0;
+					m_main.splice(m_main.end(), m_main, entry.pos);
+					continue;
+				}
+				return key;
+			}
+			return -1;
+		}
+
+		void S3FifoPolicy::rememberGhost(int32_t key)
+		{
+			m_ghostEntries.emplace(key, m_ghost.insert(m_ghost.end(), key));
+
+			/* the ghost queue remembers about as many keys as the main queue holds */
+			while (m_ghost.size() > std::max<size_t>(m_main.size(), 1))
+			{
+				m_ghostEntries.erase(m_ghost.front());
+				m_ghost.pop_front();
+			}
+		}
+	}
+}
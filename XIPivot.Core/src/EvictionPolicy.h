@@ -0,0 +1,144 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* decides which cache objects MemCache drops once it runs out of space
+		 *
+		 * policies only know keys and object sizes, MemCache reports every lookup,
+		 * insert and removal and asks for victims until the new object fits.
+		 * objects that are still in use are skipped through the evictable callback.
+		 */
+		class EvictionPolicy
+		{
+		public:
+			typedef std::function<bool(int32_t)> Evictable;
+
+			virtual ~EvictionPolicy(void) = default;
+
+			/* create one of the built-in policies by name ("lru" or "s3fifo"), nullptr for unknown names */
+			static std::unique_ptr<EvictionPolicy> create(const std::string &name);
+
+			virtual const char* name(void) const = 0;
+
+			/* a new object was added to the cache */
+			virtual void insert(int32_t key, size_t size) = 0;
+
+			/* an object already in the cache was opened again */
+			virtual void access(int32_t key) = 0;
+
+			/* an object left the cache, either as a victim or because it was purged */
+			virtual void remove(int32_t key) = 0;
+
+			/* a victim was kept in a smaller form (compressed) instead of being dropped,
+			 * it stays cached with its new size at the cold end of the policy
+			 * instead of being treated like a new or returning object.
+			 */
+			virtual void demote(int32_t key, size_t size) = 0;
+
+			/* the next object to drop or -1 if nothing can be evicted right now */
+			virtual int32_t victim(const Evictable &evictable) = 0;
+
+			/* hit ratio bookkeeping shared by all policies */
+			void recordLookup(bool hit) { hit ? ++m_hits : ++m_misses; }
+			float hitRatio(void) const { return (m_hits + m_misses) != 0 ? static_cast<float>(m_hits) / (m_hits + m_misses) : 0.0f; }
+
+		private:
+			uint64_t m_hits = 0;
+			uint64_t m_misses = 0;
+		};
+
+		/* plain least-recently-opened eviction */
+		class LruPolicy : public EvictionPolicy
+		{
+		public:
+			const char* name(void) const override { return "lru"; }
+
+			void insert(int32_t key, size_t size) override;
+			void access(int32_t key) override;
+			void remove(int32_t key) override;
+			void demote(int32_t key, size_t size) override;
+			int32_t victim(const Evictable &evictable) override;
+
+		private:
+			/* most recently used key at the front */
+			std::list<int32_t>                                        m_order;
+			std::unordered_map<int32_t, std::list<int32_t>::iterator> m_entries;
+		};
+
+		/* S3-FIFO: a small probationary queue, a main queue and a ghost queue of recently evicted keys
+		 *
+		 * new objects enter the small queue and only move on to the main queue if they are opened
+		 * again before reaching its head, which keeps one-off files from pushing out the hot set.
+		 * keys that come back while they are still remembered in the ghost queue go straight to main.
+		 */
+		class S3FifoPolicy : public EvictionPolicy
+		{
+		public:
+			const char* name(void) const override { return "s3fifo"; }
+
+			void insert(int32_t key, size_t size) override;
+			void access(int32_t key) override;
+			void remove(int32_t key) override;
+			void demote(int32_t key, size_t size) override;
+			int32_t victim(const Evictable &evictable) override;
+
+		private:
+			struct Entry
+			{
+				size_t                       size;
+				uint8_t                      freq;
+				bool                         main;
+				std::list<int32_t>::iterator pos;
+			};
+
+			void rememberGhost(int32_t key);
+
+			std::list<int32_t>                                        m_small;
+			std::list<int32_t>                                        m_main;
+			std::list<int32_t>                                        m_ghost;
+			std::unordered_map<int32_t, Entry>                        m_entries;
+			std::unordered_map<int32_t, std::list<int32_t>::iterator> m_ghostEntries;
+
+			size_t                                                    m_smallSize = 0;
+			size_t                                                    m_totalSize = 0;
+		};
+	}
+}
@@ -0,0 +1,83 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* file system access as needed to scan overlays and keep their index
+		 *
+		 * Win32FileSystem is used by the Redirector, MemoryFileSystem builds
+		 * synthetic overlay trees without touching the disk.
+		 * implementations have to be safe to call from several scan workers at once.
+		 */
+		class IFileSystem
+		{
+		public:
+			struct Entry
+			{
+				std::string name;
+				bool        directory;
+			};
+
+			/* read-only contents of a whole file, valid until the object is destroyed */
+			class MappedFile
+			{
+			public:
+				virtual ~MappedFile(void) {};
+
+				virtual const void* data(void) const = 0;
+				virtual size_t size(void) const = 0;
+			};
+
+			virtual ~IFileSystem(void) {};
+
+			/* all entries of directory whose name matches pattern ('*' and '?', case insensitive),
+			 * returns false if there are none (or the directory does not exist)
+			 */
+			virtual bool listDirectory(const std::string &directory, const std::string &pattern, std::vector<Entry> &entries) const = 0;
+
+			/* last-write time of a directory in 100ns units (FILETIME), 0 if it does not exist */
+			virtual uint64_t lastWriteTime(const std::string &directory) const = 0;
+
+			/* map an existing file, returns nullptr if it is missing or empty */
+			virtual std::unique_ptr<MappedFile> mapFile(const std::string &path) const = 0;
+
+			/* create or replace a file - readers see either the old or the new contents, never a mix */
+			virtual bool replaceFile(const std::string &path, const std::vector<char> &contents) const = 0;
+		};
+	}
+}
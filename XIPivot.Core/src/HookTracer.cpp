@@ -0,0 +1,269 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "HookTracer.h"
+
+#include <chrono>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		namespace
+		{
+			static constexpr DWORD sFlushInterval = 50; // ms between draining the thread rings
+		}
+
+		std::atomic<bool> HookTracer::s_active(false);
+		HookTracer*       HookTracer::s_instance = nullptr;
+
+		/* rings are never freed, only passed on - a thread may still hold its pointer after tracing stopped */
+		thread_local HookTracer::ThreadRingOwner HookTracer::s_threadRing;
+
+		HookTracer::ThreadRingOwner::~ThreadRingOwner(void)
+		{
+			if (ring != nullptr && HookTracer::s_instance != nullptr)
+			{
+				/* records the thread left behind are still drained, the next owner just continues after them */
+				std::lock_guard<std::mutex> lock(HookTracer::s_instance->m_ringLock);
+				HookTracer::s_instance->m_freeRings.push_back(ring);
+			}
+		}
+
+		HookTracer& HookTracer::instance(void)
+		{
+			if (HookTracer::s_instance == nullptr)
+			{
+				HookTracer::s_instance = new HookTracer();
+			}
+			return *HookTracer::s_instance;
+		}
+
+		HookTracer::HookTracer(void)
+			: m_frequency(0),
+			  m_flushStop(false),
+			  m_file(nullptr)
+		{
+			LARGE_INTEGER frequency;
+			QueryPerformanceFrequency(&frequency);
+			m_frequency = frequency.QuadPart;
+		}
+
+		HookTracer::~HookTracer(void)
+		{
+			stop();
+		}
+
+		int64_t HookTracer::begin(void)
+		{
+			if (active() == false)
+			{
+				return 0;
+			}
+
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			return counter.QuadPart;
+		}
+
+		void HookTracer::end(int64_t start, TraceEvent event, uint16_t flags, int32_t pathKey, uint64_t arg)
+		{
+			/* start is 0 if tracing was switched on in the middle of the hook */
+			if (start == 0 || active() == false)
+			{
+				return;
+			}
+
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+
+			auto& self = instance();
+
+			TraceRecord record;
+			record.ticks = static_cast<uint64_t>(start);
+			record.threadId = 0;
+			record.event = static_cast<uint16_t>(event);
+			record.flags = flags;
+			record.pathKey = pathKey;
+			record.durationUs = static_cast<uint32_t>((counter.QuadPart - start) * 1000000 / self.m_frequency);
+			record.arg = arg;
+
+			self.push(record);
+		}
+
+		bool HookTracer::start(const std::string& path)
+		{
+			stop();
+
+			if (fopen_s(&m_file, path.c_str(), "wb") != 0 || m_file == nullptr)
+			{
+				m_file = nullptr;
+				return false;
+			}
+
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+
+			const TraceFileHeader header = { sHookTraceMagic, sHookTraceVersion, static_cast<uint64_t>(m_frequency), static_cast<uint64_t>(counter.QuadPart) };
+			fwrite(&header, sizeof(header), 1, m_file);
+
+			{
+				/* hooks that were already past active() when the last trace stopped may have left records behind */
+				std::lock_guard<std::mutex> lock(m_ringLock);
+				for (auto& ring : m_rings)
+				{
+					ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+					ring->dropped = 0;
+				}
+			}
+
+			m_flushStop = false;
+			m_flushThread = std::thread(&HookTracer::flushWorker, this);
+
+			s_active.store(true);
+			return true;
+		}
+
+		void HookTracer::stop(void)
+		{
+			s_active.store(false);
+
+			if (m_flushThread.joinable())
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_flushLock);
+					m_flushStop = true;
+				}
+				m_flushSignal.notify_all();
+				m_flushThread.join();
+			}
+
+			if (m_file != nullptr)
+			{
+				fclose(m_file);
+				m_file = nullptr;
+			}
+		}
+
+		/* private stuff */
+
+		HookTracer::ThreadRing* HookTracer::threadRing(void)
+		{
+			ThreadRing*& ring = s_threadRing.ring;
+			if (ring == nullptr)
+			{
+				/* once per thread, everything after this is lock-free */
+				std::unique_lock<std::mutex> lock(m_ringLock);
+				if (m_freeRings.empty() == false)
+				{
+					ring = m_freeRings.back();
+					m_freeRings.pop_back();
+				}
+				else
+				{
+					lock.unlock();
+					auto newRing = std::make_unique<ThreadRing>();
+
+					lock.lock();
+					ring = newRing.get();
+					m_rings.emplace_back(std::move(newRing));
+				}
+
+				/* drain reads it for TraceEvent::Dropped records */
+				ring->threadId = GetCurrentThreadId();
+			}
+			return ring;
+		}
+
+		void HookTracer::push(const TraceRecord& record)
+		{
+			ThreadRing* ring = threadRing();
+
+			const uint32_t head = ring->head.load(std::memory_order_relaxed);
+			if (head - ring->tail.load(std::memory_order_acquire) >= sRingSize)
+			{
+				++ring->dropped;
+				return;
+			}
+
+			TraceRecord& slot = ring->records[head & (sRingSize - 1)];
+			slot = record;
+			slot.threadId = ring->threadId;
+
+			ring->head.store(head + 1, std::memory_order_release);
+		}
+
+		void HookTracer::flushWorker(void)
+		{
+			std::vector<TraceRecord> records;
+			records.reserve(sRingSize);
+
+			bool stopping = false;
+			while (stopping == false)
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_flushLock);
+					m_flushSignal.wait_for(lock, std::chrono::milliseconds(sFlushInterval), [this]() { return m_flushStop; });
+					stopping = m_flushStop;
+				}
+
+				/* one last pass after stopping picks up whatever the hooks wrote meanwhile */
+				records.clear();
+				drain(records);
+				if (records.empty() == false)
+				{
+					fwrite(records.data(), sizeof(TraceRecord), records.size(), m_file);
+				}
+			}
+			fflush(m_file);
+		}
+
+		void HookTracer::drain(std::vector<TraceRecord>& out)
+		{
+			std::lock_guard<std::mutex> lock(m_ringLock);
+			for (auto& ring : m_rings)
+			{
+				const uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+				const uint32_t head = ring->head.load(std::memory_order_acquire);
+				for (uint32_t i = tail; i != head; ++i)
+				{
+					out.push_back(ring->records[i & (sRingSize - 1)]);
+				}
+				ring->tail.store(head, std::memory_order_release);
+
+				const uint32_t dropped = ring->dropped.exchange(0);
+				if (dropped != 0)
+				{
+					LARGE_INTEGER counter;
+					QueryPerformanceCounter(&counter);
+					out.push_back({ static_cast<uint64_t>(counter.QuadPart), ring->threadId, static_cast<uint16_t>(TraceEvent::Dropped), 0, -1, 0, dropped });
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,125 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "TraceFormat.h"
+
+#include <Windows.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* binary trace of the intercepted file operations
+		 *
+		 * every thread writes fixed-size TraceRecords into its own lock-free ring buffer,
+		 * a background thread drains them into a file every sFlushInterval ms.
+		 * the ring of an exited thread is handed to the next new one, so the number of rings
+		 * stays at the number of threads that ever traced at the same time.
+		 * records that don't fit into a full ring are counted and reported as a single
+		 * TraceEvent::Dropped record instead of blocking the game.
+		 *
+		 * hooks only pay for an atomic load while tracing is off:
+		 *
+		 *   const int64_t start = HookTracer::begin();
+		 *   ...
+		 *   HookTracer::end(start, TraceEvent::ReadFile, flags, pathKey, bytes);
+		 */
+		class HookTracer
+		{
+		public:
+			virtual ~HookTracer(void);
+
+			static HookTracer& instance(void);
+
+			static bool active(void) { return s_active.load(std::memory_order_relaxed); }
+
+			/* QPC timestamp if tracing, 0 otherwise */
+			static int64_t begin(void);
+			static void end(int64_t start, TraceEvent event, uint16_t flags, int32_t pathKey, uint64_t arg);
+
+			/* start writing to path (replacing it), stop drains everything that is left */
+			bool start(const std::string& path);
+			void stop(void);
+
+		private:
+			static constexpr size_t sRingSize = 4096; /* records per thread, power of two */
+
+			struct ThreadRing
+			{
+				TraceRecord           records[sRingSize];
+				std::atomic<uint32_t> head = 0;    /* written by the owning thread */
+				std::atomic<uint32_t> tail = 0;    /* written by the flusher */
+				std::atomic<uint32_t> dropped = 0;
+				uint32_t              threadId = 0;
+			};
+
+			/* hands the ring of a thread back to m_freeRings once the thread exits */
+			struct ThreadRingOwner
+			{
+				ThreadRing* ring = nullptr;
+				~ThreadRingOwner(void);
+			};
+
+			HookTracer(void);
+
+			ThreadRing* threadRing(void);
+			void push(const TraceRecord& record);
+
+			void flushWorker(void);
+			void drain(std::vector<TraceRecord>& out);
+
+			static std::atomic<bool> s_active;
+			static HookTracer*       s_instance;
+
+			static thread_local ThreadRingOwner s_threadRing;
+
+			int64_t                                  m_frequency;
+
+			std::mutex                               m_ringLock;
+			std::vector<std::unique_ptr<ThreadRing>> m_rings;
+			std::vector<ThreadRing*>                 m_freeRings; /* owned by m_rings, their threads have exited */
+
+			std::mutex                               m_flushLock;
+			std::condition_variable                  m_flushSignal;
+			std::thread                              m_flushThread;
+			bool                                     m_flushStop;
+			FILE*                                    m_file;
+		};
+	}
+}
@@ -0,0 +1,255 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Lz4Block.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr size_t sMinMatch = 4;        /* shortest match the format can express */
+	constexpr size_t sLastLiterals = 5;    /* the last 5 bytes of a block are always literals */
+	constexpr size_t sMatchLimit = 12;     /* no match may start within the last 12 bytes */
+	constexpr size_t sMaxOffset = 0xffff;
+	constexpr unsigned sHashBits = 12;
+
+	inline uint32_t read32(const uint8_t *p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t hash32(uint32_t sequence)
+	{
+		return (sequence * 2654435761U) >> (32 - sHashBits);
+	}
+}
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		size_t Lz4Block::compressBound(size_t size)
+		{
+			return size + size / 255 + 16;
+		}
+
+		size_t Lz4Block::compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity)
+		{
+			const uint8_t *ip = src;
+			const uint8_t *anchor = src;
+			const uint8_t *const end = src + srcSize;
+
+			uint8_t *op = dst;
+			uint8_t *const opEnd = dst + dstCapacity;
+
+			if (srcSize > sMatchLimit)
+			{
+				uint32_t table[1 << sHashBits] = { 0 };
+
+				const uint8_t *const matchLimit = end - sMatchLimit;
+				const uint8_t *const matchEnd = end - sLastLiterals;
+
+				size_t misses = 0;
+				while (ip < matchLimit)
+				{
+					const uint32_t sequence = read32(ip);
+					const uint32_t h = hash32(sequence);
+
+					const uint8_t *ref = src + table[h];
+					table[h] = static_cast<uint32_t>(ip - src);
+
+					if (ref >= ip || static_cast<size_t>(ip - ref) > sMaxOffset || read32(ref) != sequence)
+					{
+						/* skip through incompressible data faster the longer it goes on */
+						ip += 1 + (misses++ >> 6);
+						continue;
+					}
+					misses = 0;
+
+					/* extend the match in both directions */
+					while (ip > anchor && ref > src && ip[-1] == ref[-1])
+					{
+						--ip;
+						--ref;
+					}
+
+					const uint8_t *mp = ip + sMinMatch;
+					const uint8_t *rp = ref + sMinMatch;
+					while (mp < matchEnd && *mp == *rp)
+					{
+						++mp;
+						++rp;
+					}
+
+					const size_t literals = static_cast<size_t>(ip - anchor);
+					const size_t matchLength = static_cast<size_t>(mp - ip) - sMinMatch;
+
+					if (static_cast<size_t>(opEnd - op) < 1 + literals / 255 + 1 + literals + 2 + matchLength / 255 + 1)
+					{
+						return 0;
+					}
+
+					uint8_t *token = op++;
+					*token = static_cast<uint8_t>((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(matchLength, 15));
+
+					op = writeLength(op, literals);
+					memcpy(op, anchor, literals);
+					op += literals;
+
+					const size_t offset = static_cast<size_t>(ip - ref);
+					*op++ = static_cast<uint8_t>(offset);
+					*op++ = static_cast<uint8_t>(offset >> 8);
+
+					op = writeLength(op, matchLength);
+
+					ip = mp;
+					anchor = ip;
+				}
+			}
+
+			/* everything left over goes out as literals */
+			const size_t literals = static_cast<size_t>(end - anchor);
+			if (static_cast<size_t>(opEnd - op) < 1 + literals / 255 + 1 + literals)
+			{
+				return 0;
+			}
+
+			*op++ = static_cast<uint8_t>(std::min<size_t>(literals, 15) << 4);
+			op = writeLength(op, literals);
+			memcpy(op, anchor, literals);
+			op += literals;
+
+			return static_cast<size_t>(op - dst);
+		}
+
+		bool Lz4Block::decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize)
+		{
+			const uint8_t *ip = src;
+			const uint8_t *const ipEnd = src + srcSize;
+
+			uint8_t *op = dst;
+			uint8_t *const opEnd = dst + dstSize;
+
+			while (ip < ipEnd)
+			{
+				const uint8_t token = *ip++;
+
+				size_t literals = token >> 4;
+				if (literals == 15 && readLength(ip, ipEnd, literals) == false)
+				{
+					return false;
+				}
+
+				if (literals > static_cast<size_t>(ipEnd - ip) || literals > static_cast<size_t>(opEnd - op))
+				{
+					return false;
+				}
+				memcpy(op, ip, literals);
+				ip += literals;
+				op += literals;
+
+				if (ip == ipEnd)
+				{
+					/* the last sequence has no match */
+					break;
+				}
+
+				if (ipEnd - ip < 2)
+				{
+					return false;
+				}
+				const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+				ip += 2;
+
+				if (offset == 0 || offset > static_cast<size_t>(op - dst))
+				{
+					return false;
+				}
+
+				size_t matchLength = token & 15;
+				if (matchLength == 15 && readLength(ip, ipEnd, matchLength) == false)
+				{
+					return false;
+				}
+				matchLength += sMinMatch;
+
+				if (matchLength > static_cast<size_t>(opEnd - op))
+				{
+					return false;
+				}
+
+				const uint8_t *match = op - offset;
+				if (offset >= matchLength)
+				{
+					memcpy(op, match, matchLength);
+					op += matchLength;
+				}
+				else
+				{
+					/* overlapping copy, repeats the last `offset` bytes */
+					for (size_t i = 0; i < matchLength; ++i)
+					{
+						*op++ = *match++;
+					}
+				}
+			}
+			return op == opEnd;
+		}
+
+		uint8_t *Lz4Block::writeLength(uint8_t *op, size_t length)
+		{
+			if (length >= 15)
+			{
+				for (length -= 15; length >= 255; length -= 255)
+				{
+					*op++ = 255;
+				}
+				*op++ = static_cast<uint8_t>(length);
+			}
+			return op;
+		}
+
+		bool Lz4Block::readLength(const uint8_t *&ip, const uint8_t *ipEnd, size_t &length)
+		{
+			uint8_t value;
+			do
+			{
+				if (ip >= ipEnd)
+				{
+					return false;
+				}
+				value = *ip++;
+				length += value;
+			} while (value == 255);
+			return true;
+		}
+	}
+}
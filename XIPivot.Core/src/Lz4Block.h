@@ -0,0 +1,61 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* minimal LZ4 block format codec used by MemCache's compressed tier
+		 *
+		 * the output is a plain LZ4 block (no frame, no checksums) produced by a
+		 * single-probe greedy matcher: not the best ratio, but fast enough to compress
+		 * DATs on the loading path and decompression is a simple copy loop.
+		 */
+		class Lz4Block
+		{
+		public:
+			/* worst case output size for incompressible input */
+			static size_t compressBound(size_t size);
+
+			/* returns the compressed size, 0 if the output didn't fit into dstCapacity */
+			static size_t compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity);
+
+			/* returns true if src decoded to exactly dstSize bytes */
+			static bool decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize);
+
+		private:
+			static uint8_t *writeLength(uint8_t *op, size_t length);
+			static bool readLength(const uint8_t *&ip, const uint8_t *ipEnd, size_t &length);
+		};
+	}
+}
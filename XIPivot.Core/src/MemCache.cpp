@@ -27,8 +27,13 @@
  */
 
 #include "MemCache.h"
+#include "Lz4Block.h"
+#include "HookTracer.h"
 #include "detours.h"
 
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 #include <cctype>
 #include <ctime>
 
@@ -40,11 +45,197 @@ namespace XiPivot
 
 		namespace {
 			static constexpr size_t sMaxCacheObjectSize = 104857599U; // 100MB -1byte
+			static constexpr size_t sChunkSize = 0x10000;             // 64KB, the allocation granularity
+
+			static constexpr DWORD  sPrefetchIdleTime = 250;          // ms without game reads before prefetching continues
+			static constexpr size_t sMaxHistoryEntries = 1024;        // most frequently opened keys kept between sessions
+
+			static constexpr DWORD  sTraceBurstGap = 2000;            // ms without opens before the next open starts a new trace
+			static constexpr size_t sMaxTraceLength = 512;            // keys recorded after a single trigger
+			static constexpr size_t sMaxTraces = 4096;                // triggers kept between sessions
+
+			static constexpr size_t sMinCompressSize = 0x1000;        // smaller objects are simply evicted
+
+			static constexpr uint32_t sTraceMagic = 0x54504958;       // "XIPT"
+			static constexpr uint32_t sTraceVersion = 1;
+
+			static constexpr char sHistoryFile[] = "/pivot-history.txt";
+			static constexpr char sTraceFile[] = "/pivot-trace.bin";
+
+			bool chunk_resident(const std::vector<uint64_t>& residentChunks, size_t chunk)
+			{
+				return (residentChunks[chunk / 64] & (uint64_t(1) << (chunk % 64))) != 0;
+			}
+
+			/* the game opens "C:\\FFXI//ROM/1/2.DAT" while overlays and prefetch requests use other spellings,
+			 * lower case with single backslashes makes all of them comparable.
+			 */
+			std::string normalise_source(const char* path)
+			{
+				std::string source;
+				if (path != nullptr)
+				{
+					source.reserve(strlen(path));
+					for (const char* p = path; *p != '\0'; ++p)
+					{
+						const char c = (*p == '/') ? '\\' : static_cast<char>(tolower(static_cast<unsigned char>(*p)));
+						if (c != '\\' || source.size() < 2 || source.back() != '\\')
+						{
+							source.push_back(c);
+						}
+					}
+				}
+				return source;
+			}
+
+			/* XXH64, used to find cache objects with identical contents */
+			static constexpr uint64_t sPrime64_1 = 0x9E3779B185EBCA87ULL;
+			static constexpr uint64_t sPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+			static constexpr uint64_t sPrime64_3 = 0x165667B19E3779F9ULL;
+			static constexpr uint64_t sPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+			static constexpr uint64_t sPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+			inline uint64_t rotl64(uint64_t value, int bits)
+			{
+				return (value << bits) | (value >> (64 - bits));
+			}
+
+			inline uint64_t read64(const BYTE* data)
+			{
+				uint64_t value;
+				memcpy(&value, data, sizeof(value));
+				return value;
+			}
+
+			inline uint32_t read32(const BYTE* data)
+			{
+				uint32_t value;
+				memcpy(&value, data, sizeof(value));
+				return value;
+			}
+
+			inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+			{
+				return rotl64(acc + input * sPrime64_2, 31) * sPrime64_1;
+			}
+
+			inline uint64_t xxh64_merge(uint64_t acc, uint64_t value)
+			{
+				return (acc ^ xxh64_round(0, value)) * sPrime64_1 + sPrime64_4;
+			}
+
+			uint64_t content_hash(const BYTE* data, size_t length)
+			{
+				const BYTE* const end = data + length;
+				uint64_t hash;
+
+				if (length >= 32)
+				{
+					uint64_t v1 = sPrime64_1 + sPrime64_2;
+					uint64_t v2 = sPrime64_2;
+					uint64_t v3 = 0;
+					uint64_t v4 = 0 - sPrime64_1;
+
+					for (const BYTE* const limit = end - 32; data <= limit; data += 32)
+					{
+						v1 = xxh64_round(v1, read64(data));
+						v2 = xxh64_round(v2, read64(data + 8));
+						v3 = xxh64_round(v3, read64(data + 16));
+						v4 = xxh64_round(v4, read64(data + 24));
+					}
+
+					hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+					hash = xxh64_merge(hash, v1);
+					hash = xxh64_merge(hash, v2);
+					hash = xxh64_merge(hash, v3);
+					hash = xxh64_merge(hash, v4);
+				}
+				else
+				{
+					hash = sPrime64_5;
+				}
+
+				hash += static_cast<uint64_t>(length);
+
+				for (; data + 8 <= end; data += 8)
+				{
+					hash = rotl64(hash ^ xxh64_round(0, read64(data)), 27) * sPrime64_1 + sPrime64_4;
+				}
+				if (data + 4 <= end)
+				{
+					hash = rotl64(hash ^ (read32(data) * sPrime64_1), 23) * sPrime64_2 + sPrime64_3;
+					data += 4;
+				}
+				for (; data < end; ++data)
+				{
+					hash = rotl64(hash ^ (*data * sPrime64_5), 11) * sPrime64_1;
+				}
+
+				hash ^= hash >> 33;
+				hash *= sPrime64_2;
+				hash ^= hash >> 29;
+				hash *= sPrime64_3;
+				hash ^= hash >> 32;
+				return hash;
+			}
+
+			/* NTSTATUS values stored in OVERLAPPED::Internal (ntstatus.h doesn't mix with Windows.h) */
+			static constexpr ULONG_PTR sStatusSuccess = 0x00000000;
+			static constexpr ULONG_PTR sStatusEndOfFile = 0xC0000011;
+
+			uint64_t overlapped_offset(const OVERLAPPED* overlapped)
+			{
+				return (static_cast<uint64_t>(overlapped->OffsetHigh) << 32) | overlapped->Offset;
+			}
+
+			/* fill in an OVERLAPPED the way a synchronously completed read would, GetOverlappedResult relies on it
+			 * returns the ERROR_* code of the request
+			 */
+			DWORD complete_overlapped(OVERLAPPED* overlapped, DWORD bytesToRead, DWORD bytesRead, bool signalEvent)
+			{
+				if (bytesToRead > 0 && bytesRead == 0)
+				{
+					overlapped->Internal = sStatusEndOfFile;
+					overlapped->InternalHigh = 0;
+					return ERROR_HANDLE_EOF;
+				}
+
+				overlapped->Internal = sStatusSuccess;
+				overlapped->InternalHigh = bytesRead;
+
+				/* the low bit only tells the kernel to skip the completion port */
+				HANDLE hEvent = reinterpret_cast<HANDLE>(reinterpret_cast<ULONG_PTR>(overlapped->hEvent) & ~ULONG_PTR(1));
+				if (signalEvent && hEvent != nullptr)
+				{
+					SetEvent(hEvent);
+				}
+				return NO_ERROR;
+			}
+
+			/* ReadFileEx completion routines run as an APC once the thread waits alertably */
+			struct ReadCompletion
+			{
+				LPOVERLAPPED_COMPLETION_ROUTINE routine;
+				DWORD                           error;
+				DWORD                           bytesRead;
+				LPOVERLAPPED                    overlapped;
+			};
+
+			void CALLBACK run_read_completion(ULONG_PTR param)
+			{
+				const auto completion = reinterpret_cast<ReadCompletion*>(param);
+				completion->routine(completion->error, completion->bytesRead, completion->overlapped);
+				delete completion;
+			}
 		}
 		MemCache* MemCache::s_instance = nullptr;
 
 		MemCache::pFnReadFile    MemCache::s_procReadFile = ReadFile;
+		MemCache::pFnReadFileEx  MemCache::s_procReadFileEx = ReadFileEx;
 		MemCache::pFnCloseHandle MemCache::s_procCloseHandle = CloseHandle;
+		MemCache::pFnSetFilePointer   MemCache::s_procSetFilePointer = SetFilePointer;
+		MemCache::pFnSetFilePointerEx MemCache::s_procSetFilePointerEx = SetFilePointerEx;
+		MemCache::pFnCreateIoCompletionPort MemCache::s_procCreateIoCompletionPort = CreateIoCompletionPort;
 
 		/* static interface */
 		MemCache& MemCache::instance(void)
@@ -61,13 +252,25 @@ namespace XiPivot
 			/* don't use the Singleton access here;
 			 * if for whatever reason the global object is gone we don't want a new one
 			 */
-			if (MemCache::s_instance != nullptr || a4 != nullptr)
+			if (MemCache::s_instance != nullptr)
 			{
 				return MemCache::s_instance->interceptReadFile(a0, a1, a2, a3, a4);
 			}
 			return MemCache::s_procReadFile(a0, a1, a2, a3, a4);
 		}
 
+		BOOL __stdcall MemCache::dReadFileEx(HANDLE a0, LPVOID a1, DWORD a2, LPOVERLAPPED a3, LPOVERLAPPED_COMPLETION_ROUTINE a4)
+		{
+			/* don't use the Singleton access here;
+			 * if for whatever reason the global object is gone we don't want a new one
+			 */
+			if (MemCache::s_instance != nullptr)
+			{
+				return MemCache::s_instance->interceptReadFileEx(a0, a1, a2, a3, a4);
+			}
+			return MemCache::s_procReadFileEx(a0, a1, a2, a3, a4);
+		}
+
 		BOOL __stdcall MemCache::dCloseHandle(HANDLE a0)
 		{
 			/* don't use the Singleton access here;
@@ -80,9 +283,54 @@ namespace XiPivot
 			return MemCache::s_procCloseHandle(a0);
 		}
 
+		DWORD __stdcall MemCache::dSetFilePointer(HANDLE a0, LONG a1, PLONG a2, DWORD a3)
+		{
+			/* don't use the Singleton access here;
+			 * if for whatever reason the global object is gone we don't want a new one
+			 */
+			if (MemCache::s_instance != nullptr)
+			{
+				return MemCache::s_instance->interceptSetFilePointer(a0, a1, a2, a3);
+			}
+			return MemCache::s_procSetFilePointer(a0, a1, a2, a3);
+		}
+
+		BOOL __stdcall MemCache::dSetFilePointerEx(HANDLE a0, LARGE_INTEGER a1, PLARGE_INTEGER a2, DWORD a3)
+		{
+			/* don't use the Singleton access here;
+			 * if for whatever reason the global object is gone we don't want a new one
+			 */
+			if (MemCache::s_instance != nullptr)
+			{
+				return MemCache::s_instance->interceptSetFilePointerEx(a0, a1, a2, a3);
+			}
+			return MemCache::s_procSetFilePointerEx(a0, a1, a2, a3);
+		}
+
+		HANDLE __stdcall MemCache::dCreateIoCompletionPort(HANDLE a0, HANDLE a1, ULONG_PTR a2, DWORD a3)
+		{
+			/* don't use the Singleton access here;
+			 * if for whatever reason the global object is gone we don't want a new one
+			 */
+			if (MemCache::s_instance != nullptr)
+			{
+				return MemCache::s_instance->interceptCreateIoCompletionPort(a0, a1, a2, a3);
+			}
+			return MemCache::s_procCreateIoCompletionPort(a0, a1, a2, a3);
+		}
+
 		MemCache::MemCache()
 			: m_hooksSet(false),
-			  m_stats({ 0, 0, 0, 0, 0, 0 }),
+			  m_cacheMode(CacheMode::Heap),
+			  m_policy(std::make_unique<LruPolicy>()),
+			  m_handleSlots(new std::atomic<CachePointer*>[sHandleSlots]()),
+			  m_overflowHandles(0),
+			  m_traceTrigger(-1),
+			  m_traceStart(0),
+			  m_lastOpen(0),
+			  m_prefetchStop(false),
+			  m_urgentPending(0),
+			  m_lastRead(0),
 			  m_logDebug(IDelegate::LogLevel::Discard)
 		{
 			m_logger = DummyDelegate::instance();
@@ -90,12 +338,22 @@ namespace XiPivot
 
 		MemCache::~MemCache()
 		{
+			stopPrefetch();
 			releaseHooks(); // just in case
 
-			m_cachePointers.clear();
-
+			for (size_t i = 0; i < sHandleSlots; ++i)
+			{
+				delete m_handleSlots[i].exchange(nullptr);
+			}
+			for (auto& shard : m_pointerShards)
+			{
+				for (auto& pointer : shard.pointers)
+				{
+					delete pointer.second;
+				}
+				shard.pointers.clear();
+			}
 			purgeCacheObjects(0);
-			m_cacheObjects.clear();
 		}
 
 		void MemCache::setLogProvider(IDelegate* newLogProvider)
@@ -117,14 +375,18 @@ namespace XiPivot
 				DetourUpdateThread(GetCurrentThread());
 
 				DetourAttach(&(PVOID&)MemCache::s_procReadFile, MemCache::dReadFile);
+				DetourAttach(&(PVOID&)MemCache::s_procReadFileEx, MemCache::dReadFileEx);
 				DetourAttach(&(PVOID&)MemCache::s_procCloseHandle, MemCache::dCloseHandle);
+				DetourAttach(&(PVOID&)MemCache::s_procSetFilePointer, MemCache::dSetFilePointer);
+				DetourAttach(&(PVOID&)MemCache::s_procSetFilePointerEx, MemCache::dSetFilePointerEx);
+				DetourAttach(&(PVOID&)MemCache::s_procCreateIoCompletionPort, MemCache::dCreateIoCompletionPort);
 
 				m_hooksSet = DetourTransactionCommit() == NO_ERROR;
 
 				m_logger->logMessageF(IDelegate::LogLevel::Info, "m_hooksSet = %s", m_hooksSet ? "true" : "false");
 				return m_hooksSet;
 			}
-			m_logger->logMessage(m_logDebug, "hooks already set");
+			XIPIVOT_LOG(m_logger, m_logDebug, "hooks already set");
 			return false;
 		}
 
@@ -137,14 +399,18 @@ namespace XiPivot
 				DetourUpdateThread(GetCurrentThread());
 
 				DetourDetach(&(PVOID&)MemCache::s_procReadFile, MemCache::dReadFile);
+				DetourDetach(&(PVOID&)MemCache::s_procReadFileEx, MemCache::dReadFileEx);
 				DetourDetach(&(PVOID&)MemCache::s_procCloseHandle, MemCache::dCloseHandle);
+				DetourDetach(&(PVOID&)MemCache::s_procSetFilePointer, MemCache::dSetFilePointer);
+				DetourDetach(&(PVOID&)MemCache::s_procSetFilePointerEx, MemCache::dSetFilePointerEx);
+				DetourDetach(&(PVOID&)MemCache::s_procCreateIoCompletionPort, MemCache::dCreateIoCompletionPort);
 
 				m_hooksSet = (DetourTransactionCommit() == NO_ERROR) ? false : true;
 
 				m_logger->logMessageF(IDelegate::LogLevel::Info, "m_hooksSet = %s", m_hooksSet ? "true" : "false");
 				return m_hooksSet;
 			}
-			m_logger->logMessage(m_logDebug, "hooks already removed");
+			XIPIVOT_LOG(m_logger, m_logDebug, "hooks already removed");
 			return false;
 		}
 
@@ -157,238 +423,1204 @@ namespace XiPivot
 		void MemCache::setCacheAllocation(size_t allocationSize)
 		{
 			/* this changes the allowed allocation but it does not trigger a cache purge */
-			m_logger->logMessageF(IDelegate::LogLevel::Info, "changing cache allocation to %dMB", allocationSize / 0x100000);
+			m_logger->logMessageF(IDelegate::LogLevel::Info, "changing cache allocation to %zuMB", allocationSize / 0x100000);
 			m_stats.allocation = allocationSize;
 		}
-	
-		/* track and cache a file handle for a given key */
-		HANDLE MemCache::trackCacheObject(HANDLE hRef, int32_t pathKey)
-		{
-			if (m_hooksSet && m_stats.allocation != 0 && hRef != nullptr && pathKey != -1)
-			{
-				if (m_cachePointers.find(reinterpret_cast<ptrdiff_t>(hRef)) == m_cachePointers.end())
-				{
 
-					auto cacheObj = getCachedObject(hRef, pathKey);
-					if (cacheObj != nullptr)
-					{
-						++cacheObj->ref;
-						m_cachePointers.emplace(reinterpret_cast<ptrdiff_t>(hRef), CachePointer({ pathKey }));
-						m_logger->logMessageF(m_logDebug, "started to track HANDLE %p => %d", hRef, pathKey);
-					}
-				}
-			}
-			return hRef;
+		void MemCache::setCacheMode(CacheMode mode)
+		{
+			m_logger->logMessageF(IDelegate::LogLevel::Info, "m_cacheMode = %s", mode == CacheMode::Mapped ? "Mapped" : "Heap");
+			m_cacheMode = mode;
 		}
 
-		size_t MemCache::purgeCacheObjects(time_t maxAge)
+		void MemCache::setEvictionPolicy(std::unique_ptr<EvictionPolicy> policy)
 		{
-			if (m_inSyscall)
+			if (policy == nullptr)
 			{
-				return 0;
+				return;
 			}
+			m_logger->logMessageF(IDelegate::LogLevel::Info, "m_policy = %s", policy->name());
 
-			size_t objectsPurged = 0;
-			time_t oldAge = time(nullptr) - maxAge;
-
-			for (auto it = m_cacheObjects.cbegin(); it != m_cacheObjects.cend();)
+			std::lock_guard<std::mutex> lock(m_policyLock);
+			for (auto& shard : m_objectShards)
 			{
-				if (it->second->lastUse < oldAge && it->second->ref < 1)
-				{
-					if (m_inSyscall == false)
-					{
-
-						m_logger->logMessageF(m_logDebug, "purgeCacheObjects: removing %d (%zd bytes)", it->first, it->second->size);
-
-						auto obj = it->second;
-						m_cacheObjects.erase(it++);
-
-						m_stats.used -= obj->size;
-						--m_stats.activeObjects;
-
-						delete[] obj->data;
-						delete obj;
-
-						++objectsPurged;
-					}
-				}
-				else
+				std::lock_guard<std::mutex> shardLock(shard.lock);
+				for (const auto& obj : shard.objects)
 				{
-					++it;
+					policy->insert(obj.first, obj.second->size);
 				}
 			}
-
-			m_stats.cacheIgnored = 0;
-
-			return objectsPurged;
+			m_policy = std::move(policy);
 		}
 
-		/* static hooks */
-
-		BOOL __stdcall
-			MemCache::interceptReadFile(HANDLE a0, LPVOID a1, DWORD a2, LPDWORD a3, LPOVERLAPPED a4)
+		const char* MemCache::getEvictionPolicy(void) const
 		{
-			m_inSyscall.store(true);
-			if (performCachedRead(a0, a1, a2, a3) == true)
-			{
-				m_inSyscall.store(false);
-				return true;
-			}
-			m_inSyscall.store(false);
-			return MemCache::s_procReadFile(a0, a1, a2, a3, a4);
+			std::lock_guard<std::mutex> lock(m_policyLock);
+			return m_policy->name();
 		}
 
-		BOOL __stdcall
-			MemCache::interceptCloseHandle(HANDLE a0)
+		void MemCache::setPrefetch(bool enabled, const std::string& statePath)
 		{
-			m_inSyscall.store(true);
-			const auto it = m_cachePointers.find(reinterpret_cast<ptrdiff_t>(a0));
-			if (it != m_cachePointers.end())
+			stopPrefetch();
+
+			if (enabled)
 			{
-				m_logger->logMessageF(m_logDebug, "stopped tracking HANDLE %p", a0);
+				m_statePath = statePath;
 
-				auto cacheObj = getCachedObject(nullptr, it->second.pathKey);
-				if (cacheObj != nullptr)
+				std::unique_lock<std::mutex> lock(m_historyLock);
+				if (m_accessHistory.empty())
+				{
+					loadAccessHistory(m_statePath + sHistoryFile);
+				}
+				if (m_accessTraces.empty())
 				{
-					--cacheObj->ref;
+					loadAccessTraces(m_statePath + sTraceFile);
 				}
-				m_cachePointers.erase(it);
+				lock.unlock();
+
+				m_prefetchStop = false;
+				m_prefetchThread = std::thread(&MemCache::prefetchWorker, this);
+				queuePrefetch({});
 			}
-			m_inSyscall.store(false);
-			return MemCache::s_procCloseHandle(a0);
+			m_logger->logMessageF(IDelegate::LogLevel::Info, "m_prefetch = %s", enabled ? "true" : "false");
 		}
 
-		/* private stuff */
-
-		MemCache::CacheObject* MemCache::getCachedObject(HANDLE hRef, int32_t pathKey)
+		void MemCache::queuePrefetch(const std::vector<PrefetchRequest>& requests)
 		{
-			auto cachedObj = m_cacheObjects.find(pathKey);
-			if (cachedObj != m_cacheObjects.end())
+			if (getPrefetch() == false)
 			{
-				++m_stats.cacheHits;
-				return cachedObj->second;
+				return;
 			}
 
-			if (hRef == nullptr)
+			std::deque<PrefetchRequest> queue;
 			{
-				/* not in cache and no way to create it */
-				++m_stats.cacheMisses;
-				return nullptr;
-			}
+				std::lock_guard<std::mutex> lock(m_historyLock);
 
-			size_t size = GetFileSize(hRef, nullptr);
-			if (size > sMaxCacheObjectSize)
-			{
-				/* do NOT cache objects above sMaxCacheObjectSize lower the risk of "blackouts"
-				 * caused by XI running out of available memory */
-				m_logger->logMessageF(IDelegate::LogLevel::Debug, "getCachedObject: object size exceeds limit, no cache object created.");
-				++m_stats.cacheIgnored;
-				return nullptr;
+				/* the recorded path might belong to an overlay that has been removed or reordered since,
+				 * the worker resolves these once it gets to them.
+				 */
+				for (const auto& record : rankedAccessHistory())
+				{
+					queue.push_back({ record.first, {} });
+				}
+				for (const auto& request : requests)
+				{
+					if (m_accessHistory.find(request.pathKey) == m_accessHistory.end())
+					{
+						queue.push_back(request);
+					}
+				}
 			}
 
-			/* try and create a new object on the fly and store it */
-			CacheObject* obj = new (std::nothrow) CacheObject;
-			if (obj != nullptr)
+			XIPIVOT_LOG(m_logger, m_logDebug, "queuePrefetch: %zu requests", queue.size());
 			{
-				if (m_stats.used + size <= m_stats.allocation)
-				{
-					memset(obj, 0, sizeof(CacheObject));
-					obj->data = new (std::nothrow) BYTE[size];
-					obj->size = size;
-					obj->ref = 0;
+				std::lock_guard<std::mutex> lock(m_prefetchLock);
 
-					if (obj->data != nullptr)
+				/* replayed traces that haven't been handled yet stay in front */
+				for (auto it = m_prefetchQueue.rbegin(); it != m_prefetchQueue.rend(); ++it)
+				{
+					if (it->urgent)
 					{
-						/* read the actual data into memory */
+						queue.push_front(*it);
+					}
+				}
+				m_prefetchQueue = std::move(queue);
+			}
+			m_prefetchSignal.notify_one();
+		}
 
-						if(readObjectData(hRef, *obj))
-						{
-							m_stats.used += obj->size;
-							++m_stats.activeObjects;
+		void MemCache::setPathResolver(PathResolver resolver)
+		{
+			std::lock_guard<std::mutex> lock(m_prefetchLock);
+			m_pathResolver = std::move(resolver);
+		}
+	
+		/* track and cache a file handle for a given key */
+		HANDLE MemCache::trackCacheObject(HANDLE hRef, int32_t pathKey, const char* path)
+		{
+			if (m_hooksSet && m_stats.allocation != 0 && hRef != nullptr && hRef != INVALID_HANDLE_VALUE && pathKey != -1)
+			{
+				const int64_t start = LatencyHistogram::now();
+				const int64_t traceStart = HookTracer::begin();
 
-							obj->lastUse = time(nullptr);
-							m_cacheObjects.emplace(pathKey, obj);
+				recordAccess(pathKey);
+				m_telemetry.recordOpen(pathKey);
 
-							m_logger->logMessageF(m_logDebug, "getCachedObject: created cache object for %p => %zd bytes", hRef, obj->size);
+				if (lookupHandle(hRef) != nullptr)
+				{
+					return hRef;
+				}
 
-							++m_stats.cacheMisses;
-							return obj;
-						}
+				bool cached = false;
+				auto cacheObj = acquireCachedObject(hRef, pathKey, normalise_source(path), true, cached);
+				if (cached)
+				{
+					++m_stats.cacheHits;
+				}
 
-						delete[] obj->data;
+				{
+					std::lock_guard<std::mutex> lock(m_policyLock);
+					m_policy->recordLookup(cached);
+					if (cached)
+					{
+						m_policy->access(pathKey);
 					}
 				}
-				else
+
+				if (cacheObj != nullptr)
 				{
-					m_logger->logMessageF(IDelegate::LogLevel::Warn, "getCachedObject: cache limit exceeded");
+					/* the one kernel round-trip for this handle, from here on the offset is ours */
+					LARGE_INTEGER offset = { 0 };
+					MemCache::s_procSetFilePointerEx(hRef, offset, &offset, FILE_CURRENT);
+
+					auto pointer = new CachePointer;
+					pointer->object = cacheObj;
+					pointer->offset = static_cast<uint64_t>(offset.QuadPart);
+					pointer->pathKey = pathKey;
+					pointer->completionPort = false;
+
+					if (trackHandle(hRef, pointer))
+					{
+						XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "started to track HANDLE %p => %d", hRef, pathKey);
+					}
+					else
+					{
+						delete pointer;
+						--cacheObj->ref;
+					}
 				}
-				delete obj;
+				m_telemetry.recordLatency(CacheTelemetry::Operation::Open, start);
+				HookTracer::end(traceStart, TraceEvent::CacheOpen, cached ? TraceCacheHit : TraceCacheMiss, pathKey, reinterpret_cast<uintptr_t>(hRef));
 			}
-			++m_stats.cacheMisses;
-			return nullptr;
+			return hRef;
 		}
 
-		bool MemCache::readObjectData(HANDLE hRef, CacheObject& obj)
+		size_t MemCache::invalidateCacheObjects(const std::vector<int32_t>& pathKeys)
 		{
-			if (hRef == nullptr || obj.data == nullptr)
-			{
-				return false;
-			}
-
-			SetFilePointer(hRef, 0, nullptr, FILE_BEGIN);
-
-			size_t readSize = 0;
-			while (readSize < obj.size)
+			size_t objectsDropped = 0;
+			for (const auto pathKey : pathKeys)
 			{
-				DWORD bytesRead = 0;
-				if (MemCache::s_procReadFile(hRef, &obj.data[readSize], obj.size - readSize, &bytesRead, nullptr) == FALSE)
+				bool cached = false;
 				{
-					m_logger->logMessageF(IDelegate::LogLevel::Warn, "readObjectData: aborting read with %zd / %zd bytes", readSize, obj.size);
-					break;
+					auto& shard = objectShard(pathKey);
+					std::lock_guard<std::mutex> shardLock(shard.lock);
+					cached = shard.objects.find(pathKey) != shard.objects.end();
 				}
 
-				readSize += bytesRead;
-
-				if (bytesRead == 0)
+				if (cached && dropCacheObject(pathKey, CacheTelemetry::EvictReason::Stale))
 				{
-					break;
+					++objectsDropped;
 				}
 			}
-
-			SetFilePointer(hRef, 0, nullptr, FILE_BEGIN);
-			return readSize == obj.size;
+			XIPIVOT_LOG(m_logger, m_logDebug, "invalidateCacheObjects: %zu changed keys, %zu objects dropped", pathKeys.size(), objectsDropped);
+			return objectsDropped;
 		}
 
-		bool MemCache::performCachedRead(HANDLE hRef, LPVOID lpBuffer, DWORD bytesToRead, LPDWORD bytesRead)
+		size_t MemCache::purgeCacheObjects(time_t maxAge)
 		{
-			if (hRef == nullptr || lpBuffer == nullptr)
+			size_t objectsPurged = 0;
+			time_t oldAge = time(nullptr) - maxAge;
+
+			std::vector<CacheObject*> purged;
 			{
-				return false;
+				/* objects leave the shards and the policy together, see acquireCachedObject */
+				std::lock_guard<std::mutex> lock(m_policyLock);
+				for (auto& shard : m_objectShards)
+				{
+					std::lock_guard<std::mutex> shardLock(shard.lock);
+					for (auto it = shard.objects.cbegin(); it != shard.objects.cend();)
+					{
+						if (it->second->lastUse < oldAge && it->second->ref < 1)
+						{
+							XIPIVOT_LOG(m_logger, m_logDebug, "purgeCacheObjects: removing %d (%zu bytes)", it->first, it->second->resident.load());
+
+							m_policy->remove(it->first);
+							purged.push_back(it->second);
+							shard.objects.erase(it++);
+						}
+						else
+						{
+							if (it->second->ref < 1)
+							{
+								/* without handles nobody can still be copying from a replaced buffer */
+								releaseRetiredData(*it->second);
+							}
+							++it;
+						}
+					}
+				}
 			}
 
-			const auto pointer = m_cachePointers.find(reinterpret_cast<ptrdiff_t>(hRef));
-			if (pointer == m_cachePointers.end())
+			for (auto obj : purged)
 			{
-				/* not tracked */
-				return false;
+				releaseCacheObject(obj);
+				m_telemetry.recordEviction(CacheTelemetry::EvictReason::Age);
+				++objectsPurged;
 			}
 
-			const auto cacheObj = getCachedObject(nullptr, pointer->second.pathKey);
-			if (cacheObj == nullptr)
-			{
-				/* tracked but no longer cached -- this should actually NEVER EVER HAPPEN */
-				m_logger->logMessageF(IDelegate::LogLevel::Error, "performCachedRead: cache object for %p (%d) vanished, untracking HANDLE.", hRef, pointer->second.pathKey);
-				m_cachePointers.erase(pointer);
+			m_stats.cacheIgnored = 0;
 
-				return MemCache::s_procReadFile(hRef, lpBuffer, bytesToRead, bytesRead, nullptr) == TRUE;
-			}
+			return objectsPurged;
+		}
 
-			/* everything valid - touch the object to keep it alive */
-			cacheObj->lastUse = time(nullptr);
+		MemCache::CacheStatus MemCache::getCacheStats(void) const
+		{
+			CacheStatus stats;
+			stats.used = m_stats.used;
+			stats.allocation = m_stats.allocation;
+			stats.cacheHits = m_stats.cacheHits;
+			stats.cacheMisses = m_stats.cacheMisses;
+			stats.cacheIgnored = m_stats.cacheIgnored;
+			stats.activeObjects = m_stats.activeObjects;
+			stats.evictedObjects = m_stats.evictedObjects;
+			stats.compressedObjects = m_stats.compressedObjects;
+			stats.compressedSize = m_stats.compressedSize;
+
+			std::lock_guard<std::mutex> lock(m_policyLock);
+			stats.policy = m_policy->name();
+			stats.policyHitRatio = m_policy->hitRatio();
+			return stats;
+		}
 
-			/* update the stored offset in case the handle was seeked in */
-			DWORD fileOffset = SetFilePointer(hRef, 0, nullptr, FILE_CURRENT);
-			if (fileOffset >= cacheObj->size)
+		CacheTelemetry::Snapshot MemCache::getTelemetry(size_t topKeys) const
+		{
+			return m_telemetry.snapshot(topKeys);
+		}
+
+		void MemCache::resetTelemetry(void)
+		{
+			m_telemetry.reset();
+		}
+
+		/* static hooks */
+
+		BOOL __stdcall
+			MemCache::interceptReadFile(HANDLE a0, LPVOID a1, DWORD a2, LPDWORD a3, LPOVERLAPPED a4)
+		{
+			/* the prefetch worker backs off while reads are coming in */
+			m_lastRead.store(GetTickCount(), std::memory_order_relaxed);
+
+			CachePointer* pointer = lookupHandle(a0);
+			if (pointer == nullptr || (a4 != nullptr && pointer->completionPort.load(std::memory_order_relaxed)))
+			{
+				/* a read completed here would never show up at the completion port */
+				return MemCache::s_procReadFile(a0, a1, a2, a3, a4);
+			}
+
+			const int64_t start = LatencyHistogram::now();
+			const int64_t traceStart = HookTracer::begin();
+
+			/* overlapped reads are addressed by their OVERLAPPED, even on synchronous handles */
+			const uint64_t offset = (a4 != nullptr) ? overlapped_offset(a4) : pointer->offset.load();
+
+			DWORD bytesRead = 0;
+			bool fromDisk = false;
+			if (performCachedRead(a0, *pointer, offset, a1, a2, bytesRead, fromDisk) == true)
+			{
+				HookTracer::end(traceStart, TraceEvent::ReadFile, TraceCacheHit | (fromDisk ? TraceFromDisk : 0), pointer->pathKey, bytesRead);
+
+				if (a3 != nullptr)
+				{
+					*a3 = bytesRead;
+				}
+
+				if (a4 != nullptr)
+				{
+					/* a synchronous read at EOF succeeds with 0 bytes, an overlapped one fails */
+					const DWORD error = complete_overlapped(a4, a2, bytesRead, true);
+					if (error != NO_ERROR)
+					{
+						SetLastError(error);
+						return FALSE;
+					}
+				}
+				return TRUE;
+			}
+
+			/* performCachedRead synced the real file pointer, pick up wherever the real read left it */
+			const BOOL result = MemCache::s_procReadFile(a0, a1, a2, a3, a4);
+
+			if (a4 == nullptr)
+			{
+				LARGE_INTEGER realOffset = { 0 };
+				if (MemCache::s_procSetFilePointerEx(a0, realOffset, &realOffset, FILE_CURRENT))
+				{
+					pointer->offset = static_cast<uint64_t>(realOffset.QuadPart);
+				}
+			}
+			else if (result && a3 != nullptr)
+			{
+				/* handles opened with FILE_FLAG_OVERLAPPED have no file pointer to ask,
+				 * synchronous ones moved theirs past the bytes read */
+				pointer->offset = offset + *a3;
+			}
+
+			recordRead(start, true, (result && a3 != nullptr) ? *a3 : 0);
+			HookTracer::end(traceStart, TraceEvent::ReadFile, TraceFallback | (result ? 0 : TraceFailed), pointer->pathKey, (result && a3 != nullptr) ? *a3 : 0);
+			return result;
+		}
+
+		BOOL __stdcall
+			MemCache::interceptReadFileEx(HANDLE a0, LPVOID a1, DWORD a2, LPOVERLAPPED a3, LPOVERLAPPED_COMPLETION_ROUTINE a4)
+		{
+			m_lastRead.store(GetTickCount(), std::memory_order_relaxed);
+
+			CachePointer* pointer = lookupHandle(a0);
+			if (pointer == nullptr || a3 == nullptr || a4 == nullptr || pointer->completionPort.load(std::memory_order_relaxed))
+			{
+				return MemCache::s_procReadFileEx(a0, a1, a2, a3, a4);
+			}
+
+			const int64_t start = LatencyHistogram::now();
+			const int64_t traceStart = HookTracer::begin();
+
+			DWORD bytesRead = 0;
+			bool fromDisk = false;
+			if (performCachedRead(a0, *pointer, overlapped_offset(a3), a1, a2, bytesRead, fromDisk) == false)
+			{
+				/* the size only shows up in the completion routine */
+				const BOOL result = MemCache::s_procReadFileEx(a0, a1, a2, a3, a4);
+				recordRead(start, true, 0);
+				HookTracer::end(traceStart, TraceEvent::ReadFileEx, TraceFallback | (result ? 0 : TraceFailed), pointer->pathKey, 0);
+				return result;
+			}
+			HookTracer::end(traceStart, TraceEvent::ReadFileEx, TraceCacheHit | (fromDisk ? TraceFromDisk : 0), pointer->pathKey, bytesRead);
+
+			/* ReadFileEx leaves hEvent to the caller, only the completion routine reports back */
+			auto completion = new ReadCompletion({ a4, complete_overlapped(a3, a2, bytesRead, false), bytesRead, a3 });
+			if (QueueUserAPC(run_read_completion, GetCurrentThread(), reinterpret_cast<ULONG_PTR>(completion)) == 0)
+			{
+				delete completion;
+				return FALSE;
+			}
+			return TRUE;
+		}
+
+		BOOL __stdcall
+			MemCache::interceptCloseHandle(HANDLE a0)
+		{
+			/* the slot has to be cleared before the handle value can be reused */
+			CachePointer* pointer = untrackHandle(a0);
+			if (pointer != nullptr)
+			{
+				const int64_t traceStart = HookTracer::begin();
+
+				XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "stopped tracking HANDLE %p", a0);
+				--pointer->object->ref;
+
+				const int32_t pathKey = pointer->pathKey;
+				delete pointer;
+
+				const BOOL result = MemCache::s_procCloseHandle(a0);
+				HookTracer::end(traceStart, TraceEvent::CloseHandle, result ? 0 : TraceFailed, pathKey, reinterpret_cast<uintptr_t>(a0));
+				return result;
+			}
+			return MemCache::s_procCloseHandle(a0);
+		}
+
+		DWORD __stdcall
+			MemCache::interceptSetFilePointer(HANDLE a0, LONG a1, PLONG a2, DWORD a3)
+		{
+			CachePointer* pointer = lookupHandle(a0);
+			if (pointer == nullptr)
+			{
+				return MemCache::s_procSetFilePointer(a0, a1, a2, a3);
+			}
+
+			const int64_t traceStart = HookTracer::begin();
+
+			/* without a high part the distance is a signed 32bit value */
+			const int64_t distance = (a2 != nullptr) ? static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(*a2)) << 32) | static_cast<uint32_t>(a1)) : a1;
+
+			uint64_t offset = 0;
+			if (seekCachePointer(*pointer, distance, a3, offset) == false)
+			{
+				HookTracer::end(traceStart, TraceEvent::SetFilePointer, TraceFailed, pointer->pathKey, 0);
+				return INVALID_SET_FILE_POINTER;
+			}
+			HookTracer::end(traceStart, TraceEvent::SetFilePointer, 0, pointer->pathKey, offset);
+
+			if (a2 != nullptr)
+			{
+				*a2 = static_cast<LONG>(offset >> 32);
+			}
+			return static_cast<DWORD>(offset);
+		}
+
+		BOOL __stdcall
+			MemCache::interceptSetFilePointerEx(HANDLE a0, LARGE_INTEGER a1, PLARGE_INTEGER a2, DWORD a3)
+		{
+			CachePointer* pointer = lookupHandle(a0);
+			if (pointer == nullptr)
+			{
+				return MemCache::s_procSetFilePointerEx(a0, a1, a2, a3);
+			}
+
+			const int64_t traceStart = HookTracer::begin();
+
+			uint64_t offset = 0;
+			if (seekCachePointer(*pointer, a1.QuadPart, a3, offset) == false)
+			{
+				HookTracer::end(traceStart, TraceEvent::SetFilePointer, TraceFailed, pointer->pathKey, 0);
+				return FALSE;
+			}
+			HookTracer::end(traceStart, TraceEvent::SetFilePointer, 0, pointer->pathKey, offset);
+
+			if (a2 != nullptr)
+			{
+				a2->QuadPart = static_cast<LONGLONG>(offset);
+			}
+			return TRUE;
+		}
+
+		HANDLE __stdcall
+			MemCache::interceptCreateIoCompletionPort(HANDLE a0, HANDLE a1, ULONG_PTR a2, DWORD a3)
+		{
+			const HANDLE hPort = MemCache::s_procCreateIoCompletionPort(a0, a1, a2, a3);
+
+			/* INVALID_HANDLE_VALUE only creates a new port */
+			CachePointer* pointer = (hPort != nullptr && a0 != INVALID_HANDLE_VALUE) ? lookupHandle(a0) : nullptr;
+			if (pointer != nullptr)
+			{
+				XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "HANDLE %p bound to completion port %p", a0, hPort);
+				pointer->completionPort = true;
+			}
+			return hPort;
+		}
+
+		/* private stuff */
+
+		MemCache::CachePointer* MemCache::lookupHandle(HANDLE hRef)
+		{
+			const size_t slot = reinterpret_cast<size_t>(hRef) >> 2;
+			if (slot < sHandleSlots)
+			{
+				return m_handleSlots[slot].load(std::memory_order_acquire);
+			}
+
+			if (m_overflowHandles == 0)
+			{
+				return nullptr;
+			}
+
+			auto& shard = pointerShard(hRef);
+			std::shared_lock<std::shared_mutex> lock(shard.lock);
+
+			const auto it = shard.pointers.find(reinterpret_cast<ptrdiff_t>(hRef));
+			return (it != shard.pointers.end()) ? it->second : nullptr;
+		}
+
+		bool MemCache::trackHandle(HANDLE hRef, CachePointer* pointer)
+		{
+			const size_t slot = reinterpret_cast<size_t>(hRef) >> 2;
+			if (slot < sHandleSlots)
+			{
+				CachePointer* expected = nullptr;
+				return m_handleSlots[slot].compare_exchange_strong(expected, pointer, std::memory_order_acq_rel);
+			}
+
+			auto& shard = pointerShard(hRef);
+			std::lock_guard<std::shared_mutex> lock(shard.lock);
+			if (shard.pointers.emplace(reinterpret_cast<ptrdiff_t>(hRef), pointer).second)
+			{
+				++m_overflowHandles;
+				return true;
+			}
+			return false;
+		}
+
+		MemCache::CachePointer* MemCache::untrackHandle(HANDLE hRef)
+		{
+			const size_t slot = reinterpret_cast<size_t>(hRef) >> 2;
+			if (slot < sHandleSlots)
+			{
+				/* cheap check first, most closed handles were never tracked */
+				if (m_handleSlots[slot].load(std::memory_order_relaxed) == nullptr)
+				{
+					return nullptr;
+				}
+				return m_handleSlots[slot].exchange(nullptr, std::memory_order_acq_rel);
+			}
+
+			if (m_overflowHandles == 0)
+			{
+				return nullptr;
+			}
+
+			auto& shard = pointerShard(hRef);
+			std::lock_guard<std::shared_mutex> lock(shard.lock);
+
+			const auto it = shard.pointers.find(reinterpret_cast<ptrdiff_t>(hRef));
+			if (it == shard.pointers.end())
+			{
+				return nullptr;
+			}
+
+			CachePointer* pointer = it->second;
+			shard.pointers.erase(it);
+			--m_overflowHandles;
+			return pointer;
+		}
+
+		MemCache::CacheObject* MemCache::acquireCachedObject(HANDLE hRef, int32_t pathKey, const std::string& source, bool evict, bool& cached)
+		{
+			auto& shard = objectShard(pathKey);
+			CacheObject* obj = nullptr;
+			bool stale = false;
+			{
+				std::lock_guard<std::mutex> lock(shard.lock);
+				const auto it = shard.objects.find(pathKey);
+				if (it != shard.objects.end())
+				{
+					if (it->second->source == source)
+					{
+						++it->second->ref;
+
+						cached = true;
+						obj = it->second;
+					}
+					else
+					{
+						stale = true;
+					}
+				}
+			}
+
+			/* the key resolves to a different file now (the overlays changed), the old contents must not be served */
+			if (stale && dropCacheObject(pathKey, CacheTelemetry::EvictReason::Stale) == false)
+			{
+				XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "acquireCachedObject: %d is stale but still in use", pathKey);
+
+				cached = false;
+				++m_stats.cacheIgnored;
+				return nullptr;
+			}
+
+			if (obj != nullptr)
+			{
+				/* our reference keeps makeRoom from compressing it again */
+				std::lock_guard<std::mutex> lock(obj->populateLock);
+				decompressObject(*obj, evict);
+				return obj;
+			}
+			cached = false;
+
+			/* the shard isn't held while creating, making room might have to evict from it */
+			obj = createCachedObject(hRef, pathKey, evict);
+			if (obj == nullptr)
+			{
+				return nullptr;
+			}
+			obj->source = source;
+
+			CacheObject* winner = nullptr;
+			bool inserted = false;
+			{
+				std::lock_guard<std::mutex> lock(m_policyLock);
+				{
+					std::lock_guard<std::mutex> shardLock(shard.lock);
+					const auto it = shard.objects.emplace(pathKey, obj);
+					if (it.second)
+					{
+						++obj->ref;
+						inserted = true;
+					}
+					else if (it.first->second->source == source)
+					{
+						/* another thread was faster, use its object instead */
+						++it.first->second->ref;
+						winner = it.first->second;
+					}
+				}
+
+				if (inserted)
+				{
+					m_stats.used += obj->resident;
+					++m_stats.activeObjects;
+					m_policy->insert(pathKey, obj->size);
+					return obj;
+				}
+
+				releaseObjectData(*obj);
+				delete obj;
+			}
+
+			if (winner == nullptr)
+			{
+				/* the faster thread opened another path for the same key, leave this handle uncached */
+				++m_stats.cacheIgnored;
+				return nullptr;
+			}
+
+			/* the winner may have been closed and compressed by makeRoom before we got our reference,
+			 * so it takes the same path as an object found by the lookup above.
+			 */
+			std::lock_guard<std::mutex> lock(winner->populateLock);
+			decompressObject(*winner, evict);
+			return winner;
+		}
+
+		MemCache::CacheObject* MemCache::createCachedObject(HANDLE hRef, int32_t pathKey, bool evict)
+		{
+			size_t size = GetFileSize(hRef, nullptr);
+			if (size > sMaxCacheObjectSize)
+			{
+				/* do NOT cache objects above sMaxCacheObjectSize lower the risk of "blackouts"
+				 * caused by XI running out of available memory */
+				XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "createCachedObject: object size exceeds limit, no cache object created.");
+				++m_stats.cacheIgnored;
+				return nullptr;
+			}
+
+			/* try and create a new object on the fly */
+			CacheObject* obj = new (std::nothrow) CacheObject;
+			if (obj != nullptr)
+			{
+				if (evict)
+				{
+					makeRoom(size);
+				}
+
+				if (m_stats.used + size <= m_stats.allocation)
+				{
+					obj->size = size;
+
+					/* nothing is read up-front in either mode:
+					 * mapped objects are backed by the file itself and heap objects
+					 * are populated by performCachedRead as the data is needed.
+					 */
+					const bool created = (m_cacheMode == CacheMode::Mapped) ? mapObjectData(hRef, *obj) : reserveObjectData(*obj);
+					if (created)
+					{
+						/* heap objects count their chunks as they become resident */
+						obj->resident = obj->mapped ? obj->size : 0;
+						obj->lastUse = time(nullptr);
+
+						XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "createCachedObject: created %s cache object for %p => %zu bytes", obj->mapped ? "mapped" : "heap", hRef, obj->size);
+
+						++m_stats.cacheMisses;
+						return obj;
+					}
+				}
+				else
+				{
+					m_logger->logMessageF(IDelegate::LogLevel::Warn, "createCachedObject: cache limit exceeded");
+				}
+				delete obj;
+			}
+			++m_stats.cacheMisses;
+			return nullptr;
+		}
+
+		bool MemCache::dropCacheObject(int32_t pathKey, CacheTelemetry::EvictReason reason)
+		{
+			CacheObject* obj = nullptr;
+			{
+				/* objects leave the shards and the policy together, see acquireCachedObject */
+				std::lock_guard<std::mutex> lock(m_policyLock);
+
+				auto& shard = objectShard(pathKey);
+				std::lock_guard<std::mutex> shardLock(shard.lock);
+
+				const auto it = shard.objects.find(pathKey);
+				if (it == shard.objects.end())
+				{
+					return true;
+				}
+				if (it->second->ref > 0)
+				{
+					return false;
+				}
+
+				m_policy->remove(pathKey);
+				obj = it->second;
+				shard.objects.erase(it);
+			}
+
+			XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "dropCacheObject: removing %d (%zu bytes)", pathKey, obj->resident.load());
+
+			releaseCacheObject(obj);
+			m_telemetry.recordEviction(reason);
+			return true;
+		}
+
+		bool MemCache::makeRoom(size_t size)
+		{
+			while (m_stats.used + size > m_stats.allocation)
+			{
+				int32_t pathKey = -1;
+				CacheObject* victim = nullptr;
+				CacheObject* evicted = nullptr;
+				{
+					std::lock_guard<std::mutex> lock(m_policyLock);
+
+					/* objects with open handles (or being prefetched) have to stay */
+					pathKey = m_policy->victim([this](int32_t key)
+					{
+						auto& shard = objectShard(key);
+						std::lock_guard<std::mutex> shardLock(shard.lock);
+
+						const auto it = shard.objects.find(key);
+						return it != shard.objects.end() && it->second->ref < 1;
+					});
+
+					if (pathKey == -1)
+					{
+						return false;
+					}
+
+					auto& shard = objectShard(pathKey);
+					std::lock_guard<std::mutex> shardLock(shard.lock);
+
+					/* it might have been opened again since the policy picked it */
+					const auto it = shard.objects.find(pathKey);
+					if (it != shard.objects.end() && it->second->ref < 1)
+					{
+						CacheObject* obj = it->second;
+						if (obj->mapped == false && obj->compressed == nullptr && obj->size >= sMinCompressSize && obj->resident == obj->size)
+						{
+							/* pinned, purges and other makeRoom calls skip it while it is compressed */
+							++obj->ref;
+							victim = obj;
+						}
+						else
+						{
+							m_policy->remove(pathKey);
+							shard.objects.erase(it);
+							evicted = obj;
+						}
+					}
+				}
+
+				if (victim != nullptr)
+				{
+					/* compressing a large object takes a while, only opens of this very object wait for it */
+					bool compressed = false;
+					{
+						std::lock_guard<std::mutex> populateLock(victim->populateLock);
+						compressed = compressObject(*victim);
+					}
+
+					std::lock_guard<std::mutex> lock(m_policyLock);
+					auto& shard = objectShard(pathKey);
+					std::lock_guard<std::mutex> shardLock(shard.lock);
+
+					--victim->ref;
+					if (compressed)
+					{
+						/* a second chance in the compressed tier, the next pick evicts it for good */
+						m_policy->demote(pathKey, victim->compressedSize);
+						m_telemetry.recordEviction(CacheTelemetry::EvictReason::Compressed);
+					}
+					else if (victim->ref < 1)
+					{
+						m_policy->remove(pathKey);
+						shard.objects.erase(pathKey);
+						evicted = victim;
+					}
+				}
+
+				if (evicted != nullptr)
+				{
+					XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "makeRoom: evicting %d (%zu bytes)", pathKey, evicted->resident.load());
+
+					releaseCacheObject(evicted);
+					++m_stats.evictedObjects;
+					m_telemetry.recordEviction(CacheTelemetry::EvictReason::Capacity);
+				}
+			}
+			return true;
+		}
+
+		void MemCache::releaseCacheObject(CacheObject* obj)
+		{
+			if (obj->content == nullptr)
+			{
+				m_stats.used -= obj->resident;
+			}
+			else if (releaseSharedContent(obj->content))
+			{
+				/* shared contents count towards the allocation once */
+				m_stats.used -= obj->size;
+			}
+			--m_stats.activeObjects;
+
+			releaseObjectData(*obj);
+			delete obj;
+		}
+
+		bool MemCache::reserveObjectData(CacheObject& obj)
+		{
+			/* only address space is reserved here, chunks are committed once they are read */
+			obj.data = static_cast<PBYTE>(VirtualAlloc(nullptr, std::max<size_t>(obj.size, 1), MEM_RESERVE, PAGE_READWRITE));
+			obj.residentChunks.assign((obj.size + sChunkSize * 64 - 1) / (sChunkSize * 64), 0);
+			return obj.data != nullptr;
+		}
+
+		bool MemCache::populateObjectData(HANDLE hRef, CacheObject& obj, size_t offset, size_t length)
+		{
+			if (obj.mapped)
+			{
+				return true;
+			}
+
+			const size_t lastChunk = (offset + length - 1) / sChunkSize;
+			for (size_t chunk = offset / sChunkSize; chunk <= lastChunk; ++chunk)
+			{
+				if (chunk_resident(obj.residentChunks, chunk) == false && readObjectChunk(hRef, obj, chunk) == false)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool MemCache::readObjectChunk(HANDLE hRef, CacheObject& obj, size_t chunk)
+		{
+			const size_t chunkOffset = chunk * sChunkSize;
+			const size_t chunkSize = std::min(sChunkSize, obj.size - chunkOffset);
+
+			PBYTE chunkData = commitObjectChunk(obj, chunk, true);
+			if (chunkData == nullptr)
+			{
+				return false;
+			}
+
+			const int64_t start = LatencyHistogram::now();
+
+			/* read at an explicit offset like beginChunkRead does, this works for synchronous handles
+			 * and for the FILE_FLAG_OVERLAPPED ones ReadFileEx is used with alike.
+			 */
+			OVERLAPPED overlapped;
+			memset(&overlapped, 0, sizeof(overlapped));
+			overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
+			size_t readSize = 0;
+			while (readSize < chunkSize)
+			{
+				const uint64_t readOffset = chunkOffset + readSize;
+				overlapped.Offset = static_cast<DWORD>(readOffset);
+				overlapped.OffsetHigh = static_cast<DWORD>(readOffset >> 32);
+				if (overlapped.hEvent != nullptr)
+				{
+					ResetEvent(overlapped.hEvent);
+				}
+
+				/* the real ReadFile - our own hook would count this as a game read */
+				DWORD bytesRead = 0;
+				const BOOL started = MemCache::s_procReadFile(hRef, &chunkData[readSize], static_cast<DWORD>(chunkSize - readSize), nullptr, &overlapped);
+				if ((started == FALSE && GetLastError() != ERROR_IO_PENDING) ||
+					GetOverlappedResult(hRef, &overlapped, &bytesRead, TRUE) == FALSE || bytesRead == 0)
+				{
+					m_logger->logMessageF(IDelegate::LogLevel::Warn, "readObjectChunk: aborting read with %zu / %zu bytes", readSize, chunkSize);
+					break;
+				}
+				readSize += bytesRead;
+			}
+
+			if (overlapped.hEvent != nullptr)
+			{
+				MemCache::s_procCloseHandle(overlapped.hEvent);
+			}
+
+			if (readSize != chunkSize)
+			{
+				VirtualFree(chunkData, chunkSize, MEM_DECOMMIT);
+				return false;
+			}
+
+			markChunkResident(obj, chunk);
+			m_telemetry.recordLatency(CacheTelemetry::Operation::Populate, start);
+			return true;
+		}
+
+		PBYTE MemCache::commitObjectChunk(CacheObject& obj, size_t chunk, bool evict)
+		{
+			const size_t chunkOffset = chunk * sChunkSize;
+			const size_t chunkSize = std::min(sChunkSize, obj.size - chunkOffset);
+
+			if (evict)
+			{
+				/* obj itself is referenced by the handle being read and can't be picked */
+				makeRoom(chunkSize);
+			}
+
+			if (m_stats.used + chunkSize > m_stats.allocation)
+			{
+				XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "commitObjectChunk: cache limit exceeded");
+				return nullptr;
+			}
+			return static_cast<PBYTE>(VirtualAlloc(obj.data.load() + chunkOffset, chunkSize, MEM_COMMIT, PAGE_READWRITE));
+		}
+
+		void MemCache::markChunkResident(CacheObject& obj, size_t chunk)
+		{
+			const size_t chunkSize = std::min(sChunkSize, obj.size - chunk * sChunkSize);
+
+			obj.residentChunks[chunk / 64] |= uint64_t(1) << (chunk % 64);
+			obj.resident += chunkSize;
+			m_stats.used += chunkSize;
+
+			if (obj.resident == obj.size)
+			{
+				shareObjectContent(obj);
+			}
+		}
+
+		void MemCache::shareObjectContent(CacheObject& obj)
+		{
+			if (obj.mapped || obj.content != nullptr || obj.size == 0)
+			{
+				return;
+			}
+
+			/* one pass over data that was just read anyway, XXH64 is far faster than the disk */
+			const PBYTE data = obj.data;
+			const uint64_t hash = content_hash(data, obj.size);
+
+			std::lock_guard<std::mutex> lock(m_contentLock);
+
+			const auto range = m_sharedContent.equal_range(hash);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				SharedContent* content = it->second;
+				if (content->size == obj.size && memcmp(content->data, data, obj.size) == 0)
+				{
+					/* readers that already loaded data keep using our own buffer until their handles are closed */
+					++content->refs;
+					obj.content = content;
+					obj.retired = data;
+					obj.data = content->data;
+
+					/* our own buffer stays counted in m_stats.used until releaseRetiredData frees it */
+					XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "shareObjectContent: sharing %zu bytes (%016llx)", obj.size, hash);
+					return;
+				}
+			}
+
+			/* first object with these contents, its buffer becomes the shared one */
+			obj.content = new SharedContent({ hash, obj.size, data, 1 });
+			m_sharedContent.emplace(hash, obj.content);
+		}
+
+		bool MemCache::releaseSharedContent(SharedContent* content)
+		{
+			std::lock_guard<std::mutex> lock(m_contentLock);
+			if (--content->refs > 0)
+			{
+				return false;
+			}
+
+			const auto range = m_sharedContent.equal_range(content->hash);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				if (it->second == content)
+				{
+					m_sharedContent.erase(it);
+					break;
+				}
+			}
+
+			VirtualFree(content->data, 0, MEM_RELEASE);
+			delete content;
+			return true;
+		}
+
+		bool MemCache::compressObject(CacheObject& obj)
+		{
+			/* only complete heap objects, mapped ones are paged by Windows anyway */
+			if (obj.mapped || obj.compressed != nullptr || obj.size < sMinCompressSize || obj.resident != obj.size)
+			{
+				return false;
+			}
+
+			SharedContent* content = obj.content;
+			if (content != nullptr)
+			{
+				/* take the buffer out of the content table first so nobody starts sharing it */
+				std::lock_guard<std::mutex> lock(m_contentLock);
+				if (content->refs > 1)
+				{
+					return false;
+				}
+
+				const auto range = m_sharedContent.equal_range(content->hash);
+				for (auto it = range.first; it != range.second; ++it)
+				{
+					if (it->second == content)
+					{
+						m_sharedContent.erase(it);
+						break;
+					}
+				}
+			}
+
+			const PBYTE data = obj.data;
+			std::vector<BYTE> buffer(Lz4Block::compressBound(obj.size));
+			const size_t compressedSize = Lz4Block::compress(data, obj.size, buffer.data(), buffer.size());
+
+			PBYTE compressed = nullptr;
+			if (compressedSize != 0 && compressedSize <= obj.size - obj.size / 4)
+			{
+				compressed = new (std::nothrow) BYTE[compressedSize];
+			}
+
+			if (compressed == nullptr)
+			{
+				if (content != nullptr)
+				{
+					std::lock_guard<std::mutex> lock(m_contentLock);
+					m_sharedContent.emplace(content->hash, content);
+				}
+				return false;
+			}
+			memcpy(compressed, buffer.data(), compressedSize);
+
+			XIPIVOT_HOOK_LOG(m_logger, m_logDebug, "compressObject: %zu => %zu bytes", obj.size, compressedSize);
+
+			delete content;
+			obj.content = nullptr;
+
+			releaseRetiredData(obj);
+			VirtualFree(data, 0, MEM_RELEASE);
+			obj.data = nullptr;
+
+			obj.compressed = compressed;
+			obj.compressedSize = compressedSize;
+			obj.resident = compressedSize;
+
+			m_stats.used -= obj.size - compressedSize;
+			m_stats.compressedSize += compressedSize;
+			++m_stats.compressedObjects;
+			return true;
+		}
+
+		bool MemCache::decompressObject(CacheObject& obj, bool evict)
+		{
+			if (obj.compressed == nullptr)
+			{
+				return true;
+			}
+
+			if (evict)
+			{
+				/* obj itself is referenced and can't be picked */
+				makeRoom(obj.size - obj.compressedSize);
+			}
+			else if (m_stats.used + obj.size - obj.compressedSize > m_stats.allocation)
+			{
+				/* the prefetch worker only fills free space, it stays compressed until it is opened */
+				return false;
+			}
+
+			const PBYTE data = static_cast<PBYTE>(VirtualAlloc(nullptr, obj.size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+			const bool restored = data != nullptr && Lz4Block::decompress(obj.compressed, obj.compressedSize, data, obj.size);
+
+			m_stats.used -= obj.compressedSize;
+			m_stats.compressedSize -= obj.compressedSize;
+			--m_stats.compressedObjects;
+
+			delete[] obj.compressed;
+			obj.compressed = nullptr;
+			obj.compressedSize = 0;
+
+			if (restored == false)
+			{
+				/* start over as an empty heap object, the chunks are read from disk again */
+				m_logger->logMessageF(IDelegate::LogLevel::Warn, "decompressObject: unable to restore %zu bytes", obj.size);
+				if (data != nullptr)
+				{
+					VirtualFree(data, 0, MEM_RELEASE);
+				}
+
+				obj.resident = 0;
+				return reserveObjectData(obj);
+			}
+
+			obj.data = data;
+			obj.resident = obj.size;
+			m_stats.used += obj.size;
+
+			shareObjectContent(obj);
+			return true;
+		}
+
+		void MemCache::releaseRetiredData(CacheObject& obj)
+		{
+			PBYTE retired = obj.retired.exchange(nullptr);
+			if (retired != nullptr)
+			{
+				VirtualFree(retired, 0, MEM_RELEASE);
+				m_stats.used -= obj.size;
+			}
+		}
+
+		bool MemCache::mapObjectData(HANDLE hRef, CacheObject& obj)
+		{
+			/* empty files can't be mapped */
+			if (hRef == nullptr || obj.size == 0)
+			{
+				return false;
+			}
+
+			HANDLE mapping = CreateFileMappingA(hRef, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr)
+			{
+				m_logger->logMessageF(IDelegate::LogLevel::Warn, "mapObjectData: unable to map %p (%lu)", hRef, GetLastError());
+				return false;
+			}
+
+			/* the view keeps the mapping alive on its own; don't go through our own CloseHandle hook */
+			obj.data = static_cast<PBYTE>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, obj.size));
+			MemCache::s_procCloseHandle(mapping);
+
+			obj.mapped = obj.data != nullptr;
+			return obj.mapped;
+		}
+
+		void MemCache::releaseObjectData(CacheObject& obj)
+		{
+			if (obj.mapped)
+			{
+				UnmapViewOfFile(obj.data);
+			}
+			else if (obj.data != nullptr && obj.content == nullptr)
+			{
+				/* shared contents are released through releaseSharedContent */
+				VirtualFree(obj.data, 0, MEM_RELEASE);
+			}
+			releaseRetiredData(obj);
+			obj.data = nullptr;
+			obj.content = nullptr;
+
+			if (obj.compressed != nullptr)
+			{
+				m_stats.compressedSize -= obj.compressedSize;
+				--m_stats.compressedObjects;
+
+				delete[] obj.compressed;
+				obj.compressed = nullptr;
+				obj.compressedSize = 0;
+			}
+			obj.mapped = false;
+			obj.residentChunks.clear();
+		}
+
+		bool MemCache::performCachedRead(HANDLE hRef, CachePointer& pointer, uint64_t fileOffset, LPVOID lpBuffer, DWORD bytesToRead, DWORD& bytesRead, bool& fromDisk)
+		{
+			if (lpBuffer == nullptr)
+			{
+				return false;
+			}
+
+			const int64_t start = LatencyHistogram::now();
+
+			/* the reference held by hRef keeps the object alive until it is closed */
+			CacheObject* cacheObj = pointer.object;
+			cacheObj->lastUse = time(nullptr);
+
+			fromDisk = false;
+			if (fileOffset >= cacheObj->size)
 			{
 				/* already at end of file */
 				bytesToRead = 0;
@@ -396,23 +1628,522 @@ namespace XiPivot
 			else if (fileOffset + bytesToRead > cacheObj->size)
 			{
 				/* read to end of file */
-				bytesToRead = cacheObj->size - fileOffset;
+				bytesToRead = static_cast<DWORD>(cacheObj->size - fileOffset);
 			}
 
 			if (bytesToRead > 0)
 			{
-				memcpy(lpBuffer, &cacheObj->data[fileOffset], bytesToRead);
-				fileOffset += bytesToRead;
+				if (cacheObj->mapped == false)
+				{
+					std::lock_guard<std::mutex> lock(cacheObj->populateLock);
+
+					/* objects that stayed compressed (or could not be restored) have no data to read from */
+					const size_t resident = cacheObj->resident;
+					if (cacheObj->compressed != nullptr || cacheObj->data.load() == nullptr ||
+						populateObjectData(hRef, *cacheObj, static_cast<size_t>(fileOffset), bytesToRead) == false)
+					{
+						/* leave this one to the real ReadFile, it has to start where our offset is */
+						LARGE_INTEGER realOffset;
+						realOffset.QuadPart = static_cast<LONGLONG>(fileOffset);
+						MemCache::s_procSetFilePointerEx(hRef, realOffset, nullptr, FILE_BEGIN);
+						return false;
+					}
+					fromDisk = cacheObj->resident != resident;
+				}
+
+				memcpy(lpBuffer, cacheObj->data.load() + fileOffset, bytesToRead);
+			}
+
+			/* ReadFile moves the file pointer of synchronous handles for overlapped reads as well */
+			pointer.offset = fileOffset + bytesToRead;
+
+			bytesRead = bytesToRead;
+
+			recordRead(start, fromDisk, bytesToRead);
+			return true;
+		}
+
+		void MemCache::recordRead(int64_t start, bool fromDisk, uint64_t bytes)
+		{
+			m_telemetry.recordLatency(fromDisk ? CacheTelemetry::Operation::MissRead : CacheTelemetry::Operation::CachedRead, start);
+			m_telemetry.recordBytes(fromDisk == false, bytes);
+		}
+
+		bool MemCache::seekCachePointer(CachePointer& pointer, int64_t distance, DWORD moveMethod, uint64_t& newOffset)
+		{
+			int64_t base = 0;
+			switch (moveMethod)
+			{
+				case FILE_BEGIN:
+					base = 0;
+					break;
+
+				case FILE_CURRENT:
+					base = static_cast<int64_t>(pointer.offset.load());
+					break;
+
+				case FILE_END:
+					base = static_cast<int64_t>(pointer.object->size);
+					break;
+
+				default:
+					SetLastError(ERROR_INVALID_PARAMETER);
+					return false;
+			}
+
+			if (base + distance < 0)
+			{
+				SetLastError(ERROR_NEGATIVE_SEEK);
+				return false;
+			}
+
+			/* seeking past the end is fine, reads there simply return 0 bytes */
+			newOffset = static_cast<uint64_t>(base + distance);
+			pointer.offset = newOffset;
+
+			SetLastError(NO_ERROR);
+			return true;
+		}
+
+		/* prefetching */
+
+		void MemCache::prefetchWorker(void)
+		{
+			XIPIVOT_LOG(m_logger, m_logDebug, "prefetchWorker: started");
+
+			PathResolver resolver;
+			while (true)
+			{
+				PrefetchRequest request;
+				{
+					std::unique_lock<std::mutex> lock(m_prefetchLock);
+					m_prefetchSignal.wait(lock, [this]() { return m_prefetchStop || m_prefetchQueue.empty() == false; });
+					if (m_prefetchStop)
+					{
+						break;
+					}
+					request = std::move(m_prefetchQueue.front());
+					m_prefetchQueue.pop_front();
+
+					/* resolved as late as possible, the overlays may have changed since it was queued */
+					if (request.path.empty() && m_pathResolver)
+					{
+						resolver = m_pathResolver;
+					}
+				}
+				if (request.urgent)
+				{
+					--m_urgentPending;
+				}
+
+				if (resolver)
+				{
+					request.path = resolver(request.pathKey);
+					resolver = nullptr;
+				}
+				if (request.path.empty())
+				{
+					continue;
+				}
+
+				if (prefetchObject(request))
+				{
+					XIPIVOT_LOG(m_logger, m_logDebug, "prefetchWorker: prefetched %d", request.pathKey);
+				}
+			}
+			XIPIVOT_LOG(m_logger, m_logDebug, "prefetchWorker: stopped");
+		}
+
+		bool MemCache::prefetchObject(const PrefetchRequest& request)
+		{
+			if (m_hooksSet == false || m_stats.used >= m_stats.allocation)
+			{
+				return false;
+			}
+
+			/* CreateFileW doesn't pass through the Redirector hooks, this handle is never tracked */
+			const std::wstring path = std::filesystem::path(request.path).wstring();
+			HANDLE hRef = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (hRef == INVALID_HANDLE_VALUE)
+			{
+				XIPIVOT_LOG(m_logger, m_logDebug, "prefetchObject: unable to open '%s' (%lu)", request.path.c_str(), GetLastError());
+				return false;
+			}
+
+			/* the reference keeps purgeCacheObjects away while the chunks are read */
+			bool cached = false;
+			CacheObject* obj = acquireCachedObject(hRef, request.pathKey, normalise_source(request.path.c_str()), false, cached);
+
+			bool success = obj != nullptr;
+			if (obj != nullptr)
+			{
+				PrefetchSlot slots[2];
+				for (auto& slot : slots)
+				{
+					memset(&slot.overlapped, 0, sizeof(slot.overlapped));
+					slot.overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+					slot.buffer.resize(sChunkSize);
+					slot.active = false;
+				}
+
+				/* keep one read in flight while the previous chunk is copied into the object */
+				const size_t chunkCount = (obj->size + sChunkSize - 1) / sChunkSize;
+				size_t chunk = nextPrefetchChunk(*obj, 0);
+
+				for (size_t current = 0; ; current ^= 1)
+				{
+					PrefetchSlot& next = slots[current];
+					PrefetchSlot& pending = slots[current ^ 1];
+
+					/* background requests give way as soon as a trace is replayed */
+					if (success && chunk < chunkCount && m_prefetchStop == false && (request.urgent || m_urgentPending == 0))
+					{
+						if (request.urgent == false)
+						{
+							waitForIdleReads();
+						}
+
+						next.chunk = chunk;
+						success = beginChunkRead(hRef, *obj, next);
+						chunk = nextPrefetchChunk(*obj, chunk + 1);
+					}
+
+					if (pending.active)
+					{
+						success = finishChunkRead(hRef, *obj, pending) && success;
+					}
+
+					if (next.active == false && pending.active == false)
+					{
+						break;
+					}
+				}
+
+				for (auto& slot : slots)
+				{
+					MemCache::s_procCloseHandle(slot.overlapped.hEvent);
+				}
+
+				obj->lastUse = time(nullptr);
+				--obj->ref;
+			}
+
+			MemCache::s_procCloseHandle(hRef);
+			return success;
+		}
+
+		size_t MemCache::nextPrefetchChunk(CacheObject& obj, size_t chunk)
+		{
+			if (obj.mapped)
+			{
+				/* mapped objects have no residency bits, every chunk is read once to warm the page cache */
+				return chunk;
+			}
+
+			std::lock_guard<std::mutex> lock(obj.populateLock);
+
+			const size_t chunkCount = (obj.size + sChunkSize - 1) / sChunkSize;
+			while (chunk < chunkCount && chunk_resident(obj.residentChunks, chunk))
+			{
+				++chunk;
+			}
+			return chunk;
+		}
+
+		bool MemCache::beginChunkRead(HANDLE hRef, const CacheObject& obj, PrefetchSlot& slot)
+		{
+			const size_t chunkOffset = slot.chunk * sChunkSize;
+			const size_t chunkSize = std::min(sChunkSize, obj.size - chunkOffset);
+
+			if (obj.mapped == false && m_stats.used + chunkSize > m_stats.allocation)
+			{
+				return false;
+			}
+
+			slot.overlapped.Offset = static_cast<DWORD>(chunkOffset);
+			slot.overlapped.OffsetHigh = 0;
+			ResetEvent(slot.overlapped.hEvent);
+
+			/* the real ReadFile - our own hook would count this as a game read */
+			if (MemCache::s_procReadFile(hRef, slot.buffer.data(), static_cast<DWORD>(chunkSize), nullptr, &slot.overlapped) == FALSE &&
+				GetLastError() != ERROR_IO_PENDING)
+			{
+				m_logger->logMessageF(IDelegate::LogLevel::Warn, "beginChunkRead: read failed at %zu (%lu)", chunkOffset, GetLastError());
+				return false;
+			}
+			slot.active = true;
+			return true;
+		}
+
+		bool MemCache::finishChunkRead(HANDLE hRef, CacheObject& obj, PrefetchSlot& slot)
+		{
+			const size_t chunkSize = std::min(sChunkSize, obj.size - slot.chunk * sChunkSize);
+
+			DWORD bytesRead = 0;
+			const BOOL result = GetOverlappedResult(hRef, &slot.overlapped, &bytesRead, TRUE);
+			slot.active = false;
+
+			if (result == FALSE || bytesRead != chunkSize)
+			{
+				m_logger->logMessageF(IDelegate::LogLevel::Warn, "finishChunkRead: aborting read with %lu / %zu bytes", bytesRead, chunkSize);
+				return false;
+			}
+
+			if (obj.mapped)
+			{
+				/* the read alone pulled the pages into the page cache backing the view */
+				return true;
+			}
+
+			std::lock_guard<std::mutex> lock(obj.populateLock);
+			if (chunk_resident(obj.residentChunks, slot.chunk))
+			{
+				/* the game got there first */
+				return true;
+			}
+
+			PBYTE chunkData = commitObjectChunk(obj, slot.chunk, false);
+			if (chunkData == nullptr)
+			{
+				return false;
+			}
+			memcpy(chunkData, slot.buffer.data(), chunkSize);
+			markChunkResident(obj, slot.chunk);
+			return true;
+		}
+
+		void MemCache::waitForIdleReads(void) const
+		{
+			while (m_prefetchStop == false && m_urgentPending == 0 && GetTickCount() - m_lastRead.load() < sPrefetchIdleTime)
+			{
+				Sleep(sPrefetchIdleTime);
+			}
+		}
+
+		void MemCache::stopPrefetch(void)
+		{
+			if (m_prefetchThread.joinable() == false)
+			{
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_prefetchLock);
+				m_prefetchStop = true;
+				m_prefetchQueue.clear();
+				m_urgentPending = 0;
+			}
+			m_prefetchSignal.notify_one();
+			m_prefetchThread.join();
+
+			std::lock_guard<std::mutex> lock(m_historyLock);
+			finishAccessTrace();
+
+			saveAccessHistory(m_statePath + sHistoryFile);
+			saveAccessTraces(m_statePath + sTraceFile);
+		}
+
+		void MemCache::recordAccess(int32_t pathKey)
+		{
+			std::lock_guard<std::mutex> lock(m_historyLock);
+
+			++m_accessHistory[pathKey].count;
+
+			const DWORD now = GetTickCount();
+			if (m_traceTrigger == -1 || now - m_lastOpen > sTraceBurstGap)
+			{
+				/* a new burst of opens, most likely a zone change */
+				finishAccessTrace();
+
+				m_traceTrigger = pathKey;
+				m_traceStart = now;
+				replayAccessTrace(pathKey);
+			}
+			else if (pathKey != m_traceTrigger && m_currentTrace.size() < sMaxTraceLength &&
+					 std::none_of(m_currentTrace.begin(), m_currentTrace.end(), [pathKey](const TraceEntry& e) { return e.pathKey == pathKey; }))
+			{
+				m_currentTrace.push_back({ pathKey, static_cast<uint32_t>(now - m_traceStart) });
+			}
+			m_lastOpen = now;
+		}
+
+		void MemCache::finishAccessTrace(void)
+		{
+			/* the latest trace of a trigger replaces older ones */
+			if (m_traceTrigger != -1 && m_currentTrace.empty() == false &&
+				(m_accessTraces.size() < sMaxTraces || m_accessTraces.find(m_traceTrigger) != m_accessTraces.end()))
+			{
+				XIPIVOT_LOG(m_logger, m_logDebug, "finishAccessTrace: %d => %zu keys", m_traceTrigger, m_currentTrace.size());
+				m_accessTraces[m_traceTrigger] = std::move(m_currentTrace);
+			}
+			m_currentTrace.clear();
+			m_traceTrigger = -1;
+		}
+
+		void MemCache::replayAccessTrace(int32_t triggerKey)
+		{
+			const auto trace = m_accessTraces.find(triggerKey);
+			if (trace == m_accessTraces.end() || getPrefetch() == false)
+			{
+				return;
+			}
+
+			std::vector<PrefetchRequest> requests;
+			for (const auto& entry : trace->second)
+			{
+				{
+					auto& shard = objectShard(entry.pathKey);
+					std::lock_guard<std::mutex> shardLock(shard.lock);
+
+					const auto cached = shard.objects.find(entry.pathKey);
+					if (cached != shard.objects.end() && cached->second->resident == cached->second->size)
+					{
+						continue;
+					}
+				}
+
+				/* resolved by the worker against the current redirects, just like the history */
+				requests.push_back({ entry.pathKey, {}, true });
+			}
+			XIPIVOT_LOG(m_logger, m_logDebug, "replayAccessTrace: %d => %zu keys", triggerKey, requests.size());
+
+			{
+				std::lock_guard<std::mutex> lock(m_prefetchLock);
+
+				/* in the order they were opened, ahead of everything else */
+				m_prefetchQueue.insert(m_prefetchQueue.begin(), requests.begin(), requests.end());
+				m_urgentPending += static_cast<int>(requests.size());
+			}
+			m_prefetchSignal.notify_one();
+		}
+
+		bool MemCache::loadAccessHistory(const std::string& path)
+		{
+			/* one entry per line: <key> <count>
+			 * older versions appended the path the key was opened from, it is skipped.
+			 */
+			std::ifstream in(path);
+			if (in.is_open() == false)
+			{
+				return false;
+			}
+
+			int32_t pathKey = 0;
+			uint32_t count = 0;
+			std::string stalePath;
+
+			while (in >> pathKey >> count && std::getline(in, stalePath))
+			{
+				/* counts from older sessions are halved so keys that are no longer used fade out */
+				if (count / 2 > 0)
+				{
+					m_accessHistory[pathKey].count += count / 2;
+				}
+			}
+			XIPIVOT_LOG(m_logger, m_logDebug, "loadAccessHistory: %zu keys from '%s'", m_accessHistory.size(), path.c_str());
+			return true;
+		}
+
+		std::vector<std::pair<int32_t, const MemCache::AccessRecord*>> MemCache::rankedAccessHistory(void) const
+		{
+			/* most frequently opened keys first, limited to sMaxHistoryEntries */
+			std::vector<std::pair<int32_t, const AccessRecord*>> history;
+			for (const auto& record : m_accessHistory)
+			{
+				history.emplace_back(record.first, &record.second);
+			}
+			std::sort(history.begin(), history.end(), [](const auto& a, const auto& b) { return a.second->count > b.second->count; });
+			history.resize(std::min(history.size(), sMaxHistoryEntries));
+			return history;
+		}
+
+		bool MemCache::saveAccessHistory(const std::string& path) const
+		{
+			if (path.empty())
+			{
+				return false;
+			}
+
+			const auto history = rankedAccessHistory();
+
+			std::ofstream out(path, std::ios::trunc);
+			if (out.is_open() == false)
+			{
+				m_logger->logMessageF(IDelegate::LogLevel::Warn, "saveAccessHistory: unable to write '%s'", path.c_str());
+				return false;
+			}
+
+			for (const auto& record : history)
+			{
+				out << record.first << " " << record.second->count << "\n";
+			}
+			return true;
+		}
+
+		bool MemCache::loadAccessTraces(const std::string& path)
+		{
+			/* header: <magic> <version> <trigger count>
+			 * then per trigger: <key> <entry count> followed by <key> <offset> for each entry
+			 */
+			std::ifstream in(path, std::ios::binary);
+			if (in.is_open() == false)
+			{
+				return false;
 			}
 
-			if (bytesRead != nullptr)
+			uint32_t header[3] = { 0 };
+			if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != sTraceMagic || header[1] != sTraceVersion)
 			{
-				*bytesRead = bytesToRead;
+				m_logger->logMessageF(IDelegate::LogLevel::Warn, "loadAccessTraces: ignoring '%s', unknown format", path.c_str());
+				return false;
 			}
 
-			/* update the real file pointer in case it is used with other API methods */
-			SetFilePointer(hRef, bytesToRead, nullptr, FILE_CURRENT);
+			for (uint32_t i = 0; i < header[2] && i < sMaxTraces; ++i)
+			{
+				int32_t triggerKey = 0;
+				uint32_t count = 0;
+				if (!in.read(reinterpret_cast<char*>(&triggerKey), sizeof(triggerKey)) || !in.read(reinterpret_cast<char*>(&count), sizeof(count)) ||
+					count > sMaxTraceLength)
+				{
+					break;
+				}
+
+				std::vector<TraceEntry> trace(count);
+				if (!in.read(reinterpret_cast<char*>(trace.data()), count * sizeof(TraceEntry)))
+				{
+					break;
+				}
+				m_accessTraces[triggerKey] = std::move(trace);
+			}
+			XIPIVOT_LOG(m_logger, m_logDebug, "loadAccessTraces: %zu traces from '%s'", m_accessTraces.size(), path.c_str());
 			return true;
 		}
+
+		bool MemCache::saveAccessTraces(const std::string& path) const
+		{
+			if (m_accessTraces.empty())
+			{
+				return false;
+			}
+
+			std::ofstream out(path, std::ios::binary | std::ios::trunc);
+			if (out.is_open() == false)
+			{
+				m_logger->logMessageF(IDelegate::LogLevel::Warn, "saveAccessTraces: unable to write '%s'", path.c_str());
+				return false;
+			}
+
+			const uint32_t header[3] = { sTraceMagic, sTraceVersion, static_cast<uint32_t>(m_accessTraces.size()) };
+			out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+			for (const auto& trace : m_accessTraces)
+			{
+				const uint32_t count = static_cast<uint32_t>(trace.second.size());
+				out.write(reinterpret_cast<const char*>(&trace.first), sizeof(trace.first));
+				out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+				out.write(reinterpret_cast<const char*>(trace.second.data()), count * sizeof(TraceEntry));
+			}
+			return out.good();
+		}
 	}
 }
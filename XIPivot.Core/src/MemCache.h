@@ -29,13 +29,23 @@
 #pragma once
 
 #include "Delegate.h"
+#include "EvictionPolicy.h"
+#include "CacheTelemetry.h"
 
 #include <Windows.h>
 
 #include <unordered_map>
+#include <condition_variable>
+#include <functional>
+#include <shared_mutex>
 #include <vector>
 #include <string>
 #include <atomic>
+#include <memory>
+#include <array>
+#include <mutex>
+#include <thread>
+#include <deque>
 
 namespace XiPivot
 {
@@ -48,7 +58,45 @@ namespace XiPivot
 		 * - the files contents are sequencially read into memory in chunks
 		 * - the file is closed
 		 *
-		 * POL doesn't seem to seek inside the file so this case is not currently handled.
+		 * heap objects only reserve address space for the whole file when they are created,
+		 * the contents are read in sChunkSize chunks the first time a read touches them.
+		 *
+		 * tracked handles keep their own file offset and SetFilePointer(Ex) is hooked to move it,
+		 * so reads served from the cache never have to enter the kernel.
+		 * overlapped ReadFile and ReadFileEx calls are served at their OVERLAPPED offset
+		 * and complete synchronously (event / completion routine included).
+		 * CreateIoCompletionPort is hooked to flag tracked handles bound to a completion port,
+		 * overlapped reads on those go to the real ReadFile(Ex) so the port still sees every completion.
+		 *
+		 * once the allocation is used up the active EvictionPolicy picks unused objects
+		 * to drop whenever a new file is opened or a chunk has to be read.
+		 *
+		 * an optional prefetch worker fills cache objects in the background using overlapped reads,
+		 * starting with the keys opened most often in previous sessions followed by the overlay DATs.
+		 * only keys are remembered between sessions, the PathResolver turns them into the path
+		 * they are currently opened from right before they are read.
+		 *
+		 * every object remembers the path it was read from, an open of the same key through
+		 * a different path (the overlays changed) replaces the object instead of using it.
+		 *
+		 * opens are also recorded as traces: every key that starts a burst of opens after a quiet
+		 * period (usually a zone change) is a trigger, and the keys that followed it are prefetched
+		 * right away the next time the trigger is opened.
+		 *
+		 * tracked handles are kept in a direct-indexed slot table (handles are small multiples of 4),
+		 * so the ReadFile hook costs a bounds check and a single load for untracked handles.
+		 * the rare handles above sHandleSlots fall back to sharded maps.
+		 * objects live in sShardCount independently locked shards, a handle holds
+		 * a reference on its object so reads never have to touch the object maps at all.
+		 * once a heap object is complete its contents are hashed, objects with identical contents
+		 * (the same DAT shipped by several overlays or ROM roots) share a single buffer.
+		 *
+		 * instead of dropping a complete heap object right away makeRoom first compresses it (LZ4),
+		 * the next open decompresses it again. objects that are compressed already or don't shrink
+		 * by at least a quarter are evicted as before. the victim is only picked and pinned under
+		 * the locks, compressing happens outside so opens of other files don't have to wait.
+		 *
+		 * lock order: CacheObject::populateLock -> m_policyLock -> shard locks -> m_contentLock.
 		 */
 		class MemCache
 		{
@@ -62,28 +110,157 @@ namespace XiPivot
 				LPOVERLAPPED lpOverlapped
 				);
 
+			typedef BOOL(WINAPI* pFnReadFileEx)(
+				HANDLE                          hRef,
+				LPVOID                          lpBuffer,
+				DWORD                           nNumberOfBytesToRead,
+				LPOVERLAPPED                    lpOverlapped,
+				LPOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine
+				);
+
 			typedef BOOL(WINAPI* pFnCloseHandle)(
 				HANDLE       hRef
 				);
 
-			/* representation of a single cached file */
-			struct CacheObject
+			typedef DWORD(WINAPI* pFnSetFilePointer)(
+				HANDLE       hRef,
+				LONG         lDistanceToMove,
+				PLONG        lpDistanceToMoveHigh,
+				DWORD        dwMoveMethod
+				);
+
+			typedef BOOL(WINAPI* pFnSetFilePointerEx)(
+				HANDLE         hRef,
+				LARGE_INTEGER  liDistanceToMove,
+				PLARGE_INTEGER lpNewFilePointer,
+				DWORD          dwMoveMethod
+				);
+
+			typedef HANDLE(WINAPI* pFnCreateIoCompletionPort)(
+				HANDLE         hRef,
+				HANDLE         hExistingCompletionPort,
+				ULONG_PTR      completionKey,
+				DWORD          numberOfConcurrentThreads
+				);
+
+			/* a fully read heap buffer shared by every object with identical contents */
+			struct SharedContent
 			{
+				uint64_t hash;
 				size_t   size;
 				PBYTE    data;
+				size_t   refs;            /* guarded by m_contentLock */
+			};
 
-				time_t   lastUse;
+			/* representation of a single cached file */
+			struct CacheObject
+			{
+				size_t   size = 0;
+				std::atomic<PBYTE> data = nullptr;
+				bool     mapped = false;  /* data is a read-only view of the file instead of a heap copy */
+
+				/* set once the contents are complete, data then points into it */
+				SharedContent* content = nullptr;
+
+				/* the own buffer replaced by shared content, freed once no handle can still be reading it */
+				std::atomic<PBYTE> retired = nullptr;
+
+				/* LZ4 copy of a cold object, data is released while this is set */
+				PBYTE    compressed = nullptr;
+				size_t   compressedSize = 0;
+
+				std::atomic<size_t> resident = 0; /* number of bytes counted towards m_stats.used */
+
+				/* normalised path the contents were read from, see normalise_source */
+				std::string source;
+
+				/* one bit per chunk of data that has been read already (heap objects only) */
+				std::vector<uint64_t> residentChunks;
+
+				/* serialises reading chunks, data of resident chunks can be copied without it */
+				std::mutex populateLock;
+
+				std::atomic<time_t> lastUse = 0;
 
-				std::atomic_int ref;
+				std::atomic_int ref = 0;
 			};
 
-			/* pointer from a HANDLE to a cache object */
+			static constexpr size_t sShardCount = 16;
+
+			/* number of directly indexed handle values (HANDLE >> 2) */
+			static constexpr size_t sHandleSlots = 0x10000;
+
+			/* a tracked HANDLE, it holds a reference on its object and replaces the real file pointer */
 			struct CachePointer
+			{
+				CacheObject*          object;
+				std::atomic<uint64_t> offset;
+				int32_t               pathKey; /* only used to label HookTracer records */
+				std::atomic_bool      completionPort; /* overlapped reads have to go through the kernel */
+			};
+
+			/* tracked handles that don't fit into m_handleSlots */
+			struct PointerShard
+			{
+				std::shared_mutex                            lock;
+				std::unordered_map<ptrdiff_t, CachePointer*> pointers;
+			};
+
+			struct ObjectShard
+			{
+				std::mutex                                  lock;
+				std::unordered_map<int32_t, CacheObject*>   objects;
+			};
+
+			/* lock-free counterpart of CacheStatus */
+			struct CacheCounters
+			{
+				std::atomic<size_t>   used = 0;
+				std::atomic<size_t>   allocation = 0;
+
+				std::atomic<unsigned> cacheHits = 0;
+				std::atomic<unsigned> cacheMisses = 0;
+				std::atomic<unsigned> cacheIgnored = 0;
+
+				std::atomic<unsigned> activeObjects = 0;
+				std::atomic<unsigned> evictedObjects = 0;
+
+				std::atomic<unsigned> compressedObjects = 0;
+				std::atomic<size_t>   compressedSize = 0;
+			};
+
+			/* how often a key was opened, persisted between sessions for the prefetch worker
+			 * paths are not kept, the overlays might be different by the time the key is prefetched.
+			 */
+			struct AccessRecord
+			{
+				uint32_t    count = 0;
+			};
+
+			/* a key that followed a trigger key, persisted between sessions */
+			struct TraceEntry
 			{
 				int32_t  pathKey;
+				uint32_t offset;  /* ms after the trigger key was opened */
+			};
+
+			/* one in-flight overlapped read of the prefetch worker */
+			struct PrefetchSlot
+			{
+				OVERLAPPED        overlapped;
+				std::vector<BYTE> buffer;
+				size_t            chunk;
+				bool              active;
 			};
 
 		public:
+			/* how new cache objects keep the file contents around */
+			enum class CacheMode
+			{
+				Heap,   /* read the whole file into a private heap copy */
+				Mapped, /* map the file read-only and let the OS page cache handle residency */
+			};
+
 			/* internal statistics tracking */
 			struct CacheStatus
 			{
@@ -95,8 +272,28 @@ namespace XiPivot
 				unsigned cacheIgnored;
 
 				unsigned activeObjects;
+				unsigned evictedObjects;
+
+				/* cold objects kept compressed instead of being evicted, compressedSize is part of used */
+				unsigned compressedObjects;
+				size_t   compressedSize;
+
+				/* filled in by getCacheStats */
+				const char* policy;
+				float       policyHitRatio;
+			};
+
+			/* a file the prefetch worker should load into the cache */
+			struct PrefetchRequest
+			{
+				int32_t     pathKey;
+				std::string path;           /* empty to ask the PathResolver once the request is handled */
+				bool        urgent = false; /* replayed from a trace, don't wait for the game to be idle */
 			};
 
+			/* returns the path a key is currently opened from, or an empty string if that's unknown */
+			typedef std::function<std::string(int32_t)> PathResolver;
+
 		public:
 			virtual ~MemCache(void);
 
@@ -120,9 +317,40 @@ namespace XiPivot
 
 			/* get the current maximum allowed cache size (in byte) */
 			size_t getCacheAllocation(void) const { return m_stats.allocation; }
+
+			/* change the mode used for new cache objects, existing objects are not affected */
+			void setCacheMode(CacheMode mode);
+
+			/* get the mode used for new cache objects */
+			CacheMode getCacheMode(void) const { return m_cacheMode; }
+
+			/* replace the eviction policy, existing objects are handed to the new policy */
+			void setEvictionPolicy(std::unique_ptr<EvictionPolicy> policy);
+
+			/* get the name of the active eviction policy */
+			const char* getEvictionPolicy(void) const;
+
+			/** start or stop the background prefetch worker
+			 * @param statePath directory used to load / save the access history and traces between sessions
+			 */
+			void setPrefetch(bool enabled, const std::string& statePath);
+
+			/* get the current state of the prefetch worker */
+			bool getPrefetch(void) const { return m_prefetchThread.joinable(); }
+
+			/* replace the pending prefetch requests, keys from the access history are always queued first */
+			void queuePrefetch(const std::vector<PrefetchRequest>& requests);
+
+			/* set the resolver used for prefetch requests without a path, nullptr disables those */
+			void setPathResolver(PathResolver resolver);
 		
 			/* track and cache a file handle for a given key */
-			HANDLE trackCacheObject(HANDLE hRef, int32_t pathKey);
+			HANDLE trackCacheObject(HANDLE hRef, int32_t pathKey, const char* path);
+
+			/* drop the objects of keys that are opened from a different path now (overlays changed)
+			 * objects with open handles stay until an open through the new path replaces them.
+			 */
+			size_t invalidateCacheObjects(const std::vector<int32_t>& pathKeys);
 
 			/** trigger a purge of cache objects of a certain age 
 			 * @param maxAge maximum time since last access (in seconds)
@@ -130,7 +358,11 @@ namespace XiPivot
 			size_t purgeCacheObjects(time_t maxAge);
 
 			/* return a copy of the cache usage statistics */
-			CacheStatus getCacheStats(void) const { return m_stats; };
+			CacheStatus getCacheStats(void) const;
+
+			/* latency histograms, bytes served, evictions by reason and the most opened keys */
+			CacheTelemetry::Snapshot getTelemetry(size_t topKeys = 10) const;
+			void resetTelemetry(void);
 
 		public:
 			/* access or create the actual Redirector instance */
@@ -138,12 +370,20 @@ namespace XiPivot
 
 			/* static callbacks used by the Detours library */
 			static BOOL __stdcall dReadFile(HANDLE a0, LPVOID a1, DWORD a2, LPDWORD a3, LPOVERLAPPED a4);
+			static BOOL __stdcall dReadFileEx(HANDLE a0, LPVOID a1, DWORD a2, LPOVERLAPPED a3, LPOVERLAPPED_COMPLETION_ROUTINE a4);
 			static BOOL __stdcall dCloseHandle(HANDLE a0);
+			static DWORD __stdcall dSetFilePointer(HANDLE a0, LONG a1, PLONG a2, DWORD a3);
+			static BOOL __stdcall dSetFilePointerEx(HANDLE a0, LARGE_INTEGER a1, PLARGE_INTEGER a2, DWORD a3);
+			static HANDLE __stdcall dCreateIoCompletionPort(HANDLE a0, HANDLE a1, ULONG_PTR a2, DWORD a3);
 
 		private /* static */:
 
 			static pFnReadFile s_procReadFile;
+			static pFnReadFileEx s_procReadFileEx;
 			static pFnCloseHandle s_procCloseHandle;
+			static pFnSetFilePointer s_procSetFilePointer;
+			static pFnSetFilePointerEx s_procSetFilePointerEx;
+			static pFnCreateIoCompletionPort s_procCreateIoCompletionPort;
 
 		protected:
 			/* globally unique instance pointer */
@@ -157,23 +397,121 @@ namespace XiPivot
 		private:
 			/* actual code to handle the intercept / redirect of file names */
 			BOOL __stdcall interceptReadFile(HANDLE a0, LPVOID a1, DWORD a2, LPDWORD a3, LPOVERLAPPED a4);
+			BOOL __stdcall interceptReadFileEx(HANDLE a0, LPVOID a1, DWORD a2, LPOVERLAPPED a3, LPOVERLAPPED_COMPLETION_ROUTINE a4);
 			BOOL __stdcall interceptCloseHandle(HANDLE a0);
-
-			/** create or fetch a cached version of a file handle 
-			 * @param hRef - if not nullptr will be used to create a new object if it doesn't exist
+			DWORD __stdcall interceptSetFilePointer(HANDLE a0, LONG a1, PLONG a2, DWORD a3);
+			BOOL __stdcall interceptSetFilePointerEx(HANDLE a0, LARGE_INTEGER a1, PLARGE_INTEGER a2, DWORD a3);
+			HANDLE __stdcall interceptCreateIoCompletionPort(HANDLE a0, HANDLE a1, ULONG_PTR a2, DWORD a3);
+
+			PointerShard& pointerShard(HANDLE hRef) { return m_pointerShards[(reinterpret_cast<size_t>(hRef) >> 2) % sShardCount]; }
+
+			/* HANDLE -> CachePointer mapping, untrackHandle hands ownership of the pointer back */
+			CachePointer* lookupHandle(HANDLE hRef);
+			bool trackHandle(HANDLE hRef, CachePointer* pointer);
+			CachePointer* untrackHandle(HANDLE hRef);
+			ObjectShard& objectShard(int32_t pathKey) { return m_objectShards[static_cast<uint32_t>(pathKey) % sShardCount]; }
+
+			/** fetch or create the cache object for a key and take a reference on it
+			 * @param source - the normalised path hRef was opened from, objects read from another path are replaced
+			 * @param evict - false for the prefetch worker, it only fills free space
+			 * @param cached - set to true if the object existed already
 			 */
-			CacheObject* getCachedObject(HANDLE hRef, int32_t pathKey);
-			bool readObjectData(HANDLE hRef, CacheObject& obj);
-
-			bool performCachedRead(HANDLE hRef, LPVOID lpBuffer, DWORD bytesToRead, LPDWORD bytesRead);
+			CacheObject* acquireCachedObject(HANDLE hRef, int32_t pathKey, const std::string& source, bool evict, bool& cached);
+			CacheObject* createCachedObject(HANDLE hRef, int32_t pathKey, bool evict);
+			/* remove an unreferenced object from the cache, returns false if it is still in use */
+			bool dropCacheObject(int32_t pathKey, CacheTelemetry::EvictReason reason);
+			bool makeRoom(size_t size);
+			void releaseCacheObject(CacheObject* obj);
+			bool reserveObjectData(CacheObject& obj);
+			bool mapObjectData(HANDLE hRef, CacheObject& obj);
+			/* make sure the range is resident, reading missing chunks through hRef (moves the file pointer)
+			 * NOTE: *obj.populateLock has to be held*
+			 */
+			bool populateObjectData(HANDLE hRef, CacheObject& obj, size_t offset, size_t length);
+			bool readObjectChunk(HANDLE hRef, CacheObject& obj, size_t chunk);
+			PBYTE commitObjectChunk(CacheObject& obj, size_t chunk, bool evict);
+			void markChunkResident(CacheObject& obj, size_t chunk);
+			void releaseObjectData(CacheObject& obj);
+
+			/* content deduplication for complete heap objects, NOTE: *obj.populateLock has to be held* */
+			void shareObjectContent(CacheObject& obj);
+			/* drop a reference on shared content, returns true if the buffer itself was released */
+			bool releaseSharedContent(SharedContent* content);
+			void releaseRetiredData(CacheObject& obj);
+
+			/* compressed tier, both expect *obj.populateLock* and a reference
+			 * (for compressObject the one makeRoom pinned the victim with)
+			 */
+			bool compressObject(CacheObject& obj);
+			bool decompressObject(CacheObject& obj, bool evict);
+
+			/* background prefetching */
+			void prefetchWorker(void);
+			bool prefetchObject(const PrefetchRequest& request);
+			size_t nextPrefetchChunk(CacheObject& obj, size_t chunk);
+			bool beginChunkRead(HANDLE hRef, const CacheObject& obj, PrefetchSlot& slot);
+			bool finishChunkRead(HANDLE hRef, CacheObject& obj, PrefetchSlot& slot);
+			void waitForIdleReads(void) const;
+			void stopPrefetch(void);
+
+			/* access tracking, everything but recordAccess expects m_historyLock to be held */
+			void recordAccess(int32_t pathKey);
+			void finishAccessTrace(void);
+			void replayAccessTrace(int32_t triggerKey);
+
+			bool loadAccessHistory(const std::string& path);
+			bool saveAccessHistory(const std::string& path) const;
+			std::vector<std::pair<int32_t, const AccessRecord*>> rankedAccessHistory(void) const;
+			bool loadAccessTraces(const std::string& path);
+			bool saveAccessTraces(const std::string& path) const;
+
+			/* read from offset (the handles own offset or OVERLAPPED::Offset) and move the handles offset past the data,
+			 * fromDisk is set if missing chunks had to be read first */
+			bool performCachedRead(HANDLE hRef, CachePointer& pointer, uint64_t offset, LPVOID lpBuffer, DWORD bytesToRead, DWORD& bytesRead, bool& fromDisk);
+			/* telemetry for a read on a tracked handle */
+			void recordRead(int64_t start, bool fromDisk, uint64_t bytes);
+
+			/* move the tracked offset of a handle, returns false (with the last error set) for invalid seeks */
+			bool seekCachePointer(CachePointer& pointer, int64_t distance, DWORD moveMethod, uint64_t& newOffset);
 
 			bool                                        m_hooksSet;
 
-			CacheStatus                                 m_stats;
-			std::atomic_bool                            m_inSyscall;
-
-			std::unordered_map<ptrdiff_t, CachePointer> m_cachePointers;
-			std::unordered_map<int32_t, CacheObject*>   m_cacheObjects;
+			CacheCounters                               m_stats;
+			CacheTelemetry                              m_telemetry;
+			CacheMode                                   m_cacheMode;
+
+			mutable std::mutex                          m_policyLock;
+			std::unique_ptr<EvictionPolicy>             m_policy;
+
+			/* indexed by HANDLE >> 2, nullptr for untracked handles */
+			std::unique_ptr<std::atomic<CachePointer*>[]> m_handleSlots;
+			std::array<PointerShard, sShardCount>       m_pointerShards;
+			std::atomic_size_t                          m_overflowHandles;
+			std::array<ObjectShard, sShardCount>        m_objectShards;
+
+			/* content hash => shared buffers, taken after the shard locks */
+			std::mutex                                  m_contentLock;
+			std::unordered_multimap<uint64_t, SharedContent*> m_sharedContent;
+
+			/* guards the access history and traces */
+			mutable std::mutex                          m_historyLock;
+			std::unordered_map<int32_t, AccessRecord>   m_accessHistory;
+
+			std::unordered_map<int32_t, std::vector<TraceEntry>> m_accessTraces;
+			std::vector<TraceEntry>                     m_currentTrace;
+			int32_t                                     m_traceTrigger;
+			DWORD                                       m_traceStart;
+			DWORD                                       m_lastOpen;
+
+			std::thread                                 m_prefetchThread;
+			std::mutex                                  m_prefetchLock;
+			std::condition_variable                     m_prefetchSignal;
+			std::deque<PrefetchRequest>                 m_prefetchQueue;
+			std::atomic_bool                            m_prefetchStop;
+			std::atomic_int                             m_urgentPending;
+			std::atomic<DWORD>                          m_lastRead;
+			std::string                                 m_statePath;
+			PathResolver                                m_pathResolver;  /* guarded by m_prefetchLock */
 
 			IDelegate::LogLevel                      m_logDebug;
 			IDelegate*                               m_logger;
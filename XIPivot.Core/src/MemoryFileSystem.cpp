@@ -0,0 +1,217 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MemoryFileSystem.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		namespace
+		{
+			class MemoryMappedFile : public IFileSystem::MappedFile
+			{
+			public:
+				explicit MemoryMappedFile(std::shared_ptr<const std::vector<char>> contents)
+					: m_contents(std::move(contents)) {}
+
+				const void* data(void) const override { return m_contents->data(); }
+				size_t size(void) const override { return m_contents->size(); }
+
+			private:
+				std::shared_ptr<const std::vector<char>> m_contents;
+			};
+
+			/* FindFirstFile style matching for '*' and '?', case insensitive */
+			bool match_pattern(const char *pattern, const char *name)
+			{
+				const char *star = nullptr;
+				const char *resume = nullptr;
+
+				while (*name != '\0')
+				{
+					if (*pattern == '*')
+					{
+						star = pattern++;
+						resume = name;
+					}
+					else if (*pattern == '?' || (*pattern != '\0' && tolower(static_cast<unsigned char>(*pattern)) == tolower(static_cast<unsigned char>(*name))))
+					{
+						++pattern;
+						++name;
+					}
+					else if (star != nullptr)
+					{
+						pattern = star + 1;
+						name = ++resume;
+					}
+					else
+					{
+						return false;
+					}
+				}
+
+				while (*pattern == '*')
+				{
+					++pattern;
+				}
+				return *pattern == '\0';
+			}
+		}
+
+		void MemoryFileSystem::addFile(const std::string &path)
+		{
+			const auto spelled = normaliseSeparators(path);
+			const auto sep = spelled.rfind('/');
+
+			/* names are kept as given, only the lookups ignore case */
+			auto &parent = insertDirectory(sep != std::string::npos ? spelled.substr(0, sep) : std::string());
+			parent.entries.push_back({ sep != std::string::npos ? spelled.substr(sep + 1) : spelled, false });
+			++parent.lastWrite;
+		}
+
+		void MemoryFileSystem::addDirectory(const std::string &path)
+		{
+			insertDirectory(normaliseSeparators(path));
+		}
+
+		void MemoryFileSystem::touchDirectory(const std::string &path, uint64_t lastWrite)
+		{
+			auto it = m_directories.find(normalise(path));
+			if (it != m_directories.end())
+			{
+				it->second.lastWrite = lastWrite;
+			}
+		}
+
+		bool MemoryFileSystem::listDirectory(const std::string &directory, const std::string &pattern, std::vector<Entry> &entries) const
+		{
+			entries.clear();
+
+			auto it = m_directories.find(normalise(directory));
+			if (it != m_directories.end())
+			{
+				for (const auto &entry : it->second.entries)
+				{
+					if (match_pattern(pattern.c_str(), entry.name.c_str()))
+					{
+						entries.push_back(entry);
+					}
+				}
+			}
+			return entries.empty() == false;
+		}
+
+		uint64_t MemoryFileSystem::lastWriteTime(const std::string &directory) const
+		{
+			auto it = m_directories.find(normalise(directory));
+			return (it != m_directories.end()) ? it->second.lastWrite : 0;
+		}
+
+		std::unique_ptr<IFileSystem::MappedFile> MemoryFileSystem::mapFile(const std::string &path) const
+		{
+			std::lock_guard<std::mutex> lock(m_contentsLock);
+
+			auto it = m_contents.find(normalise(path));
+			if (it == m_contents.end() || it->second->empty())
+			{
+				return nullptr;
+			}
+			return std::make_unique<MemoryMappedFile>(it->second);
+		}
+
+		bool MemoryFileSystem::replaceFile(const std::string &path, const std::vector<char> &contents) const
+		{
+			auto newContents = std::make_shared<const std::vector<char>>(contents);
+
+			std::lock_guard<std::mutex> lock(m_contentsLock);
+			m_contents[normalise(path)] = std::move(newContents);
+			return true;
+		}
+
+		/* private stuff */
+
+		std::string MemoryFileSystem::normalise(const std::string &path)
+		{
+			auto res = normaliseSeparators(path);
+			std::transform(res.begin(), res.end(), res.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			return res;
+		}
+
+		std::string MemoryFileSystem::normaliseSeparators(const std::string &path)
+		{
+			std::string res;
+			res.reserve(path.size());
+
+			for (const char c : path)
+			{
+				if (c == '/' || c == '\\')
+				{
+					if (res.empty() == false && res.back() == '/')
+					{
+						continue;
+					}
+					res.push_back('/');
+				}
+				else
+				{
+					res.push_back(c);
+				}
+			}
+
+			while (res.size() > 1 && res.back() == '/')
+			{
+				res.pop_back();
+			}
+			return res;
+		}
+
+		MemoryFileSystem::Directory& MemoryFileSystem::insertDirectory(const std::string &spelled)
+		{
+			const auto key = normalise(spelled);
+
+			auto it = m_directories.find(key);
+			if (it != m_directories.end())
+			{
+				return it->second;
+			}
+
+			const auto sep = spelled.rfind('/');
+			if (sep != std::string::npos && sep != 0)
+			{
+				auto &parent = insertDirectory(spelled.substr(0, sep));
+				parent.entries.push_back({ spelled.substr(sep + 1), true });
+				++parent.lastWrite;
+			}
+			return m_directories.emplace(key, Directory{ 1, {} }).first->second;
+		}
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "FileSystem.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* an in-memory directory tree for scanning synthetic overlays
+		 *
+		 * paths are matched the way Windows would: case insensitive and with any
+		 * run of '/' or '\' as a single separator, so "base//ROM2/1" finds "base\rom2\1".
+		 * adding an entry bumps the last-write time of its parent like a real file system would.
+		 *
+		 * files written through replaceFile (the overlay index) are kept apart from the tree,
+		 * they neither show up in listings nor change any last-write time.
+		 * build the tree first, all IFileSystem calls are safe from any number of threads afterwards.
+		 */
+		class MemoryFileSystem : public IFileSystem
+		{
+		public:
+			/* add a file and all of its parent directories */
+			void addFile(const std::string &path);
+			/* add a (possibly empty) directory and its parents */
+			void addDirectory(const std::string &path);
+			/* change the last-write time reported for an existing directory (new ones start at 1) */
+			void touchDirectory(const std::string &path, uint64_t lastWrite);
+
+			bool listDirectory(const std::string &directory, const std::string &pattern, std::vector<Entry> &entries) const override;
+			uint64_t lastWriteTime(const std::string &directory) const override;
+			std::unique_ptr<MappedFile> mapFile(const std::string &path) const override;
+			bool replaceFile(const std::string &path, const std::vector<char> &contents) const override;
+
+		private:
+			struct Directory
+			{
+				uint64_t           lastWrite;
+				std::vector<Entry> entries;
+			};
+
+			/* lower case, single '/' separators and no trailing separator */
+			static std::string normalise(const std::string &path);
+			/* the same without changing the case */
+			static std::string normaliseSeparators(const std::string &path);
+
+			/* path as returned by normaliseSeparators */
+			Directory& insertDirectory(const std::string &spelled);
+
+			std::unordered_map<std::string, Directory> m_directories;
+
+			/* contents are shared with any MappedFile still referencing them */
+			mutable std::mutex m_contentsLock;
+			mutable std::unordered_map<std::string, std::shared_ptr<const std::vector<char>>> m_contents;
+		};
+	}
+}
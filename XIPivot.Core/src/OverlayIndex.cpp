@@ -0,0 +1,191 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "OverlayIndex.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		OverlayIndex::~OverlayIndex(void)
+		{
+			close();
+		}
+
+		bool OverlayIndex::open(const IFileSystem &fileSystem, const std::string &indexPath)
+		{
+			close();
+
+			m_file = fileSystem.mapFile(indexPath);
+			if (m_file == nullptr || m_file->size() < sizeof(Header))
+			{
+				close();
+				return false;
+			}
+
+			const auto view = static_cast<const char*>(m_file->data());
+			const size_t size = m_file->size();
+
+			const auto header = reinterpret_cast<const Header*>(view);
+			const size_t expectedSize = sizeof(Header)
+				+ static_cast<size_t>(header->dirCount) * sizeof(DirRecord)
+				+ static_cast<size_t>(header->fileCount) * sizeof(FileRecord)
+				+ header->stringsSize;
+
+			if (memcmp(header->magic, "PVIX", 4) != 0 || header->version != sVersion || expectedSize != size ||
+				header->stringsSize == 0 || view[size - 1] != '\0')
+			{
+				close();
+				return false;
+			}
+
+			m_dirs = reinterpret_cast<const DirRecord*>(view + sizeof(Header));
+			m_files = reinterpret_cast<const FileRecord*>(&m_dirs[header->dirCount]);
+			m_strings = reinterpret_cast<const char*>(&m_files[header->fileCount]);
+
+			/* make sure every offset stays inside the mapping before handing out pointers */
+			for (uint32_t i = 0; i < header->dirCount; ++i)
+			{
+				if (m_dirs[i].path >= header->stringsSize || m_dirs[i].firstFile > header->fileCount ||
+					m_dirs[i].fileCount > header->fileCount - m_dirs[i].firstFile)
+				{
+					close();
+					return false;
+				}
+			}
+			for (uint32_t i = 0; i < header->fileCount; ++i)
+			{
+				if (m_files[i].path >= header->stringsSize)
+				{
+					close();
+					return false;
+				}
+			}
+
+			m_header = header;
+			return true;
+		}
+
+		void OverlayIndex::close(void)
+		{
+			m_file.reset();
+
+			m_header = nullptr;
+			m_dirs = nullptr;
+			m_files = nullptr;
+			m_strings = nullptr;
+		}
+
+		ptrdiff_t OverlayIndex::findDirectory(const char *path, uint32_t kind) const
+		{
+			size_t lo = 0;
+			size_t hi = directoryCount();
+
+			/* lower bound, entries with the same path are next to each other */
+			while (lo < hi)
+			{
+				const size_t mid = (lo + hi) / 2;
+				if (strcmp(directoryPath(mid), path) < 0)
+				{
+					lo = mid + 1;
+				}
+				else
+				{
+					hi = mid;
+				}
+			}
+
+			for (; lo < directoryCount() && strcmp(directoryPath(lo), path) == 0; ++lo)
+			{
+				if (directoryKind(lo) == kind)
+				{
+					return static_cast<ptrdiff_t>(lo);
+				}
+			}
+			return -1;
+		}
+
+		const OverlayIndex::FileRecord* OverlayIndex::directoryFiles(size_t index, size_t &count) const
+		{
+			count = m_dirs[index].fileCount;
+			return &m_files[m_dirs[index].firstFile];
+		}
+
+		bool OverlayIndex::write(const IFileSystem &fileSystem, const std::string &indexPath, std::vector<Directory> &dirs)
+		{
+			std::sort(dirs.begin(), dirs.end(), [](const auto &a, const auto &b) { return a.path < b.path; });
+
+			std::vector<DirRecord>  dirRecords;
+			std::vector<FileRecord> fileRecords;
+			std::vector<char>       strings;
+
+			auto addString = [&strings](const std::string &str)
+			{
+				const auto offset = static_cast<uint32_t>(strings.size());
+				strings.insert(strings.end(), str.begin(), str.end());
+				strings.push_back('\0');
+				return offset;
+			};
+
+			for (const auto &dir : dirs)
+			{
+				dirRecords.push_back({ dir.lastWrite, addString(dir.path), dir.kind,
+									   static_cast<uint32_t>(fileRecords.size()), static_cast<uint32_t>(dir.files.size()) });
+
+				for (const auto &file : dir.files)
+				{
+					fileRecords.push_back({ file.first, addString(file.second) });
+				}
+			}
+			/* an index is never without strings, this keeps the validation in open() simple */
+			addString("");
+
+			Header header = { { 'P', 'V', 'I', 'X' }, sVersion,
+							  static_cast<uint32_t>(dirRecords.size()),
+							  static_cast<uint32_t>(fileRecords.size()),
+							  static_cast<uint32_t>(strings.size()), 0 };
+
+			std::vector<char> contents;
+			contents.reserve(sizeof(header) + dirRecords.size() * sizeof(DirRecord) + fileRecords.size() * sizeof(FileRecord) + strings.size());
+
+			auto append = [&contents](const void *data, size_t size)
+			{
+				contents.insert(contents.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+			};
+			append(&header, sizeof(header));
+			append(dirRecords.data(), dirRecords.size() * sizeof(DirRecord));
+			append(fileRecords.data(), fileRecords.size() * sizeof(FileRecord));
+			append(strings.data(), strings.size());
+
+			return fileSystem.replaceFile(indexPath, contents);
+		}
+	}
+}
@@ -0,0 +1,139 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "FileSystem.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* persistent, per-overlay cache of scanned directories
+		 *
+		 * every directory that was enumerated during an overlay scan is stored
+		 * together with its last-write time and the files (path key + path) it contained.
+		 * On the next scan only directories with a changed last-write time have to be
+		 * enumerated again.
+		 *
+		 * The on-disk format is a single, memory-mapped file:
+		 *
+		 *   Header
+		 *   DirRecord[dirCount]    - sorted by path
+		 *   FileRecord[fileCount]
+		 *   char[stringsSize]      - zero terminated strings referenced by offset
+		 *
+		 * all paths inside the index are relative to the overlay directory.
+		 */
+		class OverlayIndex
+		{
+		public:
+			struct FileRecord
+			{
+				int32_t  pathKey;
+				uint32_t path;
+			};
+
+			/* a directory as it is written to the index */
+			struct Directory
+			{
+				uint32_t    kind;
+				uint64_t    lastWrite;
+				std::string path;
+
+				std::vector<std::pair<int32_t, std::string>> files;
+			};
+
+		private:
+			struct Header
+			{
+				char     magic[4];
+				uint32_t version;
+				uint32_t dirCount;
+				uint32_t fileCount;
+				uint32_t stringsSize;
+				uint32_t reserved;  /* keeps the records 8-byte aligned */
+			};
+
+			struct DirRecord
+			{
+				uint64_t lastWrite;
+				uint32_t path;
+				uint32_t kind;
+				uint32_t firstFile;
+				uint32_t fileCount;
+			};
+
+		public:
+			OverlayIndex(void) = default;
+			OverlayIndex(const OverlayIndex&) = delete;
+			OverlayIndex& operator=(const OverlayIndex&) = delete;
+			~OverlayIndex(void);
+
+			/* map an existing index file, returns false if it is missing or invalid */
+			bool open(const IFileSystem &fileSystem, const std::string &indexPath);
+			void close(void);
+
+			bool isOpen(void) const { return m_header != nullptr; }
+
+			/* number and access of all stored directories in path order */
+			size_t directoryCount(void) const { return isOpen() ? m_header->dirCount : 0; }
+			uint32_t directoryKind(size_t index) const { return m_dirs[index].kind; }
+			uint64_t directoryLastWrite(size_t index) const { return m_dirs[index].lastWrite; }
+			const char* directoryPath(size_t index) const { return &m_strings[m_dirs[index].path]; }
+
+			/* index of the directory of the given kind stored for `path` or -1 if there is none
+			 * (a path can be stored more than once, "//ROM2" is both enumerated and holds the ROM tables)
+			 */
+			ptrdiff_t findDirectory(const char *path, uint32_t kind) const;
+
+			/* files of a given directory */
+			const FileRecord* directoryFiles(size_t index, size_t &count) const;
+			const char* filePath(const FileRecord &file) const { return &m_strings[file.path]; }
+
+			/* write a new index file, replacing the old one */
+			static bool write(const IFileSystem &fileSystem, const std::string &indexPath, std::vector<Directory> &dirs);
+
+		private:
+			static constexpr uint32_t sVersion = 1;
+
+			std::unique_ptr<IFileSystem::MappedFile> m_file;
+
+			const Header*     m_header = nullptr;
+			const DirRecord*  m_dirs = nullptr;
+			const FileRecord* m_files = nullptr;
+			const char*       m_strings = nullptr;
+		};
+	}
+}
@@ -0,0 +1,591 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "OverlayScanner.h"
+#include "PathIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	/* append `suffix` to the canonical overlay path using backslashes only
+	 * runs of separators (like in "//ROM") are collapsed into a single one.
+	 */
+	std::string canonical_path(const std::string& canonicalBase, const char* suffix)
+	{
+		std::string res = canonicalBase;
+		for (; *suffix != 0; ++suffix)
+		{
+			if (*suffix == '/' || *suffix == '\\')
+			{
+				if (res.empty() == false && res.back() == '\\')
+				{
+					continue;
+				}
+				res.push_back('\\');
+			}
+			else
+			{
+				res.push_back(*suffix);
+			}
+		}
+		return res;
+	}
+
+	/* the workers of a single scan, started on demand up to one per CPU core
+	 * jobs may queue further jobs while the batch is running; wait() has the calling
+	 * thread take part in the work and returns once every job queued so far is done.
+	 */
+	class ScanWorkers
+	{
+		static constexpr int sIdlePoll = 10; // ms between checks for new jobs while idle
+
+	public:
+		ScanWorkers(void)
+			: m_maxWorkers(std::max(1U, std::thread::hardware_concurrency()) - 1)
+			, m_busy(0)
+			, m_idle(0)
+			, m_stop(false)
+		{
+		}
+
+		~ScanWorkers(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				m_stop = true;
+			}
+			m_jobSignal.notify_all();
+
+			for (auto &t : m_workers)
+			{
+				t.join();
+			}
+		}
+
+		void run(std::function<void(void)> job)
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_jobs.emplace_back(std::move(job));
+
+			if (m_jobs.size() > m_idle && m_workers.size() < m_maxWorkers)
+			{
+				m_workers.emplace_back(&ScanWorkers::work, this);
+			}
+			m_jobSignal.notify_one();
+
+			/* a waiting caller helps out as well */
+			m_doneSignal.notify_all();
+		}
+
+		void wait(void)
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			while (m_jobs.empty() == false || m_busy != 0)
+			{
+				if (m_jobs.empty())
+				{
+					m_doneSignal.wait_for(lock, std::chrono::milliseconds(sIdlePoll));
+					continue;
+				}
+				runFront(lock);
+			}
+		}
+
+	private:
+		void work(void)
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			while (true)
+			{
+				++m_idle;
+				m_jobSignal.wait_for(lock, std::chrono::milliseconds(sIdlePoll), [this]() { return m_stop || m_jobs.empty() == false; });
+				--m_idle;
+
+				if (m_jobs.empty())
+				{
+					if (m_stop)
+					{
+						return;
+					}
+					continue;
+				}
+				runFront(lock);
+			}
+		}
+
+		void runFront(std::unique_lock<std::mutex> &lock)
+		{
+			auto job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			++m_busy;
+
+			lock.unlock();
+			job();
+			lock.lock();
+
+			--m_busy;
+			m_doneSignal.notify_all();
+		}
+
+		const size_t                            m_maxWorkers;
+		std::mutex                              m_lock;
+		std::condition_variable                 m_jobSignal;
+		std::condition_variable                 m_doneSignal;
+		std::deque<std::function<void(void)>>   m_jobs;
+		std::vector<std::thread>                m_workers;
+		size_t                                  m_busy;
+		size_t                                  m_idle;
+		bool                                    m_stop;
+	};
+}
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		namespace {
+			/* the overlay index is stored next to the overlay directory, not inside it:
+			 * writing it inside the overlay would change the very last-write time it records.
+			 */
+			static constexpr auto sOverlayIndexSuffix = ".pivot-index";
+		}
+
+		OverlayScanner::OverlayScanner(const IFileSystem &fileSystem, IDelegate *delegate, IDelegate::LogLevel logDebug)
+			: m_fileSystem(fileSystem)
+			, m_delegate(delegate)
+			, m_logDebug(logDebug)
+		{
+		}
+
+		std::string OverlayScanner::indexPath(const std::string &overlayPath)
+		{
+			return overlayPath + sOverlayIndexSuffix;
+		}
+
+		void OverlayScanner::scan(const std::vector<std::string> &basePaths, std::vector<RedirectTable> &redirects, std::vector<char> &valid) const
+		{
+			/* crawl a list of overlay paths and collect all the DATs
+			 * in one redirect table per overlay.
+			 *
+			 * directory enumeration is spread over a single batch of workers:
+			 * - one job per overlay to find all directories that contain data files
+			 * - one job per data directory to list the actual files, queued as soon as
+			 *   its overlay is done so the listing doesn't wait for the other overlays
+			 *
+			 * results are merged afterwards in the same order a serial scan would
+			 * have produced them, so the log output is not affected.
+			 */
+			std::vector<std::vector<ScanTask>> overlayTasks(basePaths.size());
+			std::vector<OverlayIndex>          overlayIndices(basePaths.size());
+			std::vector<char>                  indexValid(basePaths.size(), 0);
+
+			ScanWorkers workers;
+			for (size_t i = 0; i < basePaths.size(); ++i)
+			{
+				workers.run([&, i]()
+				{
+					overlayIndices[i].open(m_fileSystem, indexPath(basePaths[i]));
+					indexValid[i] = collectScanTasks(basePaths[i], overlayIndices[i], overlayTasks[i]) ? 1 : 0;
+
+					for (auto &task : overlayTasks[i])
+					{
+						if (task.kind != ScanTask::Kind::Directory)
+						{
+							workers.run([&, i, t = &task]() { runScanTask(basePaths[i], overlayIndices[i], *t); });
+						}
+					}
+				});
+			}
+			workers.wait();
+
+			redirects.resize(basePaths.size());
+			valid.assign(basePaths.size(), 0);
+			for (size_t i = 0; i < basePaths.size(); ++i)
+			{
+				XIPIVOT_LOG(m_delegate, m_logDebug, "scanOverlayPath '%s' => %zu directories (%s)", basePaths[i].c_str(), overlayTasks[i].size(),
+										indexValid[i] ? "indexed" : "rescan");
+
+				/* resolve the overlay path once, file paths are appended lexically */
+				std::error_code ec;
+				auto canonicalBase = std::filesystem::weakly_canonical(std::filesystem::path(basePaths[i]), ec);
+				if (ec)
+				{
+					canonicalBase = std::filesystem::path(basePaths[i]).lexically_normal();
+				}
+				auto canonicalBaseStr = canonicalBase.make_preferred().string();
+				while (canonicalBaseStr.empty() == false && canonicalBaseStr.back() == '\\')
+				{
+					canonicalBaseStr.pop_back();
+				}
+
+				RedirectTable::Builder overlayRedirects;
+				for (const auto &task : overlayTasks[i])
+				{
+					valid[i] |= mergeScanTask(task, basePaths[i].size(), canonicalBaseStr, overlayRedirects) ? 1 : 0;
+					indexValid[i] &= task.fromIndex ? 1 : 0;
+				}
+				redirects[i] = overlayRedirects.build();
+
+				/* the mapping has to go before the index file can be replaced */
+				overlayIndices[i].close();
+			}
+
+			for (size_t i = 0; i < basePaths.size(); ++i)
+			{
+				if (indexValid[i] == 0)
+				{
+					workers.run([&, i]() { writeOverlayIndex(basePaths[i], overlayTasks[i]); });
+				}
+			}
+			workers.wait();
+		}
+
+		bool OverlayScanner::collectScanTasks(const std::string &basePath, const OverlayIndex &index, std::vector<ScanTask> &tasks) const
+		{
+			/* try to reuse the directory layout from the overlay index first.
+			 * It remains valid as long as none of the directories that were enumerated
+			 * to discover the data directories have been changed since.
+			 */
+			if (index.directoryCount() != 0)
+			{
+				bool layoutValid = true;
+				for (size_t i = 0; i < index.directoryCount() && layoutValid; ++i)
+				{
+					if (index.directoryKind(i) > static_cast<uint32_t>(ScanTask::Kind::Directory))
+					{
+						layoutValid = false;
+					}
+					else if (index.directoryKind(i) == static_cast<uint32_t>(ScanTask::Kind::Directory))
+					{
+						layoutValid = m_fileSystem.lastWriteTime(basePath + index.directoryPath(i)) == index.directoryLastWrite(i);
+					}
+				}
+
+				if (layoutValid)
+				{
+					for (size_t i = 0; i < index.directoryCount(); ++i)
+					{
+						const auto kind = static_cast<ScanTask::Kind>(index.directoryKind(i));
+						const bool isDirectory = kind == ScanTask::Kind::Directory;
+
+						tasks.push_back({ kind, basePath + index.directoryPath(i), isDirectory ? index.directoryLastWrite(i) : 0, isDirectory });
+					}
+					return true;
+				}
+			}
+
+			/* the last-write time is taken before each enumeration so any change
+			 * made while scanning invalidates the index on the next run */
+			tasks.push_back({ ScanTask::Kind::Directory, basePath, m_fileSystem.lastWriteTime(basePath), false });
+
+			std::vector<std::string> romDirs;
+			if (collectSubPath(basePath, "ROM*", romDirs, true))
+			{
+				for (const auto &p : romDirs)
+				{
+					tasks.push_back({ ScanTask::Kind::Directory, p, m_fileSystem.lastWriteTime(p), false });
+					tasks.push_back({ ScanTask::Kind::RomTables, p, 0, false });
+
+					std::vector<std::string> subDirs;
+					if (collectSubPath(p, "*", subDirs))
+					{
+						for (const auto &sp : subDirs)
+						{
+							tasks.push_back({ ScanTask::Kind::RomData, sp, 0, false });
+						}
+					}
+				}
+			}
+
+			std::vector<std::string> soundDirs;
+			if (collectSubPath(basePath, "sound*", soundDirs))
+			{
+				for (const auto &p : soundDirs)
+				{
+					tasks.push_back({ ScanTask::Kind::Directory, p + "/win/se", m_fileSystem.lastWriteTime(p + "/win/se"), false });
+
+					std::vector<std::string> sfxDirs;
+					if (collectSubPath(p, "/win/se", "se*", sfxDirs))
+					{
+						for (const auto &sp : sfxDirs)
+						{
+							tasks.push_back({ ScanTask::Kind::SoundEffects, sp, 0, false });
+						}
+					}
+					tasks.push_back({ ScanTask::Kind::Music, p + "/win/music/data", 0, false });
+				}
+			}
+			return false;
+		}
+
+		void OverlayScanner::runScanTask(const std::string &basePath, const OverlayIndex &index, ScanTask &task) const
+		{
+			/* NOTE: this runs on a worker thread - no logging in here */
+			if (task.kind == ScanTask::Kind::Directory)
+			{
+				/* already handled by collectScanTasks */
+				return;
+			}
+
+			/* a last-write time of 0 means the directory does not exist (yet),
+			 * which is just as valid to keep in the index as an unchanged one */
+			task.lastWrite = m_fileSystem.lastWriteTime(task.path);
+			{
+				const auto dirIndex = index.findDirectory(task.path.c_str() + basePath.size(), static_cast<uint32_t>(task.kind));
+				if (dirIndex != -1 && index.directoryLastWrite(dirIndex) == task.lastWrite)
+				{
+					/* unchanged since the last scan - the file paths were stored relative to the overlay
+					 * and need the same case conversion collectDataFiles and the code below apply.
+					 */
+					std::string prefix = basePath;
+					if (task.kind == ScanTask::Kind::RomTables || task.kind == ScanTask::Kind::RomData)
+					{
+						std::transform(prefix.begin(), prefix.end(), prefix.begin(), [](unsigned char c) { return std::toupper(c); });
+					}
+					else
+					{
+						std::transform(prefix.begin(), prefix.end(), prefix.begin(), [](unsigned char c) { return std::tolower(c); });
+					}
+
+					size_t fileCount = 0;
+					const auto files = index.directoryFiles(dirIndex, fileCount);
+					for (size_t i = 0; i < fileCount; ++i)
+					{
+						task.files.emplace_back(files[i].pathKey, prefix + index.filePath(files[i]));
+					}
+					task.fromIndex = true;
+					return;
+				}
+			}
+
+			std::vector<std::string> files;
+
+			switch (task.kind)
+			{
+				case ScanTask::Kind::RomTables:
+				case ScanTask::Kind::RomData:
+					if (collectDataFiles(task.path, "*.DAT", files))
+					{
+						for (auto &dat : files)
+						{
+							int32_t romIndex = PathIndex::pathToIndex(strstr(dat.c_str(), "//ROM"));
+							task.files.emplace_back(romIndex, std::move(dat));
+						}
+					}
+					break;
+
+				case ScanTask::Kind::SoundEffects:
+					if (collectDataFiles(task.path, "*.spw", files))
+					{
+						for (auto &sfx : files)
+						{
+							std::transform(sfx.begin(), sfx.end(), sfx.begin(), [](unsigned char c) { return std::tolower(c); });
+							int32_t sfxIndex = PathIndex::pathToIndexAudio(&strstr(sfx.c_str(), "/win/se/")[-1]);
+							task.files.emplace_back(sfxIndex, std::move(sfx));
+						}
+					}
+					break;
+
+				case ScanTask::Kind::Music:
+					if (collectDataFiles(task.path, "*.bgw", files))
+					{
+						for (auto &bgw : files)
+						{
+							std::transform(bgw.begin(), bgw.end(), bgw.begin(), [](unsigned char c) { return std::tolower(c); });
+							int32_t bgwIndex = PathIndex::pathToIndexAudio(&strstr(bgw.c_str(), "/win/music/")[-1]);
+							task.files.emplace_back(bgwIndex, std::move(bgw));
+						}
+					}
+					break;
+
+				case ScanTask::Kind::Directory:
+					break;
+			}
+		}
+
+		bool OverlayScanner::writeOverlayIndex(const std::string &basePath, const std::vector<ScanTask> &tasks) const
+		{
+			if (tasks.empty() || tasks.front().lastWrite == 0)
+			{
+				/* the overlay itself does not exist, don't leave an index behind */
+				return false;
+			}
+
+			std::vector<OverlayIndex::Directory> dirs;
+			for (const auto &task : tasks)
+			{
+				OverlayIndex::Directory dir = { static_cast<uint32_t>(task.kind), task.lastWrite, task.path.substr(basePath.size()) };
+				for (const auto &file : task.files)
+				{
+					dir.files.emplace_back(file.first, file.second.substr(basePath.size()));
+				}
+				dirs.emplace_back(std::move(dir));
+			}
+			return OverlayIndex::write(m_fileSystem, indexPath(basePath), dirs);
+		}
+
+		bool OverlayScanner::mergeScanTask(const ScanTask &task, size_t basePathLength, const std::string &canonicalBase, RedirectTable::Builder &redirects) const
+		{
+			bool res = false;
+
+			for (const auto &file : task.files)
+			{
+				const int32_t index = file.first;
+				const std::string &path = file.second;
+
+				switch (task.kind)
+				{
+					case ScanTask::Kind::RomTables:
+						if (strstr(path.c_str(), "VTABLE") == nullptr && strstr(path.c_str(), "FTABLE") == nullptr)
+						{
+							m_delegate->logMessageF(IDelegate::LogLevel::Warn, "WARNING: ignoring invalid DAT (not VTABLE/FTABLE) '%s'", path.c_str());
+							continue;
+						}
+
+						if (index != -1)
+						{
+							if (redirects.add(index, path, canonical_path(canonicalBase, path.c_str() + basePathLength)))
+							{
+								XIPIVOT_LOG(m_delegate, m_logDebug, "emplace %8d : '%s'", index, path.c_str());
+							}
+							else
+							{
+								m_delegate->logMessageF(IDelegate::LogLevel::Warn, "WARNING: %8d: ignoring '%s'", index, path.c_str());
+							}
+							/* don't touch res here */
+						}
+						break;
+
+					case ScanTask::Kind::RomData:
+						/* at least one overlay file */
+						res = true;
+
+						if (index == -1)
+						{
+							m_delegate->logMessageF(IDelegate::LogLevel::Info, "Ignoring '%s' - invalid filename", path.c_str());
+							continue;
+						}
+
+						if (redirects.add(index, path, canonical_path(canonicalBase, path.c_str() + basePathLength)))
+						{
+							XIPIVOT_LOG(m_delegate, m_logDebug, "emplace %8d : '%s'", index, path.c_str());
+						}
+						else
+						{
+							m_delegate->logMessageF(IDelegate::LogLevel::Warn, "WARNING: %8d: ignoring '%s'", index, path.c_str());
+						}
+						break;
+
+					case ScanTask::Kind::SoundEffects:
+						res = true;
+						/* fall through */
+
+					case ScanTask::Kind::Music:
+						if (index == -1)
+						{
+							m_delegate->logMessageF(IDelegate::LogLevel::Info, "Ignoring '%s' - invalid filename", path.c_str());
+							continue;
+						}
+
+						if (redirects.add(index, path, canonical_path(canonicalBase, path.c_str() + basePathLength)))
+						{
+							XIPIVOT_LOG(m_delegate, m_logDebug, "emplace %8d : '%s'", index, path.c_str());
+						}
+						res = true;
+						break;
+
+					case ScanTask::Kind::Directory:
+						break;
+				}
+			}
+			return res;
+		}
+
+		bool OverlayScanner::collectSubPath(const std::string &basePath, const std::string &pattern, std::vector<std::string> &results, bool doubleDirSep) const
+		{
+			return collectSubPath(basePath, "", pattern, results, doubleDirSep);
+		}
+
+		bool OverlayScanner::collectSubPath(const std::string &basePath, const std::string &midPath, const std::string &pattern, std::vector<std::string> &results, bool doubleDirSep) const
+		{
+			std::vector<IFileSystem::Entry> entries;
+
+			results.clear();
+			if (m_fileSystem.listDirectory(basePath + midPath, pattern, entries))
+			{
+				for (const auto &entry : entries)
+				{
+					if (entry.directory)
+					{
+						if (doubleDirSep)
+						{
+							/* this is only used to keep the same //ROM notation XI uses */
+							results.emplace_back(basePath + midPath + "//" + entry.name);
+						}
+						else
+						{
+							results.emplace_back(basePath + midPath + "/" + entry.name);
+						}
+					}
+				}
+			}
+			return results.size() != 0;
+		}
+
+		bool OverlayScanner::collectDataFiles(const std::string &parentPath, const std::string &pattern, std::vector<std::string> &results) const
+		{
+			std::vector<IFileSystem::Entry> entries;
+
+			results.clear();
+			if (m_fileSystem.listDirectory(parentPath, pattern, entries))
+			{
+				for (const auto &entry : entries)
+				{
+					if (entry.directory == false)
+					{
+						std::string finalPath = parentPath + "/" + entry.name;
+						std::transform(finalPath.begin(), finalPath.end(), finalPath.begin(), [](unsigned char c) { return std::toupper(c); });
+
+						results.emplace_back(finalPath);
+					}
+				}
+			}
+			return results.size() != 0;
+		}
+	}
+}
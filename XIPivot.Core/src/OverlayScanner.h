@@ -0,0 +1,97 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Delegate.h"
+#include "FileSystem.h"
+#include "OverlayIndex.h"
+#include "RedirectTable.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* crawls overlay directories and collects their DATs into one redirect table per overlay
+		 *
+		 * all file system access goes through an IFileSystem, the scanner itself has
+		 * no platform dependencies. The directory layout and file lists of each overlay
+		 * are kept in an OverlayIndex next to the overlay so unchanged directories
+		 * don't have to be enumerated again.
+		 */
+		class OverlayScanner
+		{
+		public:
+			OverlayScanner(const IFileSystem &fileSystem, IDelegate *delegate, IDelegate::LogLevel logDebug);
+
+			/* scan a list of overlays, valid[i] is set if overlayPaths[i] contained any data files */
+			void scan(const std::vector<std::string> &overlayPaths, std::vector<RedirectTable> &redirects, std::vector<char> &valid) const;
+
+			/* where the index of an overlay is kept */
+			static std::string indexPath(const std::string &overlayPath);
+
+		private:
+			/* a single directory of an overlay that is enumerated during a scan */
+			struct ScanTask
+			{
+				/* Directory is only enumerated to find other directories and never contains data files */
+				enum class Kind { RomTables, RomData, SoundEffects, Music, Directory };
+
+				Kind        kind;
+				std::string path;
+
+				/* last-write time of the directory, used to validate the overlay index */
+				uint64_t    lastWrite;
+				bool        fromIndex;
+
+				/* path key and path of every file found, filled in by runScanTask */
+				std::vector<std::pair<int32_t, std::string>> files;
+			};
+
+			/* collectScanTasks and runScanTask are executed by worker threads */
+			bool collectScanTasks(const std::string &basePath, const OverlayIndex &index, std::vector<ScanTask> &tasks) const;
+			void runScanTask(const std::string &basePath, const OverlayIndex &index, ScanTask &task) const;
+			bool writeOverlayIndex(const std::string &basePath, const std::vector<ScanTask> &tasks) const;
+			bool mergeScanTask(const ScanTask &task, size_t basePathLength, const std::string &canonicalBase, RedirectTable::Builder &redirects) const;
+
+			/* patterns are matched against the entries of basePath + midPath */
+			bool collectSubPath(const std::string &basePath, const std::string &pattern, std::vector<std::string> &result, bool doubleDirSep = false) const;
+			bool collectSubPath(const std::string &basePath, const std::string &midPath, const std::string &pattern, std::vector<std::string> &result, bool doubleDirSep = false) const;
+
+			bool collectDataFiles(const std::string &parentPath, const std::string &pattern, std::vector<std::string> &result) const;
+
+			const IFileSystem   &m_fileSystem;
+			IDelegate           *m_delegate;
+			IDelegate::LogLevel  m_logDebug;
+		};
+	}
+}
@@ -0,0 +1,193 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PathClassifier.h"
+
+#if defined(XIPIVOT_PATH_CLASSIFIER_SSE2)
+#	include <emmintrin.h>
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#	endif
+#endif
+
+namespace
+{
+	/* compare `marker` against `path` without reading past its terminator */
+	inline bool matches(const char *path, const char *marker)
+	{
+		for (; *marker != 0; ++path, ++marker)
+		{
+			if (*path != *marker)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+#if defined(XIPIVOT_PATH_CLASSIFIER_SSE2)
+	inline unsigned lowestBit(uint32_t mask)
+	{
+#	if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<unsigned>(index);
+#	else
+		return static_cast<unsigned>(__builtin_ctz(mask));
+#	endif
+	}
+#endif
+}
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		PathClassifier::Result PathClassifier::classify(const char *path)
+		{
+			if (path == nullptr)
+			{
+				return Result();
+			}
+#if defined(XIPIVOT_PATH_CLASSIFIER_SSE2)
+			return classifySSE2(path);
+#else
+			return classifyScalar(path);
+#endif
+		}
+
+		void PathClassifier::matchSeparator(const char *path, size_t offset, Result &result, const char *&firstWin)
+		{
+			const char sep = path[offset];
+			const char *next = &path[offset + 1];
+
+			if (matches(next, "ROM"))
+			{
+				result.flags |= RomPath;
+
+				if (sep == '/' && offset > 0 && path[offset - 1] == '/' && result.romSuffix == nullptr)
+				{
+					result.romSuffix = &path[offset - 1];
+				}
+				else if (sep == '\\')
+				{
+					result.lastRomSuffix = &path[offset];
+				}
+			}
+			else if (matches(next, "win") && next[3] == sep)
+			{
+				if (sep == '\\' && firstWin == nullptr)
+				{
+					firstWin = &path[offset];
+				}
+
+				uint32_t flag = 0;
+				if (matches(&next[4], "se") && next[6] == sep)
+				{
+					flag = SoundEffectPath;
+				}
+				else if (matches(&next[4], "music") && next[9] == sep)
+				{
+					flag = MusicPath;
+				}
+				result.flags |= flag;
+
+				/* only regular paths are used for sound and music files */
+				if (flag != 0 && sep == '\\' && firstWin != path)
+				{
+					result.audioSuffix = firstWin - 1;
+				}
+			}
+		}
+
+		PathClassifier::Result PathClassifier::classifyScalar(const char *path)
+		{
+			Result result;
+			const char *firstWin = nullptr;
+
+			for (size_t i = 0; path[i] != 0; ++i)
+			{
+				if (path[i] == '/' || path[i] == '\\')
+				{
+					matchSeparator(path, i, result, firstWin);
+				}
+			}
+			return result;
+		}
+
+#if defined(XIPIVOT_PATH_CLASSIFIER_SSE2)
+		PathClassifier::Result PathClassifier::classifySSE2(const char *path)
+		{
+			Result result;
+			const char *firstWin = nullptr;
+
+			const __m128i slash = _mm_set1_epi8('/');
+			const __m128i backslash = _mm_set1_epi8('\\');
+			const __m128i zero = _mm_setzero_si128();
+
+			/* aligned loads never cross a page boundary, so reading the
+			 * whole block that contains the terminator is always safe.
+			 * Bytes in front of `path` in the first block are masked off.
+			 */
+			const size_t misalignment = reinterpret_cast<uintptr_t>(path) & 15;
+			const char *block = path - misalignment;
+			uint32_t skipMask = ~((1U << misalignment) - 1);
+
+			while (true)
+			{
+				const __m128i data = _mm_load_si128(reinterpret_cast<const __m128i*>(block));
+
+				const uint32_t endMask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(data, zero))) & skipMask;
+				uint32_t sepMask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(data, slash), _mm_cmpeq_epi8(data, backslash)))) & skipMask;
+
+				if (endMask != 0)
+				{
+					/* drop everything past the terminator */
+					const unsigned end = lowestBit(endMask);
+					sepMask &= (1U << end) - 1;
+				}
+
+				while (sepMask != 0)
+				{
+					const unsigned bit = lowestBit(sepMask);
+					matchSeparator(path, static_cast<size_t>(block + bit - path), result, firstWin);
+					sepMask &= sepMask - 1;
+				}
+
+				if (endMask != 0)
+				{
+					break;
+				}
+				block += 16;
+				skipMask = 0xffff;
+			}
+			return result;
+		}
+#endif
+	}
+}
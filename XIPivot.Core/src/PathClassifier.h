@@ -0,0 +1,89 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* MSVC only targets SSE2 or better for x86 unless told otherwise */
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#	define XIPIVOT_PATH_CLASSIFIER_SSE2
+#endif
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* finds all path markers the Redirector is interested in with a single scan
+		 *
+		 * every path passed to the hooked file APIs goes through here, so instead of
+		 * searching for every marker separately only directory separators are located
+		 * (16 bytes at a time using SSE2 where available) and the markers are
+		 * compared at those positions.
+		 */
+		class PathClassifier
+		{
+		public:
+			enum Flags : uint32_t
+			{
+				RomPath         = 1 << 0, /* "/ROM" or "\ROM" */
+				SoundEffectPath = 1 << 1, /* "/win/se/" or "\win\se\" */
+				MusicPath       = 1 << 2, /* "/win/music/" or "\win\music\" */
+			};
+
+			struct Result
+			{
+				uint32_t    flags = 0;
+
+				/* first denormalised "//ROM" suffix as used by the game client */
+				const char *romSuffix = nullptr;
+				/* last "\ROM" suffix, the start of a regular ROM path */
+				const char *lastRomSuffix = nullptr;
+				/* the sound directory digit in front of "\win\" for "\win\se\" and "\win\music\" paths */
+				const char *audioSuffix = nullptr;
+
+				bool intercept(void) const { return flags != 0; }
+			};
+
+			static Result classify(const char *path);
+
+			/* the implementations behind classify, public so tests and benchmarks
+			 * can compare them - everything else should call classify.
+			 */
+			static Result classifyScalar(const char *path);
+#if defined(XIPIVOT_PATH_CLASSIFIER_SSE2)
+			static Result classifySSE2(const char *path);
+#endif
+
+		private:
+			/* check for markers starting at the separator path[offset] */
+			static void matchSeparator(const char *path, size_t offset, Result &result, const char *&firstWin);
+		};
+	}
+}
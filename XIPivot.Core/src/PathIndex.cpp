@@ -0,0 +1,264 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PathIndex.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		int32_t PathIndex::pathToIndex(const char *romPath)
+		{
+			/* **very** tailored approach to get a fast,
+			 * unique index for every given //ROM* path
+			 *
+			 * it's build on the current ROM layout and
+			 * **will break** if SE ever decides to add
+			 * more than 999 sub folders or 13 ROM roots.
+			 *
+			 * every numeric part of the ROM path will 
+			 * be extracted and added to the romIndex.
+			 * directory separators multiply the number
+			 * by 1000 and ensure the numbers don't collide.
+			 * 
+			 * VTABLE an FTABLE use the base 14000000 and 15000000.
+			 *
+			 * See the following paths and their resulting index:
+			 *
+			 * //ROM/0/0.DAT        =>         0
+			 * //ROM/0/1.DAT        =>         1
+			 * //ROM1/2/3.DAT       =>   1002003
+			 * //ROM1/22/33.DAT     =>   1022033
+			 * //ROM1/222/333.DAT   =>   1222333
+			 * //ROM9/999/999.DAT   =>   9999999
+			 * //ROM10/999/999.DAT  =>  10999999
+			 * //ROM10/VTABLE.DAT   =>  14000010
+			 * //ROM10/FTABLE.DAT   =>  15000010
+			 * - anything invalid - =>        -1
+			 */
+
+			/* start at the first character after "//ROM"
+			 * this is either a digit or '/' in case of the base "//ROM/"
+			 * There is no specific check for paths shorter than 6
+			 * characters, but then again, this method is not called on
+			 * random strings either.
+			 */
+			return romSuffixToIndex(&romPath[5]);
+		}
+
+		int32_t PathIndex::romSuffixToIndex(const char *romSuffix)
+		{
+			int32_t romIndex = 0;
+
+			/* '\' is accepted as well, so regular paths can use the same keys */
+			const char *p = romSuffix;
+			while (p && *p != '.' && *p != 0)
+			{
+				int subIndex = 0;
+				/* cut out the number and add it to romIndex */
+				for (; p && isdigit(*p); ++p)
+				{
+					subIndex *= 10;
+					subIndex += (*p) - '0';
+				}
+
+				if (*p == '/' || *p == '\\')
+				{
+					/* skip the '/' and shift the ROM base left */
+					romIndex *= 1000;
+					romIndex += subIndex;
+					++p;
+				}
+				else if (*p == 'V')
+				{
+					/* this is a VTABLE*.DAT */
+					romIndex += 14000000;
+					break;
+				}
+				else if (*p == 'F')
+				{
+					/* this is a FTABLE*.DAT */
+					romIndex += 15000000;
+					break;
+				}
+				else if (*p == '.')
+				{
+					/* break at the start of the file extension */
+					romIndex *= 1000;
+					romIndex += subIndex;
+					break;
+				}
+				else
+				{
+					/* not a path we can handle :( */
+					return -1;
+				}
+			}
+			return romIndex;
+		}
+
+		int32_t PathIndex::pathToIndexAudio(const char *soundPath)
+		{
+			int32_t soundIndex = 0;
+
+			/* start at the first character after "\\sound"
+			 * this is either a digit or '/' in case of the base directory "\\sound\\"
+			 * There is no specific check for paths shorter than that
+			 * characters, but then again, this method is not called on
+			 * random strings either.
+			 */
+			if (strstr(soundPath, "/win/music/data") == 0 && strstr(soundPath, "\\win\\music\\data") == 0)
+			{
+				/* sound subdir */
+				soundIndex = 20000000;
+
+				/* cut the sound directory number */
+				if (isdigit(soundPath[0]))
+				{
+					soundIndex += (soundPath[0] - '0') * 1000000;
+				}
+
+				if (!isdigit(soundPath[17]) || !isdigit(soundPath[18]) || !isdigit(soundPath[19]) ||
+					!isdigit(soundPath[20]) || !isdigit(soundPath[21]) || !isdigit(soundPath[22]))
+				{
+					return -1;
+				}
+
+				/* cut out the 6 digits of the filename, they contain the subdir anyway 
+				* 9/win/se/seAAA/seAAABBB.spw
+				*/
+				soundIndex += (soundPath[17] - '0') * 100000;
+				soundIndex += (soundPath[18] - '0') * 10000;
+				soundIndex += (soundPath[19] - '0') * 1000;
+				soundIndex += (soundPath[20] - '0') * 100;
+				soundIndex += (soundPath[21] - '0') * 10;
+				soundIndex += (soundPath[22] - '0') * 1;
+			}
+			else
+			{
+				/* music subdir */
+				soundIndex = 30000000;
+
+				/* cut the sound directory number 
+				 * 9\win\music\data\music058.bgw
+				 */
+				if (isdigit(soundPath[0]))
+				{
+					soundIndex += (soundPath[0] - '0') * 1000000;
+				}
+
+				if (!isdigit(soundPath[22]) || !isdigit(soundPath[23]) || !isdigit(soundPath[24]))
+				{
+					return -1;
+				}
+
+				/* cut out the 3 digits of the filename
+				 * 9\win\music\data\music058.bgw
+				 */
+				soundIndex += (soundPath[22] - '0') * 100;
+				soundIndex += (soundPath[23] - '0') * 10;
+				soundIndex += (soundPath[24] - '0') * 1;
+			}
+			return soundIndex;
+		}
+
+		std::string PathIndex::indexToPath(int32_t pathKey)
+		{
+			/* the base directories ("ROM", "sound") have no number, see above */
+			char path[64];
+
+			if (pathKey < 0)
+			{
+				return std::string();
+			}
+			else if (pathKey < 14000000)
+			{
+				const int32_t root = pathKey / 1000000;
+				const int32_t dir = (pathKey / 1000) % 1000;
+				const int32_t file = pathKey % 1000;
+
+				if (root == 0)
+				{
+					snprintf(path, sizeof(path), "ROM\\%d\\%d.DAT", dir, file);
+				}
+				else
+				{
+					snprintf(path, sizeof(path), "ROM%d\\%d\\%d.DAT", root, dir, file);
+				}
+			}
+			else if (pathKey < 16000000)
+			{
+				/* VTABLE / FTABLE only carry the number of their ROM root */
+				const int32_t root = pathKey % 1000000;
+				const char *table = (pathKey < 15000000) ? "VTABLE" : "FTABLE";
+
+				if (root == 0)
+				{
+					snprintf(path, sizeof(path), "ROM\\%s.DAT", table);
+				}
+				else
+				{
+					snprintf(path, sizeof(path), "ROM%d\\%s%d.DAT", root, table, root);
+				}
+			}
+			else if (pathKey >= 20000000 && pathKey < 40000000)
+			{
+				const int32_t root = (pathKey / 1000000) % 10;
+				const int32_t number = pathKey % 1000000;
+
+				char sound[8] = "sound";
+				if (root != 0)
+				{
+					snprintf(sound, sizeof(sound), "sound%d", root);
+				}
+
+				if (pathKey < 30000000)
+				{
+					snprintf(path, sizeof(path), "%s\\win\\se\\se%03d\\se%06d.spw", sound, number / 1000, number);
+				}
+				else if (number < 1000)
+				{
+					snprintf(path, sizeof(path), "%s\\win\\music\\data\\music%03d.bgw", sound, number);
+				}
+				else
+				{
+					return std::string();
+				}
+			}
+			else
+			{
+				return std::string();
+			}
+			return path;
+		}
+	}
+}
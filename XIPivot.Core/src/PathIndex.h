@@ -0,0 +1,59 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* the path keys used for every redirect, cache object and trace record
+		 *
+		 * pure string arithmetic without any platform dependencies.
+		 */
+		class PathIndex
+		{
+		public:
+			/* an actual 32bit integer perfect hash for XI ROM paths >:3 */
+			static int32_t pathToIndex(const char *romPath);
+			/* the same starting right after "//ROM" or "\ROM" */
+			static int32_t romSuffixToIndex(const char *romSuffix);
+			/* and the same for sound / music files */
+			static int32_t pathToIndexAudio(const char *soundPath);
+
+			/* the reverse: the regular path of a key relative to the game directory,
+			 * e.g. "ROM2\1\5.DAT" or "sound2\win\se\se001\se001002.spw".
+			 * returns an empty string for keys none of the above can produce.
+			 */
+			static std::string indexToPath(int32_t pathKey);
+		};
+	}
+}
@@ -0,0 +1,203 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "RedirectTable.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		bool RedirectTable::Builder::add(int32_t key, const std::string& path, const std::string& canonicalPath)
+		{
+			if (key < 0 || m_keys.insert(key).second == false)
+			{
+				return false;
+			}
+			m_entries.push_back({ key, path, canonicalPath });
+			return true;
+		}
+
+		RedirectTable RedirectTable::Builder::build(void)
+		{
+			RedirectTable table;
+
+			std::sort(m_entries.begin(), m_entries.end(),
+				[](const auto& a, const auto& b) { return a.key < b.key; });
+
+			size_t arenaSize = 0;
+			for (const auto& entry : m_entries)
+			{
+				arenaSize += entry.path.size() + entry.canonicalPath.size() + 2;
+			}
+
+			table.m_keys.reserve(m_entries.size());
+			table.m_offsets.reserve(m_entries.size());
+			table.m_canonicalOffsets.reserve(m_entries.size());
+			table.m_arena.reserve(arenaSize);
+
+			for (const auto& entry : m_entries)
+			{
+				table.m_keys.push_back(entry.key);
+				table.m_offsets.push_back(static_cast<uint32_t>(table.m_arena.size()));
+				table.m_arena.insert(table.m_arena.end(), entry.path.c_str(), entry.path.c_str() + entry.path.size() + 1);
+				table.m_canonicalOffsets.push_back(static_cast<uint32_t>(table.m_arena.size()));
+				table.m_arena.insert(table.m_arena.end(), entry.canonicalPath.c_str(), entry.canonicalPath.c_str() + entry.canonicalPath.size() + 1);
+			}
+
+			table.buildKeyFilter();
+
+			m_entries.clear();
+			m_keys.clear();
+			return table;
+		}
+
+		RedirectTable RedirectTable::merge(const std::vector<RedirectTable> &tables, std::vector<ShadowedEntry> *shadowed)
+		{
+			RedirectTable table;
+
+			size_t maxEntries = 0;
+			size_t maxArenaSize = 0;
+			for (const auto &t : tables)
+			{
+				maxEntries += t.m_keys.size();
+				maxArenaSize += t.m_arena.size();
+			}
+
+			table.m_keys.reserve(maxEntries);
+			table.m_offsets.reserve(maxEntries);
+			table.m_canonicalOffsets.reserve(maxEntries);
+			table.m_arena.reserve(maxArenaSize);
+
+			/* all tables are sorted already, so this is a k-way merge
+			 * with one cursor per table - the list of tables is short enough
+			 * that a linear search for the next key beats a heap.
+			 */
+			std::vector<size_t> cursors(tables.size(), 0);
+			while (true)
+			{
+				size_t winner = tables.size();
+				for (size_t i = 0; i < tables.size(); ++i)
+				{
+					if (cursors[i] < tables[i].size() &&
+						(winner == tables.size() || tables[i].keyAt(cursors[i]) < tables[winner].keyAt(cursors[winner])))
+					{
+						winner = i;
+					}
+				}
+
+				if (winner == tables.size())
+				{
+					break;
+				}
+
+				const int32_t key = tables[winner].keyAt(cursors[winner]);
+				const char *path = tables[winner].pathAt(cursors[winner]);
+				const char *canonicalPath = tables[winner].canonicalAt(cursors[winner]);
+
+				table.m_keys.push_back(key);
+				table.m_offsets.push_back(static_cast<uint32_t>(table.m_arena.size()));
+				table.m_arena.insert(table.m_arena.end(), path, path + strlen(path) + 1);
+				table.m_canonicalOffsets.push_back(static_cast<uint32_t>(table.m_arena.size()));
+				table.m_arena.insert(table.m_arena.end(), canonicalPath, canonicalPath + strlen(canonicalPath) + 1);
+
+				/* skip the same key in all lower priority tables */
+				for (size_t i = winner; i < tables.size(); ++i)
+				{
+					if (cursors[i] < tables[i].size() && tables[i].keyAt(cursors[i]) == key)
+					{
+						if (i != winner && shadowed != nullptr)
+						{
+							shadowed->push_back({ key, i });
+						}
+						++cursors[i];
+					}
+				}
+			}
+			table.buildKeyFilter();
+			return table;
+		}
+
+		std::vector<int32_t> RedirectTable::changedKeys(const RedirectTable &before, const RedirectTable &after)
+		{
+			std::vector<int32_t> changed;
+
+			size_t i = 0;
+			size_t j = 0;
+			while (i < before.size() || j < after.size())
+			{
+				if (j == after.size() || (i < before.size() && before.keyAt(i) < after.keyAt(j)))
+				{
+					changed.push_back(before.keyAt(i++));
+				}
+				else if (i == before.size() || after.keyAt(j) < before.keyAt(i))
+				{
+					changed.push_back(after.keyAt(j++));
+				}
+				else
+				{
+					if (strcmp(before.pathAt(i), after.pathAt(j)) != 0)
+					{
+						changed.push_back(after.keyAt(j));
+					}
+					++i;
+					++j;
+				}
+			}
+			return changed;
+		}
+
+		void RedirectTable::buildKeyFilter(void)
+		{
+			m_blockSlots.clear();
+			m_blockBits.clear();
+
+			if (m_keys.empty())
+			{
+				return;
+			}
+
+			/* keys are sorted, so the last one determines the size of the block index */
+			m_blockSlots.assign((static_cast<uint32_t>(m_keys.back()) >> sBlockShift) + 1, 0);
+			for (const auto key : m_keys)
+			{
+				const size_t block = static_cast<uint32_t>(key) >> sBlockShift;
+				if (m_blockSlots[block] == 0)
+				{
+					m_blockBits.resize(m_blockBits.size() + sBlockWords, 0);
+					m_blockSlots[block] = static_cast<uint32_t>(m_blockBits.size() / sBlockWords);
+				}
+
+				const size_t bit = static_cast<uint32_t>(key) & (sBlockKeys - 1);
+				m_blockBits[(m_blockSlots[block] - 1) * sBlockWords + bit / 64] |= uint64_t(1) << (bit % 64);
+			}
+		}
+	}
+}
@@ -0,0 +1,187 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* flat, read-only lookup table from a path key to its redirect target
+		 *
+		 * all keys are kept in a single sorted array and all paths are packed
+		 * into one contiguous, zero terminated string arena.
+		 * Every entry has two paths: the one used by the scan (and CreateFileA) and
+		 * a canonical, backslash separated one for APIs that don't accept the former.
+		 * A lookup is a binary search over the key array followed by a single
+		 * offset into the arena - no hashing and no per-entry heap objects.
+		 *
+		 * Most lookups are misses, so a two-level bitmap over the key space is
+		 * checked first: one word per 1024 keys points to a 1024 bit block for
+		 * every range that contains keys at all. A miss never touches the key array.
+		 *
+		 * tables are immutable once built, use RedirectTable::Builder to create one.
+		 */
+		class RedirectTable
+		{
+		public:
+			/* collects redirects before they are packed into a RedirectTable */
+			class Builder
+			{
+			public:
+				Builder(void) = default;
+
+				/* add a new redirect for `key`
+				 * returns false if `key` already has a redirect (first come, first served)
+				 * or if `key` is negative (pathToIndex uses -1 for invalid paths).
+				 */
+				bool add(int32_t key, const std::string& path, const std::string& canonicalPath);
+
+				size_t size(void) const { return m_entries.size(); }
+
+				/* pack all collected entries into a table, the builder is left empty */
+				RedirectTable build(void);
+
+			private:
+				struct Entry
+				{
+					int32_t     key;
+					std::string path;
+					std::string canonicalPath;
+				};
+
+				std::vector<Entry>          m_entries;
+				std::unordered_set<int32_t> m_keys;
+			};
+
+		public:
+			static constexpr size_t npos = static_cast<size_t>(-1);
+
+			/* an entry of a lower priority table that lost against an earlier one during merge */
+			struct ShadowedEntry
+			{
+				int32_t key;
+				size_t  table;
+			};
+
+			RedirectTable(void) = default;
+
+			/* merge a list of tables in priority order, if a key is present in
+			 * more than one table the redirect of the first table wins.
+			 * If `shadowed` is given every losing entry is appended to it
+			 * in ascending key order.
+			 */
+			static RedirectTable merge(const std::vector<RedirectTable> &tables, std::vector<ShadowedEntry> *shadowed = nullptr);
+
+			/* all keys that are redirected to a different path in `after` than in `before`,
+			 * including keys only present in one of them - in ascending order.
+			 */
+			static std::vector<int32_t> changedKeys(const RedirectTable &before, const RedirectTable &after);
+
+			/* returns true if there is a redirect for `key` */
+			bool contains(int32_t key) const
+			{
+				const size_t block = static_cast<uint32_t>(key) >> sBlockShift;
+				if (key < 0 || block >= m_blockSlots.size() || m_blockSlots[block] == 0)
+				{
+					return false;
+				}
+
+				const size_t bit = static_cast<uint32_t>(key) & (sBlockKeys - 1);
+				const uint64_t *blockBits = &m_blockBits[(m_blockSlots[block] - 1) * sBlockWords];
+				return (blockBits[bit / 64] & (uint64_t(1) << (bit % 64))) != 0;
+			}
+
+			/* returns the redirect target for `key` or nullptr if there is none */
+			const char* find(int32_t key) const
+			{
+				const size_t index = indexOf(key);
+				return index != npos ? pathAt(index) : nullptr;
+			}
+
+			/* returns the index of the entry for `key` or npos if there is none */
+			size_t indexOf(int32_t key) const
+			{
+				if (contains(key) == false)
+				{
+					return npos;
+				}
+
+				/* branchless lower bound, the halving step compiles to a conditional move
+				 * instead of a hard to predict branch per level.
+				 * contains() passed, so there is at least one key.
+				 */
+				const int32_t *base = m_keys.data();
+				size_t count = m_keys.size();
+
+				while (count > 1)
+				{
+					const size_t half = count / 2;
+					base = (base[half] <= key) ? base + half : base;
+					count -= half;
+				}
+
+				if (*base == key)
+				{
+					return static_cast<size_t>(base - m_keys.data());
+				}
+				return npos;
+			}
+
+			/* entries are accessible by index in ascending key order */
+			size_t size(void) const { return m_keys.size(); }
+			bool empty(void) const { return m_keys.empty(); }
+
+			int32_t keyAt(size_t index) const { return m_keys[index]; }
+			const char* pathAt(size_t index) const { return &m_arena[m_offsets[index]]; }
+			const char* canonicalAt(size_t index) const { return &m_arena[m_canonicalOffsets[index]]; }
+
+		private:
+			/* fill m_blockSlots and m_blockBits from m_keys */
+			void buildKeyFilter(void);
+
+			static constexpr size_t sBlockShift = 10;
+			static constexpr size_t sBlockKeys  = size_t(1) << sBlockShift;
+			static constexpr size_t sBlockWords = sBlockKeys / 64;
+
+			std::vector<int32_t>  m_keys;
+			std::vector<uint32_t> m_offsets;
+			std::vector<uint32_t> m_canonicalOffsets;
+			std::vector<char>     m_arena;
+
+			/* key filter - slot + 1 of the bitmap for each block of keys, 0 if the block is empty */
+			std::vector<uint32_t> m_blockSlots;
+			std::vector<uint64_t> m_blockBits;
+		};
+	}
+}
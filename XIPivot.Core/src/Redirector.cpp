@@ -28,6 +28,10 @@
 
 #include "Redirector.h"
 #include "MemCache.h"
+#include "HookTracer.h"
+#include "OverlayScanner.h"
+#include "PathIndex.h"
+#include "Win32FileSystem.h"
 #include "detours.h"
 
 #include <cctype>
@@ -35,58 +39,11 @@
 #include <algorithm>
 #include <filesystem>
 
-namespace
-{
-	char* strstr_r(char* heystack, const char* needle)
-	{
-		char* res = nullptr;
-
-		if (needle == nullptr ||heystack == nullptr)
-		{
-			return heystack;
-		}
-
-		while (true)
-		{
-			char* tmp = strstr(heystack, needle);
-			if (tmp == nullptr)
-			{
-				break;
-			}
-			res = tmp++;
-			heystack = tmp;
-		}
-		return res;
-	}
-
-	bool denormalised_ansi_path(const char* path, char* ansiPath, size_t ansiPathMax)
-	{
-		char pathBuf[MAX_PATH + 2];
-		memset(pathBuf, 0, sizeof(pathBuf));
-		strcpy_s(pathBuf, sizeof(pathBuf) - 2, path);
-
-		char* romSuffix = strstr_r(pathBuf, "\\ROM");
-		if (romSuffix != nullptr)
-		{
-			size_t suffixLen = 0;
-			for (; romSuffix[suffixLen]; ++suffixLen)
-			{
-				romSuffix[suffixLen] = romSuffix[suffixLen] == '\\' ? '/' : romSuffix[suffixLen];
-			}
-			memmove(&romSuffix[1], &romSuffix[0], suffixLen);
-			romSuffix[0] = '/';
-		}
-		memcpy(ansiPath, pathBuf, (ansiPathMax < sizeof(pathBuf) ? ansiPathMax : sizeof(pathBuf)));
-		return true;
-	}
-}
-
 namespace XiPivot
 {
 	namespace Core
 	{
 		/* static member initialisation */
-
 		Redirector* Redirector::s_instance = nullptr;
 
 		Redirector::pFnCreateFileA    Redirector::s_procCreateFileA = CreateFileA;
@@ -143,23 +100,33 @@ namespace XiPivot
 			: m_hooksSet(false)
 			, m_hookFOpenSet(false)
 			, m_hookFOpenEnabled(false)
+			, m_fileSystem(&Win32FileSystem::instance())
+			, m_gamePathKnown(false)
 		{
 			char workDir[MAX_PATH];
 
-			m_resolvedPaths.clear();
 			m_overlayPaths.clear();
 
 			GetCurrentDirectoryA(sizeof(workDir), workDir);
 
 			m_rootPath = workDir;
 			m_delegate = DummyDelegate::instance();
+
+			/* prefetch requests for remembered keys are resolved against the current redirects */
+			MemCache::instance().setPathResolver([this](int32_t pathKey) { return resolvePath(pathKey); });
 		}
 
 		Redirector::~Redirector()
 		{
+			MemCache::instance().setPathResolver(nullptr);
 			releaseHooks(); // just in case
 		}
 
+		void Redirector::setFileSystem(const IFileSystem *fileSystem)
+		{
+			m_fileSystem = (fileSystem != nullptr) ? fileSystem : &Win32FileSystem::instance();
+		}
+
 		void Redirector::setLogProvider(IDelegate* newLogProvider)
 		{
 			if (newLogProvider == nullptr)
@@ -191,7 +158,7 @@ namespace XiPivot
 				m_delegate->logMessageF(IDelegate::LogLevel::Info, "m_hooksSet = %s", m_hooksSet ? "true" : "false");
 				return m_hooksSet;
 			}
-			m_delegate->logMessage(m_logDebug, "hooks already set");
+			XIPIVOT_LOG(m_delegate, m_logDebug, "hooks already set");
 			return false;
 		}
 
@@ -215,7 +182,7 @@ namespace XiPivot
 				m_delegate->logMessageF(IDelegate::LogLevel::Info, "m_hooksSet = %s", m_hooksSet ? "true" : "false");
 				return m_hooksSet;
 			}
-			m_delegate->logMessage(m_logDebug, "hooks already removed");
+			XIPIVOT_LOG(m_delegate, m_logDebug, "hooks already removed");
 			return false;
 		}
 
@@ -237,15 +204,25 @@ namespace XiPivot
 
 		void Redirector::setRootPath(const std::string &newRoot)
 		{
+			if (newRoot == m_rootPath)
+			{
+				XIPIVOT_LOG(m_delegate, m_logDebug, "m_rootPath = '%s' (unchanged)", m_rootPath.c_str());
+				return;
+			}
+
 			m_rootPath = newRoot;
-			m_resolvedPaths.clear();
 
 			m_delegate->logMessageF(IDelegate::LogLevel::Info, "m_rootPath = '%s'", m_rootPath.c_str());
+
+			std::vector<std::string> localPaths;
 			for (const auto& overlay : m_overlayPaths)
 			{
-				std::string localPath = m_rootPath + "/" + overlay;
-				scanOverlayPath(overlay);
+				localPaths.emplace_back(m_rootPath + "/" + overlay);
 			}
+
+			std::vector<char> overlayValid;
+			scanOverlayPaths(localPaths, m_overlayRedirects, overlayValid);
+			rebuildRedirects();
 		}
 
 		bool Redirector::addOverlay(const std::string &overlayPath)
@@ -253,10 +230,14 @@ namespace XiPivot
 			m_delegate->logMessageF(IDelegate::LogLevel::Info, "addOverlay: '%s'", overlayPath.c_str());
 			if (std::find(m_overlayPaths.begin(), m_overlayPaths.end(), overlayPath) == m_overlayPaths.end())
 			{
+				RedirectTable redirects;
+
 				std::string localPath = m_rootPath + "/" + overlayPath;
-				if (scanOverlayPath(localPath))
+				if (scanOverlayPath(localPath, redirects))
 				{
 					m_overlayPaths.emplace_back(overlayPath);
+					m_overlayRedirects.emplace_back(std::move(redirects));
+					rebuildRedirects();
 					m_delegate->logMessage(IDelegate::LogLevel::Info, "=> success");
 					return true;
 				}
@@ -272,20 +253,129 @@ namespace XiPivot
 			m_delegate->logMessageF(IDelegate::LogLevel::Info, "removeOverlay: '%s'", overlayPath.c_str());
 			if (it != m_overlayPaths.end())
 			{
-				m_resolvedPaths.clear();
+				/* every overlay keeps its own redirects, so the remaining ones
+				 * only need to be merged again - no need to touch the disk.
+				 */
+				m_overlayRedirects.erase(m_overlayRedirects.begin() + (it - m_overlayPaths.begin()));
 				m_overlayPaths.erase(it);
-				for (auto& path : m_overlayPaths)
+
+				rebuildRedirects();
+				m_delegate->logMessage(IDelegate::LogLevel::Info, "=> found, and removed");
+			}
+		}
+
+		bool Redirector::moveOverlay(const std::string &overlayPath, size_t newIndex)
+		{
+			auto it = std::find(m_overlayPaths.begin(), m_overlayPaths.end(), overlayPath);
+
+			m_delegate->logMessageF(IDelegate::LogLevel::Info, "moveOverlay: '%s' => %zu", overlayPath.c_str(), newIndex);
+			if (it == m_overlayPaths.end())
+			{
+				m_delegate->logMessage(IDelegate::LogLevel::Error, "=> not found");
+				return false;
+			}
+
+			std::vector<std::string> overlayPaths = m_overlayPaths;
+			overlayPaths.erase(overlayPaths.begin() + (it - m_overlayPaths.begin()));
+			overlayPaths.insert(overlayPaths.begin() + std::min(newIndex, overlayPaths.size()), overlayPath);
+
+			return setOverlayOrder(overlayPaths);
+		}
+
+		bool Redirector::setOverlayOrder(const std::vector<std::string> &overlayPaths)
+		{
+			m_delegate->logMessageF(IDelegate::LogLevel::Info, "setOverlayOrder: %zu overlays", overlayPaths.size());
+			if (overlayPaths.size() != m_overlayPaths.size())
+			{
+				m_delegate->logMessage(IDelegate::LogLevel::Error, "=> failed, overlay count does not match");
+				return false;
+			}
+
+			/* resolve the new order first, this way nothing is changed
+			 * if the new list is not a permutation of the old one.
+			 */
+			std::vector<size_t> order;
+			std::vector<char> used(m_overlayPaths.size(), 0);
+			for (const auto &path : overlayPaths)
+			{
+				const size_t index = std::find(m_overlayPaths.begin(), m_overlayPaths.end(), path) - m_overlayPaths.begin();
+				if (index == m_overlayPaths.size() || used[index] != 0)
 				{
-					std::string localPath = m_rootPath + "/" + path;
-					scanOverlayPath(localPath);
+					m_delegate->logMessageF(IDelegate::LogLevel::Error, "=> failed, '%s' is not active or listed twice", path.c_str());
+					return false;
 				}
-				m_delegate->logMessage(IDelegate::LogLevel::Info, "=> found, and removed");
+				used[index] = 1;
+				order.emplace_back(index);
 			}
+
+			std::vector<RedirectTable> overlayRedirects;
+			for (const auto index : order)
+			{
+				overlayRedirects.emplace_back(std::move(m_overlayRedirects[index]));
+			}
+
+			m_overlayPaths = overlayPaths;
+			m_overlayRedirects = std::move(overlayRedirects);
+
+			rebuildRedirects();
+			m_delegate->logMessage(IDelegate::LogLevel::Info, "=> success");
+			return true;
+		}
+
+		void Redirector::rebuildRedirects(void)
+		{
+			std::vector<RedirectTable::ShadowedEntry> shadowed;
+
+			RedirectTable redirects = RedirectTable::merge(m_overlayRedirects, &shadowed);
+			XIPIVOT_LOG(m_delegate, m_logDebug, "rebuildRedirects: %zu overlays => %zu redirects", m_overlayRedirects.size(), redirects.size());
+
+			for (const auto &entry : shadowed)
+			{
+				const RedirectTable &table = m_overlayRedirects[entry.table];
+				m_delegate->logMessageF(IDelegate::LogLevel::Warn, "WARNING: %8d: ignoring '%s'", entry.key, table.pathAt(table.indexOf(entry.key)));
+			}
+
+			std::vector<int32_t> changedKeys;
+			{
+				const SnapshotPointer<RedirectTable>::Reader previous(m_resolvedPaths);
+				changedKeys = RedirectTable::changedKeys(*previous, redirects);
+			}
+
+			/* hook threads may be inside the old table right now, publish waits for them to leave */
+			m_resolvedPaths.publish(std::move(redirects));
+
+			/* cached contents of the previous targets must not be served anymore,
+			 * opens that raced with the publish are caught by MemCache comparing source paths.
+			 */
+			MemCache::instance().invalidateCacheObjects(changedKeys);
+			prefetchRedirects();
+		}
+
+		void Redirector::prefetchRedirects(void) const
+		{
+			if (MemCache::instance().getPrefetch() == false)
+			{
+				return;
+			}
+
+			std::vector<MemCache::PrefetchRequest> requests;
+			{
+				const SnapshotPointer<RedirectTable>::Reader redirects(m_resolvedPaths);
+
+				requests.reserve(redirects->size());
+				for (size_t i = 0; i < redirects->size(); ++i)
+				{
+					/* the same path interceptCreateFileA opens, MemCache compares them */
+					requests.push_back({ redirects->keyAt(i), redirects->pathAt(i) });
+				}
+			}
+			MemCache::instance().queuePrefetch(requests);
 		}
 
 		void Redirector::queryAll(std::vector<std::string> &queryReport) const
 		{
 			const auto rootPath = std::filesystem::path(m_rootPath).make_preferred();
+			const SnapshotPointer<RedirectTable>::Reader redirects(m_resolvedPaths);
 
 			queryReport.clear();
 			queryReport.emplace_back("#pivot-dump;");
@@ -293,20 +383,12 @@ namespace XiPivot
 			queryReport.insert(queryReport.end(), m_overlayPaths.begin(), m_overlayPaths.end());
 			queryReport.emplace_back("#redirects;");
 
-			std::list<int32_t> redirectKeys;
-			for (const auto& redirect : m_resolvedPaths)
-			{
-				redirectKeys.push_back(redirect.first);
-			}
-			/* this way the redirects will be sorted numerically
-			 * instead of alphabetic.
+			/* the redirect table is sorted by key, this way the redirects
+			 * will be listed numerically instead of alphabetic.
 			 */
-			redirectKeys.sort();
-
-			std::list<std::string> redirects;
-			for (const auto key : redirectKeys)
+			for (size_t i = 0; i < redirects->size(); ++i)
 			{
-				auto redirectPath = std::filesystem::relative(std::filesystem::path(m_resolvedPaths.at(key)), rootPath).make_preferred();
+				auto redirectPath = std::filesystem::relative(std::filesystem::path(redirects->pathAt(i)), rootPath).make_preferred();
 				auto redirectOverlay = redirectPath.begin()->string();
 
 				auto redirectName = redirectPath.string();
@@ -337,9 +419,10 @@ namespace XiPivot
 				return true;
 			}
 
-			for (const auto& redirect : m_resolvedPaths)
+			const SnapshotPointer<RedirectTable>::Reader redirects(m_resolvedPaths);
+			for (size_t i = 0; i < redirects->size(); ++i)
 			{
-				auto redirectPath = std::filesystem::path(redirect.second);
+				auto redirectPath = std::filesystem::path(redirects->pathAt(i));
 				auto redirectPathLowerStr = redirectPath.make_preferred().string();
 				std::transform(redirectPathLowerStr.begin(), redirectPathLowerStr.end(), redirectPathLowerStr.begin(),
 					           [](auto c) { return std::tolower(c); });
@@ -368,14 +451,29 @@ namespace XiPivot
 		HANDLE __stdcall
 			Redirector::interceptCreateFileA(LPCSTR a0, DWORD a1, DWORD a2, LPSECURITY_ATTRIBUTES a3, DWORD a4, DWORD a5, HANDLE a6)
 		{
-			if (shouldInterceptPath(a0))
+			PathClassifier::Result pathClass;
+			if (shouldInterceptPath(a0, pathClass))
 			{
-				//m_delegate->logMessageF(m_logDebug, "lpFileName = '%s'", static_cast<const char*>(a0));
+				//XIPIVOT_HOOK_LOG(m_delegate, m_logDebug, "lpFileName = '%s'", static_cast<const char*>(a0));
+
+				/* the redirect target lives inside the table, keep it alive until the file is open */
+				const SnapshotPointer<RedirectTable>::Reader redirects(m_resolvedPaths);
+
+				const int64_t traceStart = HookTracer::begin();
 
 				int32_t pathKey = -1;
-				bool _unusedPathRedirected = false;
-				const char* path = findRedirect(a0, pathKey, _unusedPathRedirected);
-				return MemCache::instance().trackCacheObject(Redirector::s_procCreateFileA((LPCSTR)path, a1, a2, a3, a4, a5, a6), pathKey);
+				bool pathRedirected = false;
+				const char* path = findRedirect(*redirects, a0, pathClass, pathKey, pathRedirected);
+				if (pathRedirected == false && pathClass.romSuffix != nullptr && m_gamePathKnown == false)
+				{
+					recordGamePath(a0, pathClass.romSuffix);
+				}
+				HANDLE res = MemCache::instance().trackCacheObject(Redirector::s_procCreateFileA((LPCSTR)path, a1, a2, a3, a4, a5, a6), pathKey, path);
+
+				HookTracer::end(traceStart, TraceEvent::CreateFile,
+					(pathRedirected ? TraceRedirected : 0) | (res == INVALID_HANDLE_VALUE ? TraceFailed : 0),
+					pathKey, reinterpret_cast<uintptr_t>(res));
+				return res;
 			}
 			return Redirector::s_procCreateFileA(a0, a1, a2, a3, a4, a5, a6);
 		}
@@ -383,14 +481,24 @@ namespace XiPivot
 		HANDLE __stdcall
 			Redirector::interceptFindFirstFileA(LPCSTR a0, LPWIN32_FIND_DATAA a1)
 		{
-			if (shouldInterceptPath(a0))
+			PathClassifier::Result pathClass;
+			if (shouldInterceptPath(a0, pathClass))
 			{
-				m_delegate->logMessageF(m_logDebug, "lpFileName = '%s'", static_cast<const char*>(a0));
+				XIPIVOT_HOOK_LOG(m_delegate, m_logDebug, "lpFileName = '%s'", static_cast<const char*>(a0));
+
+				const SnapshotPointer<RedirectTable>::Reader redirects(m_resolvedPaths);
+
+				const int64_t traceStart = HookTracer::begin();
 
-				int32_t _unusedPathKey = -1;
-				bool _unusedPathRedirected = false;
-				const char* path = findRedirect(a0, _unusedPathKey, _unusedPathRedirected);
-				return Redirector::s_procFindFirstFileA((LPCSTR)path, a1);
+				int32_t pathKey = -1;
+				bool pathRedirected = false;
+				const char* path = findRedirect(*redirects, a0, pathClass, pathKey, pathRedirected);
+				HANDLE res = Redirector::s_procFindFirstFileA((LPCSTR)path, a1);
+
+				HookTracer::end(traceStart, TraceEvent::FindFirstFile,
+					(pathRedirected ? TraceRedirected : 0) | (res == INVALID_HANDLE_VALUE ? TraceFailed : 0),
+					pathKey, reinterpret_cast<uintptr_t>(res));
+				return res;
 			}
 			return Redirector::s_procFindFirstFileA(a0, a1);
 		}
@@ -398,22 +506,29 @@ namespace XiPivot
 		errno_t
 			Redirector::interceptFOpenS(FILE** a0, const char* a1, const char* a2)
 		{
-			if (shouldInterceptFOpenS(a1))
+			PathClassifier::Result pathClass;
+			if (shouldInterceptFOpenS(a1, pathClass))
 			{
-				m_delegate->logMessageF(m_logDebug, "lpFileName = [fopen_s] '%s'", a1);
-				const char* path = findDenormalisedRedirect(a1);
-				if (path != nullptr)
-				{
-					auto normalised = std::filesystem::weakly_canonical(std::filesystem::path(path)).make_preferred().string();
-					return Redirector::s_procFOpenS(a0, normalised.c_str(), a2);
-				}
+				XIPIVOT_HOOK_LOG(m_delegate, m_logDebug, "lpFileName = [fopen_s] '%s'", a1);
+
+				const int64_t traceStart = HookTracer::begin();
+
+				const SnapshotPointer<RedirectTable>::Reader redirects(m_resolvedPaths);
+				const char* path = findCanonicalRedirect(*redirects, pathClass);
+				const errno_t res = Redirector::s_procFOpenS(a0, path != nullptr ? path : a1, a2);
+
+				/* fopen_s resolves through the canonical table and has no pathKey to report */
+				HookTracer::end(traceStart, TraceEvent::FOpen,
+					(path != nullptr ? TraceRedirected : 0) | (res != 0 ? TraceFailed : 0),
+					-1, static_cast<uint64_t>(res));
+				return res;
 			}
 
 			return Redirector::s_procFOpenS(a0, a1, a2);
 		}
 
 		/* private stuff */
-		const char *Redirector::findRedirect(const char *realPath, int32_t &outPathKey, bool &pathRedirected) const
+		const char *Redirector::findRedirect(const RedirectTable &redirects, const char *realPath, const PathClassifier::Result &pathClass, int32_t &outPathKey, bool &pathRedirected) const
 		{
 			/*
 			 * findRedirect relies on a very specific implementation detail in the game client.
@@ -437,449 +552,133 @@ namespace XiPivot
 			 * However.. this has been around for 20 years now and I have my doubts it will be changed
 			 * unless windows stops supporting denormalised paths.
 			 */
-			const char *romPath = strstr(realPath, "//ROM");
-			const char *sfxPath;
+			const char *romPath = pathClass.romSuffix;
 
 			// FIXME: denormalised paths don't apply to music redirects with has the potential
 			// FIXME: to break music overlays in combination with the Ashita_v4 interface if there's an update to those. 
-			if (strstr(realPath, "\\win\\se\\") != nullptr || strstr(realPath, "\\win\\music\\") != nullptr)
-			{
-				sfxPath = &(strstr(realPath, "\\win\\")[-1]);
-			}
-			else
-			{
-				sfxPath = nullptr;
-			}
+			const char *sfxPath = pathClass.audioSuffix;
 
-			m_delegate->logMessageF(m_logDebug, "romPath = %d, sfxPath = %d", romPath != nullptr, sfxPath != nullptr);
+			XIPIVOT_HOOK_LOG(m_delegate, m_logDebug, "romPath = %d, sfxPath = %d", romPath != nullptr, sfxPath != nullptr);
 
 			if (romPath != nullptr)
 			{
-				int32_t romIndex = pathToIndex(romPath);
-				const auto res = m_resolvedPaths.find(romIndex);
+				int32_t romIndex = PathIndex::pathToIndex(romPath);
+				const char* res = redirects.find(romIndex);
 			
 				outPathKey = romIndex;
-				if(res != m_resolvedPaths.end())
+				if(res != nullptr)
 				{
 					pathRedirected = true;
-					m_delegate->logMessageF(m_logDebug, "using overlay '%s'", (*res).second.c_str());
-					return (*res).second.c_str();
+					XIPIVOT_HOOK_LOG(m_delegate, m_logDebug, "using overlay '%s'", res);
+					return res;
 				}
 			}
 			if (sfxPath != nullptr)
 			{
-				int32_t sfxIndex = pathToIndexAudio(sfxPath);
-				const auto res = m_resolvedPaths.find(sfxIndex);
+				int32_t sfxIndex = PathIndex::pathToIndexAudio(sfxPath);
+				const char* res = redirects.find(sfxIndex);
 			
 				outPathKey = sfxIndex;
-				if(res != m_resolvedPaths.end())
+				if(res != nullptr)
 				{
 					pathRedirected = true;
-					m_delegate->logMessageF(m_logDebug, "using overlay '%s'", (*res).second.c_str());
-					return (*res).second.c_str();
+					XIPIVOT_HOOK_LOG(m_delegate, m_logDebug, "using overlay '%s'", res);
+					return res;
 				}
 			}
 			pathRedirected = false;
 			return realPath;
 		}
 
-		const char *Redirector::findDenormalisedRedirect(const char* realPath) const
+		const char *Redirector::findCanonicalRedirect(const RedirectTable &redirects, const PathClassifier::Result &pathClass) const
 		{
-			char ansiPath[MAX_PATH + 2];
-			if (denormalised_ansi_path(realPath, ansiPath, MAX_PATH))
-			{
-				int32_t _unusedPathKey = -1;
-				bool redirectFound = false;
-				const char* redirect = findRedirect(ansiPath, _unusedPathKey, redirectFound);
-				if (redirectFound)
-				{
-					return redirect;
-				}
-
-			}
-			return nullptr;
-		}
-
-		bool Redirector::scanOverlayPath(const std::string &basePath)
-		{
-			/* crawl an overlay path and collect all the DATs 
-			 * in m_resolvedPaths.
+			/* fopen_s is called with regular paths ("\ROM\1\2.DAT") and expects a regular path back,
+			 * both the key and the canonical redirect target can be used without converting anything.
 			 */
-			bool res = false;
-
-			m_delegate->logMessageF(m_logDebug, "scanOverlayPath '%s'", basePath.c_str());
+			size_t index = RedirectTable::npos;
 
-			std::vector<std::string> romDirs;
-			if (collectSubPath(basePath, "//ROM*", romDirs, true))
+			if (pathClass.lastRomSuffix != nullptr)
 			{
-				for (const auto &p : romDirs)
-				{
-					std::vector<std::string> datTables;
-					if (collectDataFiles(p, "*.DAT", datTables))
-					{
-						for (const auto& table : datTables)
-						{
-							if (strstr(table.c_str(), "VTABLE") == nullptr && strstr(table.c_str(), "FTABLE") == nullptr)
-							{
-								m_delegate->logMessageF(IDelegate::LogLevel::Warn, "WARNING: ignoring invalid DAT (not VTABLE/FTABLE) '%s'", table.c_str());
-								continue;
-							}
-
-							int32_t romIndex = pathToIndex(strstr(table.c_str(), "//ROM"));
-							if (romIndex != -1)
-							{
-								if (m_resolvedPaths.find(romIndex) == m_resolvedPaths.end())
-								{
-									m_delegate->logMessageF(m_logDebug, "emplace %8d : '%s'", romIndex, table.c_str());
-									m_resolvedPaths.emplace(romIndex, table);
-								}
-								else
-								{
-									m_delegate->logMessageF(IDelegate::LogLevel::Warn, "WARNING: %8d: ignoring '%s'", romIndex, table.c_str());
-								}
-								/* don't touch res here */
-							}
-						}
-					}
-
-					std::vector<std::string> subDirs;
-					if (collectSubPath(p, "/*", subDirs))
-					{
-						for (const auto &sp : subDirs)
-						{
-							std::vector<std::string> datFiles;
-							if (collectDataFiles(sp, "*.DAT", datFiles))
-							{
-								for (const auto &dat : datFiles)
-								{
-									int32_t romIndex = pathToIndex(strstr(dat.c_str(), "//ROM"));
-									if (romIndex == -1)
-									{
-										m_delegate->logMessageF(IDelegate::LogLevel::Info, "Ignoring '%s' - invalid filename", dat.c_str());
-										continue;
-									}
-
-									if (m_resolvedPaths.find(romIndex) == m_resolvedPaths.end())
-									{
-										m_delegate->logMessageF(m_logDebug, "emplace %8d : '%s'", romIndex, dat.c_str());
-										m_resolvedPaths.emplace(romIndex, dat);
-									}
-									else
-									{
-										m_delegate->logMessageF(IDelegate::LogLevel::Warn, "WARNING: %8d: ignoring '%s'", romIndex, dat.c_str());
-									}
-								}
-								/* at least one overlay file */
-								res = true;
-							}
-						}
-					}
-				}
+				/* skip "\ROM" */
+				index = redirects.indexOf(PathIndex::romSuffixToIndex(pathClass.lastRomSuffix + 4));
 			}
-
-			std::vector<std::string> soundDirs;
-			if (collectSubPath(basePath, "/sound*", soundDirs))
+			if (index == RedirectTable::npos && pathClass.audioSuffix != nullptr)
 			{
-				for (const auto &p : soundDirs)
-				{
-					std::vector<std::string> sfxDirs;
-					if (collectSubPath(p, "/win/se", "/se*", sfxDirs))
-					{
-						for (const auto &sp : sfxDirs)
-						{
-							std::vector<std::string> sfxFiles;
-							if (collectDataFiles(sp, "*.spw", sfxFiles))
-							{
-								for (auto &sfx : sfxFiles)
-								{
-									std::transform(sfx.begin(), sfx.end(), sfx.begin(), [](unsigned char c) { return std::tolower(c); });
-									int32_t sfxIndex = pathToIndexAudio(&strstr(sfx.c_str(), "/win/se/")[-1]);
-									if (sfxIndex == -1)
-									{
-										m_delegate->logMessageF(IDelegate::LogLevel::Info, "Ignoring '%s' - invalid filename", sfx.c_str());
-										continue;
-									}
-									if (m_resolvedPaths.find(sfxIndex) == m_resolvedPaths.end())
-									{
-										m_delegate->logMessageF(m_logDebug, "emplace %8d : '%s'", sfxIndex, sfx.c_str());
-										m_resolvedPaths.emplace(sfxIndex, sfx);
-									}
-								}
-								res = true;
-							}
-						}
-					}
-
-					std::vector<std::string> bgwFiles;
-					if (collectDataFiles(p, "/win/music/data", "*.bgw", bgwFiles))
-					{
-						for (auto &bgw : bgwFiles)
-						{
-							std::transform(bgw.begin(), bgw.end(), bgw.begin(), [](unsigned char c) { return std::tolower(c); });
-							int32_t bgwIndex = pathToIndexAudio(&strstr(bgw.c_str(), "/win/music/")[-1]);
-							if (bgwIndex == -1)
-							{
-								m_delegate->logMessageF(IDelegate::LogLevel::Info, "Ignoring '%s' - invalid filename", bgw.c_str());
-								continue;
-							}
-							if (m_resolvedPaths.find(bgwIndex) == m_resolvedPaths.end())
-							{
-								m_delegate->logMessageF(m_logDebug, "emplace %8d : '%s'", bgwIndex, bgw.c_str());
-								m_resolvedPaths.emplace(bgwIndex, bgw);
-							}
-							res = true;
-						}
-					}
-				}
+				index = redirects.indexOf(PathIndex::pathToIndexAudio(pathClass.audioSuffix));
 			}
-			return res;
-		}
 
-		bool Redirector::collectSubPath(const std::string &basePath, const std::string &pattern, std::vector<std::string> &results, bool doubleDirSep)
-		{
-			return collectSubPath(basePath, "", pattern, results, doubleDirSep);
+			if (index != RedirectTable::npos)
+			{
+				XIPIVOT_HOOK_LOG(m_delegate, m_logDebug, "using overlay '%s'", redirects.canonicalAt(index));
+				return redirects.canonicalAt(index);
+			}
+			return nullptr;
 		}
 
-		bool Redirector::collectSubPath(const std::string &basePath, const std::string &midPath, const std::string &pattern, std::vector<std::string> &results, bool doubleDirSep)
+		std::string Redirector::resolvePath(int32_t pathKey) const
 		{
-			HANDLE handle;
-			WIN32_FIND_DATAA attrs;
-
-			std::string searchPath = basePath + midPath + pattern;
-		
-			m_delegate->logMessageF(m_logDebug, "'%s', '%s', '%s', '%d' (%s)", basePath.c_str(), midPath.c_str(), pattern.c_str(), doubleDirSep, searchPath.c_str());
-
-			results.clear();
-			handle = Redirector::s_procFindFirstFileA((LPCSTR)searchPath.c_str(), &attrs);
-			if (handle != INVALID_HANDLE_VALUE)
 			{
-				do
+				const SnapshotPointer<RedirectTable>::Reader redirects(m_resolvedPaths);
+				const char *redirect = redirects->find(pathKey);
+				if (redirect != nullptr)
 				{
-					std::string filename = attrs.cFileName;
+					return redirect;
+				}
+			}
 
-					if ((attrs.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 && filename != "." && filename != "..")
-					{
-						if (doubleDirSep)
-						{
-							/* this is only used to keep the same //ROM notation XI uses */
-							m_delegate->logMessageF(m_logDebug, "=> '%s'", (basePath + midPath + "//" + attrs.cFileName).c_str());
-							results.emplace_back(basePath + midPath + "//" + attrs.cFileName);
-						}
-						else
-						{
-							m_delegate->logMessageF(m_logDebug, "=> '%s'", (basePath + midPath + "/" + attrs.cFileName).c_str());
-							results.emplace_back(basePath + midPath + "/" + attrs.cFileName);
-						}
-					}
-				} while (FindNextFileA(handle, &attrs));
+			const std::string gamePath = PathIndex::indexToPath(pathKey);
+			if (gamePath.empty() || m_gamePathKnown == false)
+			{
+				return std::string();
 			}
-			m_delegate->logMessageF(m_logDebug, "results.size() = %d", results.size());
-			return results.size() != 0;
-		}
 
-		bool Redirector::collectDataFiles(const std::string &parentPath, const std::string &pattern, std::vector<std::string> &results)
-		{
-			return collectDataFiles(parentPath, "", pattern, results);
+			std::lock_guard<std::mutex> lock(m_gamePathLock);
+			return m_gamePath + "\\" + gamePath;
 		}
 
-		bool Redirector::collectDataFiles(const std::string &parentPath, const std::string &midPath, const std::string &pattern, std::vector<std::string> &results)
+		void Redirector::recordGamePath(const char *path, const char *romSuffix)
 		{
-			HANDLE handle;
-			WIN32_FIND_DATAA attrs;
-
-			std::string searchPath = parentPath + midPath + "/" + pattern;
-
-			m_delegate->logMessageF(m_logDebug, "'%s', '%s', '%s' => (%s)", parentPath.c_str(), midPath.c_str(), pattern.c_str(), searchPath.c_str());
-
-			results.clear();
-			handle = Redirector::s_procFindFirstFileA((LPCSTR)searchPath.c_str(), &attrs);
-			if (handle != INVALID_HANDLE_VALUE)
+			std::lock_guard<std::mutex> lock(m_gamePathLock);
+			if (m_gamePath.empty())
 			{
-				do
-				{
-					if ((attrs.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
-					{
-						std::string finalPath = parentPath + midPath + "/" + attrs.cFileName;
-						std::transform(finalPath.begin(), finalPath.end(), finalPath.begin(), [](unsigned char c) { return std::toupper(c); });
+				m_gamePath.assign(path, romSuffix);
+				m_gamePathKnown = true;
 
-						m_delegate->logMessageF(m_logDebug, "=> '%s'", finalPath.c_str());
-						results.emplace_back(finalPath);
-					}
-				} while (FindNextFileA(handle, &attrs));
+				XIPIVOT_LOG(m_delegate, m_logDebug, "recordGamePath: '%s'", m_gamePath.c_str());
 			}
-			m_delegate->logMessageF(m_logDebug, "results.size() = %d", results.size());
-			return results.size() != 0;
 		}
 
-		int32_t Redirector::pathToIndex(const char *romPath) const
+		bool Redirector::scanOverlayPath(const std::string &basePath, RedirectTable &redirects)
 		{
-			/* **very** tailored approach to get a fast,
-			 * unique index for every given //ROM* path
-			 *
-			 * it's build on the current ROM layout and
-			 * **will break** if SE ever decides to add
-			 * more than 999 sub folders or 13 ROM roots.
-			 *
-			 * every numeric part of the ROM path will 
-			 * be extracted and added to the romIndex.
-			 * directory separators multiply the number
-			 * by 1000 and ensure the numbers don't collide.
-			 * 
-			 * VTABLE an FTABLE use the base 14000000 and 15000000.
-			 *
-			 * See the following paths and their resulting index:
-			 *
-			 * //ROM/0/0.DAT        =>         0
-			 * //ROM/0/1.DAT        =>         1
-			 * //ROM1/2/3.DAT       =>   1002003
-			 * //ROM1/22/33.DAT     =>   1022033
-			 * //ROM1/222/333.DAT   =>   1222333
-			 * //ROM9/999/999.DAT   =>   9999999
-			 * //ROM10/999/999.DAT  => 109999999
-			 * //ROM10/VTABLE.DAT   => 140000010
-			 * //ROM10/FTABLE.DAT   => 150000010
-			 * - anything invalid - =>        -1
-			 */
-			int32_t romIndex = 0;
-
-			/* start at the first character after "//ROM"
-			 * this is either a digit or '/' in case of the base "//ROM/"
-			 * There is no specific check for paths shorter than 6
-			 * characters, but then again, this method is not called on
-			 * random strings either.
-			 */
-			char *p = (char*)&romPath[5];
-			while (p && *p != '.' && *p != 0)
-			{
-				int subIndex = 0;
-				/* cut out the number and add it to romIndex */
-				for (; p && isdigit(*p); ++p)
-				{
-					subIndex *= 10;
-					subIndex += (*p) - '0';
-				}
+			std::vector<RedirectTable> overlayRedirects;
+			std::vector<char> overlayValid;
 
-				if (*p == '/')
-				{
-					/* skip the '/' and shift the ROM base left */
-					romIndex *= 1000;
-					romIndex += subIndex;
-					++p;
-				}
-				else if (*p == 'V')
-				{
-					/* this is a VTABLE*.DAT */
-					romIndex += 14000000;
-					break;
-				}
-				else if (*p == 'F')
-				{
-					/* this is a FTABLE*.DAT */
-					romIndex += 15000000;
-					break;
-				}
-				else if (*p == '.')
-				{
-					/* break at the start of the file extension */
-					romIndex *= 1000;
-					romIndex += subIndex;
-					break;
-				}
-				else
-				{
-					/* not a path we can handle :( */
-					return -1;
-				}
-			}
-			return romIndex;
+			scanOverlayPaths({ basePath }, overlayRedirects, overlayValid);
+			redirects = std::move(overlayRedirects.front());
+			return overlayValid.front() != 0;
 		}
 
-		int32_t Redirector::pathToIndexAudio(const char *soundPath) const
+		void Redirector::scanOverlayPaths(const std::vector<std::string> &basePaths, std::vector<RedirectTable> &redirects, std::vector<char> &valid)
 		{
-			int32_t soundIndex = 0;
-
-			/* start at the first character after "\\sound"
-			 * this is either a digit or '/' in case of the base directory "\\sound\\"
-			 * There is no specific check for paths shorter than that
-			 * characters, but then again, this method is not called on
-			 * random strings either.
-			 */
-			char *p = (char*)soundPath;
-
-			if (strstr(soundPath, "/win/music/data") == 0 && strstr(soundPath, "\\win\\music\\data") == 0)
-			{
-				/* sound subdir */
-				soundIndex = 20000000;
-
-				/* cut the sound directory number */
-				if (isdigit(soundPath[0]))
-				{
-					soundIndex += (soundPath[0] - '0') * 1000000;
-				}
-
-				if (!isdigit(soundPath[17]) || !isdigit(soundPath[18]) || !isdigit(soundPath[19]) ||
-					!isdigit(soundPath[20]) || !isdigit(soundPath[21]) || !isdigit(soundPath[22]))
-				{
-					return -1;
-				}
-
-				/* cut out the 6 digits of the filename, they contain the subdir anyway 
-				* 9/win/se/seAAA/seAAABBB.spw
-				*/
-				soundIndex += (soundPath[17] - '0') * 100000;
-				soundIndex += (soundPath[18] - '0') * 10000;
-				soundIndex += (soundPath[19] - '0') * 1000;
-				soundIndex += (soundPath[20] - '0') * 100;
-				soundIndex += (soundPath[21] - '0') * 10;
-				soundIndex += (soundPath[22] - '0') * 1;
-			}
-			else
-			{
-				/* music subdir */
-				soundIndex = 30000000;
-
-				/* cut the sound directory number 
-				 * 9\win\music\data\music058.bgw
-				 */
-				if (isdigit(soundPath[0]))
-				{
-					soundIndex += (soundPath[0] - '0') * 1000000;
-				}
-
-				if (!isdigit(soundPath[22]) || !isdigit(soundPath[23]) || !isdigit(soundPath[24]))
-				{
-					return -1;
-				}
-
-				/* cut out the 3 digits of the filename
-				 * 9\win\music\data\music058.bgw
-				 */
-				soundIndex += (soundPath[22] - '0') * 100;
-				soundIndex += (soundPath[23] - '0') * 10;
-				soundIndex += (soundPath[24] - '0') * 1;
-			}
-			return soundIndex;
+			OverlayScanner(*m_fileSystem, m_delegate, m_logDebug).scan(basePaths, redirects, valid);
 		}
 
-
-		bool Redirector::shouldInterceptFOpenS(const char* path)
+		bool Redirector::shouldInterceptFOpenS(const char* path, PathClassifier::Result &pathClass)
 		{
 			if (m_hookFOpenEnabled)
 			{
-				return shouldInterceptPath(path) && m_delegate->runFOpenSHook(path);
+				return shouldInterceptPath(path, pathClass) && m_delegate->runFOpenSHook(path);
 			}
 			return false;
 		}
 
-		bool Redirector::shouldInterceptPath(const char* path)
+		bool Redirector::shouldInterceptPath(const char* path, PathClassifier::Result &pathClass)
 		{
-			return path != nullptr &&
-				(strncmp(path, "\\\\?\\", 4) != 0 || strncmp(path, "\\\\.\\", 4) != 0) &&
-				(
-					strstr(path, "/ROM") != nullptr || strstr(path, "\\ROM") != nullptr 
-					|| strstr(path, "/win/se/") != nullptr || strstr(path, "\\win\\se\\") != nullptr 
-					|| strstr(path, "/win/music/") != nullptr || strstr(path, "\\win\\music\\") != nullptr
-				);
+			/* one pass for "/ROM", "\ROM", "/win/se/", "\win\se\", "/win/music/" and "\win\music\"
+			 * the result is passed on to findRedirect so the path is not searched again.
+			 */
+			pathClass = PathClassifier::classify(path);
+			return pathClass.intercept();
 		}
 	}
 }
@@ -29,12 +29,17 @@
 #pragma once
 
 #include "Delegate.h"
+#include "RedirectTable.h"
+#include "SnapshotPointer.h"
+#include "PathClassifier.h"
+#include "FileSystem.h"
 
 #include <Windows.h>
 
-#include <unordered_map>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <mutex>
 
 namespace XiPivot
 {
@@ -94,25 +99,55 @@ namespace XiPivot
 			/* setup or change the base directory used to search for overlays
 			 * initially this will be set to the processes current working directory
 			 *
-			 * NOTE: *this triggers a re-scan of all overlays*
-			 * NOTE: *use scarcely or before adding overlays*
+			 * NOTE: *changing the path triggers a re-scan of all overlays*
+			 * NOTE: *cached files of every key that resolves to a new path are dropped*
+			 * NOTE: *setting the current path again is a no-op*
 			 */
 			void setRootPath(const std::string &newRoot);
 
 			const std::string& rootPath(void) const { return m_rootPath; }
 
+			/* replace the file system used to enumerate overlays (Win32FileSystem by default)
+			 * fileSystem has to outlive the Redirector, nullptr restores the default.
+			 *
+			 * NOTE: *only affects overlays scanned afterwards*
+			 */
+			void setFileSystem(const IFileSystem *fileSystem);
+
 			/* add a new directory overlay to the back of the priority list */
 			bool addOverlay(const std::string &overlayPath);
 
 			/* remove any previously added overlay from the list
-			*
-			 * NOTE: *this triggers a re-scan of all other overlays*
-			 * NOTE: *use this scarcely if at all*
+			 *
+			 * NOTE: *this only merges the already scanned redirects of all other overlays*
+			 * NOTE: *cached files of the removed overlay are dropped*
 			 */
 			void removeOverlay(const std::string &overlayPath);
 
+			/* move a previously added overlay to a new position in the priority list
+			 * newIndex is zero based, values past the end move the overlay to the back.
+			 *
+			 * NOTE: *this only merges the already scanned redirects of all overlays*
+			 * NOTE: *cached files of every key that changes its winning overlay are dropped*
+			 */
+			bool moveOverlay(const std::string &overlayPath, size_t newIndex);
+
+			/* change the priority of all overlays at once
+			 * overlayPaths has to contain exactly the overlays that are currently active.
+			 *
+			 * NOTE: *this only merges the already scanned redirects of all overlays*
+			 * NOTE: *cached files of every key that changes its winning overlay are dropped*
+			 */
+			bool setOverlayOrder(const std::vector<std::string> &overlayPaths);
+
 			const std::vector<std::string> &overlayList(void) const { return m_overlayPaths; };
 
+			/* hand all redirected DATs to the MemCache prefetch worker
+			 *
+			 * NOTE: *this is done automatically after overlay changes while prefetching is enabled*
+			 */
+			void prefetchRedirects(void) const;
+
 			/* query all active overlays and return a report
 			 * listing all redirects and the overlay they belong to.
 			 * 
@@ -187,8 +222,9 @@ namespace XiPivot
 			 */
 			explicit Redirector(void);
 
-			virtual bool shouldInterceptFOpenS(const char* path);
-			virtual bool shouldInterceptPath(const char* path);
+			/* pathClass receives the markers found in path, it is only valid while path is */
+			virtual bool shouldInterceptFOpenS(const char* path, PathClassifier::Result &pathClass);
+			virtual bool shouldInterceptPath(const char* path, PathClassifier::Result &pathClass);
 
 
 		private:
@@ -197,22 +233,25 @@ namespace XiPivot
 			HANDLE __stdcall interceptFindFirstFileA(LPCSTR a0, LPWIN32_FIND_DATAA a2);
 			errno_t __cdecl  interceptFOpenS(FILE** a0, const char* a1, const char* a2);
 
-			const char *findRedirect(const char *realPath, int32_t &outPathKey, bool &pathRedirected) const;
-			const char *findDenormalisedRedirect(const char *realPath) const;
+			/* both return pointers into `redirects` which remain valid as long as the table is */
+			const char *findRedirect(const RedirectTable &redirects, const char *realPath, const PathClassifier::Result &pathClass, int32_t &outPathKey, bool &pathRedirected) const;
+			/* the same for regular paths, returns the canonical redirect target or nullptr */
+			const char *findCanonicalRedirect(const RedirectTable &redirects, const PathClassifier::Result &pathClass) const;
 
 			/* first-time scan of overlay directories - basically "find all dat paths and record them" */
-			bool scanOverlayPath(const std::string &overlayPath);
-
-			bool collectSubPath(const std::string &basePath, const std::string &pattern, std::vector<std::string> &result, bool doubleDirSep = false);
-			bool collectSubPath(const std::string &basePath, const std::string &midPath, const std::string &pattern, std::vector<std::string> &result, bool doubleDirSep = false);
+			bool scanOverlayPath(const std::string &overlayPath, RedirectTable &redirects);
+			/* the same for a list of overlays, valid[i] is set if overlayPaths[i] contained any data files */
+			void scanOverlayPaths(const std::vector<std::string> &overlayPaths, std::vector<RedirectTable> &redirects, std::vector<char> &valid);
 
-			bool collectDataFiles(const std::string &parentPath, const std::string &pattern, std::vector<std::string> &result);
-			bool collectDataFiles(const std::string &parentPath, const std::string &midPath, const std::string &pattern, std::vector<std::string> &result);
+			/* merge the redirects of all overlays into m_resolvedPaths in priority order */
+			void rebuildRedirects(void);
 
-			/* an actual 32bit integer perfect hash for XI ROM paths >:3 */
-			int32_t pathToIndex(const char *romPath) const;
-			/* and the same for sound / music files */
-			int32_t pathToIndexAudio(const char *soundPath) const;
+			/* the path CreateFileA currently opens for `pathKey`, used as the MemCache PathResolver.
+			 * non-redirected keys need the game directory, which is only known after the first ROM open.
+			 */
+			std::string resolvePath(int32_t pathKey) const;
+			/* remember the game directory in front of a "//ROM" suffix */
+			void recordGamePath(const char *path, const char *romSuffix);
 
 
 			bool                                     m_hooksSet;
@@ -221,7 +260,13 @@ namespace XiPivot
 
 			std::string                              m_rootPath;
 			std::vector<std::string>                 m_overlayPaths;
-			std::unordered_map<int32_t, std::string> m_resolvedPaths;
+			std::vector<RedirectTable>               m_overlayRedirects; // one per entry in m_overlayPaths
+			SnapshotPointer<RedirectTable>           m_resolvedPaths;    // read by the hooks from any thread
+			const IFileSystem*                       m_fileSystem;       // used to enumerate overlays
+
+			mutable std::mutex                       m_gamePathLock;
+			std::string                              m_gamePath;         // the game directory as used by the client
+			std::atomic_bool                         m_gamePathKnown;
 
 			IDelegate::LogLevel                   m_logDebug;
 			IDelegate*                            m_delegate;
@@ -0,0 +1,136 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* an immutable object published through an atomic pointer (read-copy-update)
+		 *
+		 * readers never block: they register with the current epoch, load the pointer
+		 * and are guaranteed the object stays alive until their Reader goes out of scope.
+		 *
+		 * writers replace the whole object, flip the epoch and wait for all readers
+		 * of the previous epoch to leave before the old object is deleted.
+		 * Writers are serialised against each other and expected to be rare.
+		 */
+		template<class T>
+		class SnapshotPointer
+		{
+		public:
+			/* scoped read access to the current object */
+			class Reader
+			{
+			public:
+				explicit Reader(const SnapshotPointer &owner)
+					: m_owner(owner)
+				{
+					while (true)
+					{
+						m_epoch = m_owner.m_epoch.load();
+						m_owner.m_readers[m_epoch & 1].fetch_add(1);
+
+						/* a writer might have flipped the epoch in-between,
+						 * in that case it may already be waiting for the other counter.
+						 */
+						if (m_owner.m_epoch.load() == m_epoch)
+						{
+							break;
+						}
+						m_owner.m_readers[m_epoch & 1].fetch_sub(1);
+					}
+					m_object = m_owner.m_object.load();
+				}
+
+				~Reader(void)
+				{
+					m_owner.m_readers[m_epoch & 1].fetch_sub(1);
+				}
+
+				Reader(const Reader&) = delete;
+				Reader& operator=(const Reader&) = delete;
+
+				const T& operator*(void) const { return *m_object; }
+				const T* operator->(void) const { return m_object; }
+
+			private:
+				const SnapshotPointer &m_owner;
+				const T               *m_object;
+				uint32_t               m_epoch;
+			};
+
+		public:
+			SnapshotPointer(void)
+				: m_object(new T())
+				, m_epoch(0)
+				, m_readers{ {0}, {0} }
+			{
+			}
+
+			~SnapshotPointer(void)
+			{
+				delete m_object.load();
+			}
+
+			SnapshotPointer(const SnapshotPointer&) = delete;
+			SnapshotPointer& operator=(const SnapshotPointer&) = delete;
+
+			/* replace the current object, returns once the old one has been deleted */
+			void publish(T &&object)
+			{
+				std::lock_guard<std::mutex> lock(m_publishLock);
+
+				const T *previous = m_object.exchange(new T(std::move(object)));
+
+				/* new readers register with the new epoch and will see the new object,
+				 * only readers of the old epoch can still be using the previous one.
+				 */
+				const uint32_t epoch = m_epoch.fetch_add(1);
+				while (m_readers[epoch & 1].load() != 0)
+				{
+					std::this_thread::yield();
+				}
+				delete previous;
+			}
+
+		private:
+			std::atomic<const T*>         m_object;
+			std::atomic<uint32_t>         m_epoch;
+			mutable std::atomic<uint32_t> m_readers[2];
+
+			std::mutex                    m_publishLock;
+		};
+	}
+}
@@ -0,0 +1,108 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		/* on-disk format written by HookTracer, kept free of Windows headers
+		 * so offline tools can read it anywhere
+		 *
+		 * a trace file is a TraceFileHeader followed by TraceRecords in the order
+		 * they were flushed - records of different threads are only ordered per thread.
+		 */
+		static constexpr uint32_t sHookTraceMagic = 0x4B484958; // "XIHK"
+		static constexpr uint32_t sHookTraceVersion = 1;
+
+		enum class TraceEvent : uint16_t
+		{
+			CreateFile = 1,
+			FindFirstFile,
+			FOpen,
+			CacheOpen,      /* trackCacheObject, arg: HANDLE */
+			ReadFile,       /* tracked handles only, arg: bytes read */
+			ReadFileEx,     /* tracked handles only, arg: bytes read */
+			SetFilePointer, /* tracked handles only, arg: new offset */
+			CloseHandle,    /* tracked handles only */
+			Dropped,        /* ring buffer overflow, arg: number of records lost */
+		};
+
+		enum TraceFlags : uint16_t
+		{
+			TraceRedirected = 1 << 0, /* the path was redirected to an overlay */
+			TraceCacheHit   = 1 << 1,
+			TraceCacheMiss  = 1 << 2,
+			TraceFromDisk   = 1 << 3, /* served from cache after reading missing chunks */
+			TraceFallback   = 1 << 4, /* passed on to the real API */
+			TraceFailed     = 1 << 5,
+		};
+
+		struct TraceFileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t frequency;    /* QueryPerformanceFrequency */
+			uint64_t startTicks;   /* QueryPerformanceCounter when tracing started */
+		};
+
+		struct TraceRecord
+		{
+			uint64_t ticks;        /* QueryPerformanceCounter at hook entry */
+			uint32_t threadId;
+			uint16_t event;        /* TraceEvent */
+			uint16_t flags;        /* TraceFlags */
+			int32_t  pathKey;      /* -1 if unknown */
+			uint32_t durationUs;   /* hook entry to exit */
+			uint64_t arg;          /* event specific, see TraceEvent */
+		};
+
+		static_assert(sizeof(TraceFileHeader) == 24, "TraceFileHeader layout changed");
+		static_assert(sizeof(TraceRecord) == 32, "TraceRecord layout changed");
+
+		inline const char* traceEventName(uint16_t event)
+		{
+			switch (static_cast<TraceEvent>(event))
+			{
+				case TraceEvent::CreateFile:     return "CreateFileA";
+				case TraceEvent::FindFirstFile:  return "FindFirstFileA";
+				case TraceEvent::FOpen:          return "fopen_s";
+				case TraceEvent::CacheOpen:      return "CacheOpen";
+				case TraceEvent::ReadFile:       return "ReadFile";
+				case TraceEvent::ReadFileEx:     return "ReadFileEx";
+				case TraceEvent::SetFilePointer: return "SetFilePointer";
+				case TraceEvent::CloseHandle:    return "CloseHandle";
+				case TraceEvent::Dropped:        return "Dropped";
+				default:                         return "?";
+			}
+		}
+	}
+}
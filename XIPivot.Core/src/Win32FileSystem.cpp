@@ -0,0 +1,175 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Win32FileSystem.h"
+
+#include <Windows.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace XiPivot
+{
+	namespace Core
+	{
+		namespace
+		{
+			class Win32MappedFile : public IFileSystem::MappedFile
+			{
+			public:
+				Win32MappedFile(HANDLE file, HANDLE mapping, const void *view, size_t size)
+					: m_file(file), m_mapping(mapping), m_view(view), m_size(size) {}
+
+				~Win32MappedFile(void)
+				{
+					UnmapViewOfFile(m_view);
+					CloseHandle(m_mapping);
+					CloseHandle(m_file);
+				}
+
+				const void* data(void) const override { return m_view; }
+				size_t size(void) const override { return m_size; }
+
+			private:
+				HANDLE      m_file;
+				HANDLE      m_mapping;
+				const void* m_view;
+				size_t      m_size;
+			};
+		}
+
+		Win32FileSystem& Win32FileSystem::instance(void)
+		{
+			static Win32FileSystem s_instance;
+			return s_instance;
+		}
+
+		bool Win32FileSystem::listDirectory(const std::string &directory, const std::string &pattern, std::vector<Entry> &entries) const
+		{
+			WIN32_FIND_DATAA attrs;
+
+			/* FindFirstFileExA isn't hooked by the Redirector, it also skips the short names
+			 * and fetches larger batches per call which adds up for directories with thousands of DATs
+			 */
+			const std::string searchPath = directory + "/" + pattern;
+
+			entries.clear();
+			HANDLE handle = FindFirstFileExA(searchPath.c_str(), FindExInfoBasic, &attrs, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+			if (handle != INVALID_HANDLE_VALUE)
+			{
+				do
+				{
+					if (strcmp(attrs.cFileName, ".") != 0 && strcmp(attrs.cFileName, "..") != 0)
+					{
+						entries.push_back({ attrs.cFileName, (attrs.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 });
+					}
+				} while (FindNextFileA(handle, &attrs));
+				FindClose(handle);
+			}
+			return entries.empty() == false;
+		}
+
+		uint64_t Win32FileSystem::lastWriteTime(const std::string &directory) const
+		{
+			WIN32_FILE_ATTRIBUTE_DATA attrs;
+			if (GetFileAttributesExA(directory.c_str(), GetFileExInfoStandard, &attrs) == FALSE ||
+				(attrs.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+			{
+				return 0;
+			}
+			return (static_cast<uint64_t>(attrs.ftLastWriteTime.dwHighDateTime) << 32) | attrs.ftLastWriteTime.dwLowDateTime;
+		}
+
+		std::unique_ptr<IFileSystem::MappedFile> Win32FileSystem::mapFile(const std::string &path) const
+		{
+			/* CreateFileA is hooked by the Redirector, the index is none of its business */
+			const std::wstring widePath = std::filesystem::path(path).wstring();
+			HANDLE file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return nullptr;
+			}
+
+			const DWORD size = GetFileSize(file, nullptr);
+			if (size == INVALID_FILE_SIZE || size == 0)
+			{
+				CloseHandle(file);
+				return nullptr;
+			}
+
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			const void *view = (mapping != nullptr) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			if (view == nullptr)
+			{
+				if (mapping != nullptr)
+				{
+					CloseHandle(mapping);
+				}
+				CloseHandle(file);
+				return nullptr;
+			}
+			return std::make_unique<Win32MappedFile>(file, mapping, view, size);
+		}
+
+		bool Win32FileSystem::replaceFile(const std::string &path, const std::vector<char> &contents) const
+		{
+			/* a unique name next to the target, several processes may rebuild the same index at once
+			 * and MoveFileEx only replaces atomically within a volume
+			 */
+			std::string directory = std::filesystem::path(path).parent_path().string();
+			if (directory.empty())
+			{
+				directory = ".";
+			}
+
+			char tempPath[MAX_PATH];
+			if (GetTempFileNameA(directory.c_str(), "xip", 0, tempPath) == 0)
+			{
+				return false;
+			}
+
+			bool written = false;
+			{
+				std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+				if (out.is_open())
+				{
+					out.write(contents.data(), contents.size());
+					written = out.good();
+				}
+			}
+
+			if (written == false || MoveFileExA(tempPath, path.c_str(), MOVEFILE_REPLACE_EXISTING) == FALSE)
+			{
+				DeleteFileA(tempPath);
+				return false;
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,165 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AsyncDelegate.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace XiPivot::Core;
+
+namespace
+{
+	/* keeps every message, the worker is the only thread delivering while it runs */
+	class RecordingDelegate : public IDelegate
+	{
+	public:
+		void logMessage(LogLevel level, std::string message) override
+		{
+			levels.push_back(level);
+			messages.emplace_back(std::move(message));
+		}
+
+		void logMessageF(LogLevel, const char *, ...) override
+		{
+		}
+
+		std::vector<LogLevel>    levels;
+		std::vector<std::string> messages;
+	};
+}
+
+TEST(AsyncDelegate, FormatsOnTheWorker)
+{
+	RecordingDelegate sink;
+	AsyncDelegate log;
+	log.start(&sink);
+
+	int value = 0;
+	char path[] = "ROM\\1\\2.DAT";
+	const size_t count = 3;
+
+	log.logMessageF(IDelegate::LogLevel::Info, "%s => %d", path, -42);
+	path[0] = 'X';
+	log.logMessageF(IDelegate::LogLevel::Warn, "%zu overlays, %zd, %u, %lld", count, static_cast<ptrdiff_t>(-1), 4000000000u, -5000000000ll);
+	log.logMessageF(IDelegate::LogLevel::Debug, "%p %8.3f %-4s| %*d %c %016llx %%", static_cast<void*>(&value), 3.14159, "ab", 5, 7, 'z', 0xabcdull);
+	log.logMessageF(IDelegate::LogLevel::Info, "%s", static_cast<const char*>(nullptr));
+	log.logMessage(IDelegate::LogLevel::Error, "plain");
+	log.stop();
+
+	char pointer[32];
+	snprintf(pointer, sizeof(pointer), "%p", static_cast<void*>(&value));
+
+	ASSERT_EQ(sink.messages.size(), 5U);
+	EXPECT_EQ(sink.messages[0], "ROM\\1\\2.DAT => -42");
+	EXPECT_EQ(sink.messages[1], "3 overlays, -1, 4000000000, -5000000000");
+	EXPECT_EQ(sink.messages[2], std::string(pointer) + "    3.142 ab  |     7 z 000000000000abcd %");
+	EXPECT_EQ(sink.messages[3], "(null)");
+	EXPECT_EQ(sink.messages[4], "plain");
+
+	EXPECT_EQ(sink.levels[1], IDelegate::LogLevel::Warn);
+	EXPECT_EQ(sink.levels[4], IDelegate::LogLevel::Error);
+}
+
+TEST(AsyncDelegate, DeliversDirectlyWithoutAWorker)
+{
+	RecordingDelegate sink;
+	AsyncDelegate log;
+
+	log.logMessageF(IDelegate::LogLevel::Info, "before %d", 1);
+
+	log.start(&sink);
+	log.stop();
+
+	log.logMessageF(IDelegate::LogLevel::Info, "after %d", 2);
+	log.logMessageF(IDelegate::LogLevel::Discard, "discarded %d", 3);
+
+	ASSERT_EQ(sink.messages.size(), 1U);
+	EXPECT_EQ(sink.messages[0], "after 2");
+}
+
+TEST(AsyncDelegate, TruncatesLongStrings)
+{
+	RecordingDelegate sink;
+	AsyncDelegate log;
+	log.start(&sink);
+
+	const std::string longPath(2000, 'p');
+	log.logMessageF(IDelegate::LogLevel::Info, "%s|%s|%d", longPath.c_str(), "tail", 9);
+	log.logMessage(IDelegate::LogLevel::Info, longPath);
+	log.stop();
+
+	ASSERT_EQ(sink.messages.size(), 2U);
+	EXPECT_EQ(sink.messages[0], std::string(511, 'p') + "||9");
+	EXPECT_EQ(sink.messages[1], std::string(512, 'p'));
+}
+
+TEST(AsyncDelegate, KeepsTheOrderOfEveryThread)
+{
+	RecordingDelegate sink;
+	AsyncDelegate log;
+	log.start(&sink);
+
+	/* fewer messages than the ring holds, none of them can be dropped */
+	static constexpr int sThreads = 4;
+	static constexpr int sMessages = 200;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < sThreads; ++t)
+	{
+		threads.emplace_back([&log, t]()
+		{
+			for (int i = 0; i < sMessages; ++i)
+			{
+				log.logMessageF(IDelegate::LogLevel::Debug, "%d %d", t, i);
+			}
+		});
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+	log.stop();
+
+	ASSERT_EQ(sink.messages.size(), static_cast<size_t>(sThreads * sMessages));
+
+	int next[sThreads] = { 0 };
+	for (const auto &message : sink.messages)
+	{
+		int t = -1;
+		int i = -1;
+		ASSERT_EQ(sscanf(message.c_str(), "%d %d", &t, &i), 2);
+		ASSERT_GE(t, 0);
+		ASSERT_LT(t, sThreads);
+		EXPECT_EQ(i, next[t]++);
+	}
+}
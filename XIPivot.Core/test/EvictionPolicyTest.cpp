@@ -0,0 +1,105 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "EvictionPolicy.h"
+
+#include <gtest/gtest.h>
+
+using XiPivot::Core::EvictionPolicy;
+
+namespace
+{
+	bool anything(int32_t)
+	{
+		return true;
+	}
+}
+
+TEST(EvictionPolicy, CreateByName)
+{
+	EXPECT_STREQ(EvictionPolicy::create("lru")->name(), "lru");
+	EXPECT_STREQ(EvictionPolicy::create("s3fifo")->name(), "s3fifo");
+	EXPECT_EQ(EvictionPolicy::create("random"), nullptr);
+}
+
+TEST(EvictionPolicy, LruEvictsLeastRecentlyOpened)
+{
+	auto policy = EvictionPolicy::create("lru");
+	policy->insert(1, 100);
+	policy->insert(2, 100);
+	policy->insert(3, 100);
+	policy->access(1);
+
+	EXPECT_EQ(policy->victim(anything), 2);
+	EXPECT_EQ(policy->victim([](int32_t key) { return key != 2; }), 3);
+}
+
+TEST(EvictionPolicy, LruDemotedKeyIsNextVictim)
+{
+	auto policy = EvictionPolicy::create("lru");
+	policy->insert(1, 100);
+	policy->insert(2, 100);
+	policy->insert(3, 100);
+
+	policy->demote(3, 25);
+	EXPECT_EQ(policy->victim(anything), 3);
+}
+
+TEST(EvictionPolicy, S3FifoDemotedKeyStaysOnProbation)
+{
+	auto policy = EvictionPolicy::create("s3fifo");
+	policy->insert(1, 100);
+	policy->insert(2, 100);
+
+	/* the first pick comes from the small queue and is remembered as a ghost */
+	const int32_t key = policy->victim(anything);
+	ASSERT_EQ(key, 1);
+
+	/* kept compressed instead: it must neither be a ghost nor skip ahead into the main queue */
+	policy->demote(key, 25);
+	EXPECT_EQ(policy->victim(anything), 1);
+
+	policy->remove(1);
+	policy->insert(1, 100);
+	EXPECT_EQ(policy->victim(anything), 2);
+}
+
+TEST(EvictionPolicy, S3FifoGhostsReturnToMain)
+{
+	auto policy = EvictionPolicy::create("s3fifo");
+	policy->insert(1, 100);
+	policy->insert(2, 100);
+
+	ASSERT_EQ(policy->victim(anything), 1);
+	policy->remove(1);
+
+	/* back while it is remembered, straight into the main queue */
+	policy->insert(1, 100);
+	policy->insert(3, 100);
+	EXPECT_EQ(policy->victim(anything), 2);
+}
@@ -0,0 +1,193 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Lz4Block.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using XiPivot::Core::Lz4Block;
+
+namespace
+{
+	std::vector<uint8_t> compressed(const std::vector<uint8_t> &input)
+	{
+		std::vector<uint8_t> output(Lz4Block::compressBound(input.size()));
+		const size_t size = Lz4Block::compress(input.data(), input.size(), output.data(), output.size());
+		output.resize(size);
+		return output;
+	}
+
+	/* compress, check the result fits the bound and decodes back to `input` */
+	size_t roundTrip(const std::vector<uint8_t> &input)
+	{
+		const auto block = compressed(input);
+		EXPECT_FALSE(block.empty());
+		EXPECT_LE(block.size(), Lz4Block::compressBound(input.size()));
+
+		std::vector<uint8_t> output(input.size());
+		EXPECT_TRUE(Lz4Block::decompress(block.data(), block.size(), output.data(), output.size()));
+		EXPECT_EQ(output, input);
+		return block.size();
+	}
+
+	std::vector<uint8_t> randomBytes(size_t size, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<uint8_t> data(size);
+		for (auto &b : data)
+		{
+			b = static_cast<uint8_t>(rng());
+		}
+		return data;
+	}
+}
+
+TEST(Lz4Block, EmptyInput)
+{
+	EXPECT_EQ(roundTrip({}), 1U);
+}
+
+TEST(Lz4Block, InputShorterThanTheMatchLimit)
+{
+	/* anything up to 12 bytes is written as literals only */
+	for (size_t size = 1; size < 13; ++size)
+	{
+		const std::vector<uint8_t> input(size, 'x');
+		EXPECT_EQ(roundTrip(input), size + 1) << size;
+	}
+}
+
+TEST(Lz4Block, IncompressibleInput)
+{
+	const auto input = randomBytes(0x20000, 1);
+	const size_t size = roundTrip(input);
+
+	EXPECT_GE(size, input.size());
+}
+
+TEST(Lz4Block, LongRunsUseOverlappingMatches)
+{
+	/* a single literal followed by a match with offset 1 covering the rest, both lengths need 255 bytes */
+	const std::vector<uint8_t> zeros(100000, 0);
+	EXPECT_LT(roundTrip(zeros), zeros.size() / 200);
+
+	/* a short period makes every match overlap its own output */
+	std::vector<uint8_t> pattern(70000);
+	for (size_t i = 0; i < pattern.size(); ++i)
+	{
+		pattern[i] = "abc"[i % 3];
+	}
+	EXPECT_LT(roundTrip(pattern), pattern.size() / 200);
+
+	/* literal runs of exactly 15 + 255 bytes need a trailing 0 length byte */
+	auto literals = randomBytes(15 + 255, 2);
+	literals.insert(literals.end(), 64, 'z');
+	roundTrip(literals);
+}
+
+TEST(Lz4Block, OffsetsNearTheLimit)
+{
+	for (const size_t offset : { size_t(0xfffe), size_t(0xffff), size_t(0x10000) })
+	{
+		/* a random block, then its first 1024 bytes again `offset` bytes later */
+		auto input = randomBytes(offset + 1024 + 16, static_cast<uint32_t>(offset));
+		memcpy(&input[offset], &input[0], 1024);
+
+		const size_t size = roundTrip(input);
+		if (offset <= 0xffff)
+		{
+			EXPECT_LT(size, input.size()) << offset;
+		}
+	}
+}
+
+TEST(Lz4Block, CompressFailsWithoutRoom)
+{
+	const auto input = randomBytes(4096, 3);
+	std::vector<uint8_t> output(input.size() / 2);
+
+	EXPECT_EQ(Lz4Block::compress(input.data(), input.size(), output.data(), output.size()), 0U);
+}
+
+TEST(Lz4Block, DecompressRejectsTruncatedInput)
+{
+	std::vector<uint8_t> input(4096);
+	for (size_t i = 0; i < input.size(); ++i)
+	{
+		input[i] = static_cast<uint8_t>(i / 7);
+	}
+	const auto block = compressed(input);
+	ASSERT_FALSE(block.empty());
+
+	std::vector<uint8_t> output(input.size());
+	for (size_t size = 0; size < block.size(); ++size)
+	{
+		EXPECT_FALSE(Lz4Block::decompress(block.data(), size, output.data(), output.size())) << size;
+	}
+}
+
+TEST(Lz4Block, DecompressRejectsWrongOutputSize)
+{
+	const std::vector<uint8_t> input(1000, 'q');
+	const auto block = compressed(input);
+
+	std::vector<uint8_t> output(input.size() + 1);
+	EXPECT_FALSE(Lz4Block::decompress(block.data(), block.size(), output.data(), input.size() - 1));
+	EXPECT_FALSE(Lz4Block::decompress(block.data(), block.size(), output.data(), input.size() + 1));
+}
+
+TEST(Lz4Block, DecompressRejectsCorruptInput)
+{
+	std::vector<uint8_t> output(64);
+
+	/* 'a', then a 20 byte match at offset 1 and five literals */
+	const uint8_t valid[] = { 0x1f, 'a', 0x01, 0x00, 0x01, 0x50, 'b', 'b', 'b', 'b', 'b' };
+	ASSERT_TRUE(Lz4Block::decompress(valid, sizeof(valid), output.data(), 26));
+	EXPECT_EQ(std::string(output.begin(), output.begin() + 26), std::string(21, 'a') + "bbbbb");
+
+	/* offset 0 */
+	const uint8_t zeroOffset[] = { 0x1f, 'a', 0x00, 0x00, 0x01, 0x50, 'b', 'b', 'b', 'b', 'b' };
+	EXPECT_FALSE(Lz4Block::decompress(zeroOffset, sizeof(zeroOffset), output.data(), 26));
+
+	/* offset pointing in front of the output */
+	const uint8_t farOffset[] = { 0x1f, 'a', 0x02, 0x00, 0x01, 0x50, 'b', 'b', 'b', 'b', 'b' };
+	EXPECT_FALSE(Lz4Block::decompress(farOffset, sizeof(farOffset), output.data(), 26));
+
+	/* literal length running past the input */
+	const uint8_t longLiterals[] = { 0xf0, 0xff, 0xff };
+	EXPECT_FALSE(Lz4Block::decompress(longLiterals, sizeof(longLiterals), output.data(), output.size()));
+
+	/* match running past the output */
+	const uint8_t longMatch[] = { 0x1f, 'a', 0x01, 0x00, 0xff, 0x10 };
+	EXPECT_FALSE(Lz4Block::decompress(longMatch, sizeof(longMatch), output.data(), output.size()));
+}
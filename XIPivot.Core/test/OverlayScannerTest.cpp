@@ -0,0 +1,234 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MemoryFileSystem.h"
+#include "OverlayScanner.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace XiPivot::Core;
+
+namespace
+{
+	/* keeps every message, scans only log from the calling thread */
+	class RecordingDelegate : public IDelegate
+	{
+	public:
+		void logMessage(LogLevel, std::string message) override
+		{
+			messages.emplace_back(std::move(message));
+		}
+
+		void logMessageF(LogLevel, const char *fmt, ...) override
+		{
+			char buffer[1024];
+
+			va_list args;
+			va_start(args, fmt);
+			vsnprintf(buffer, sizeof(buffer), fmt, args);
+			va_end(args);
+
+			messages.emplace_back(buffer);
+		}
+
+		bool contains(const std::string &text) const
+		{
+			for (const auto &msg : messages)
+			{
+				if (msg.find(text) != std::string::npos)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		std::vector<std::string> messages;
+	};
+
+	/* counts directory listings to tell an indexed scan from a full one */
+	class CountingFileSystem : public IFileSystem
+	{
+	public:
+		explicit CountingFileSystem(const IFileSystem &fs) : m_fs(fs) {}
+
+		bool listDirectory(const std::string &directory, const std::string &pattern, std::vector<Entry> &entries) const override
+		{
+			++listings;
+			return m_fs.listDirectory(directory, pattern, entries);
+		}
+
+		uint64_t lastWriteTime(const std::string &directory) const override { return m_fs.lastWriteTime(directory); }
+		std::unique_ptr<MappedFile> mapFile(const std::string &path) const override { return m_fs.mapFile(path); }
+		bool replaceFile(const std::string &path, const std::vector<char> &contents) const override { return m_fs.replaceFile(path, contents); }
+
+		mutable std::atomic<size_t> listings = 0;
+
+	private:
+		const IFileSystem &m_fs;
+	};
+
+	const std::string sOverlay = "/pivot/overlays/test";
+
+	class OverlayScannerTest : public ::testing::Test
+	{
+	protected:
+		void SetUp(void) override
+		{
+			m_fs.addFile(sOverlay + "/ROM2/VTABLE2.DAT");
+			m_fs.addFile(sOverlay + "/ROM2/FTABLE2.DAT");
+			m_fs.addFile(sOverlay + "/ROM2/OTHER.DAT");
+			m_fs.addFile(sOverlay + "/ROM2/1/5.DAT");
+			m_fs.addFile(sOverlay + "/ROM2/1/6.DAT");
+			m_fs.addFile(sOverlay + "/ROM2/1/readme.txt");
+			m_fs.addFile(sOverlay + "/ROM/0/1.DAT");
+			m_fs.addFile(sOverlay + "/sound2/win/se/se001/se001002.spw");
+			m_fs.addFile(sOverlay + "/sound/win/music/data/music058.bgw");
+		}
+
+		RedirectTable scan(const IFileSystem &fs, bool expectValid = true)
+		{
+			std::vector<RedirectTable> redirects;
+			std::vector<char> valid;
+
+			m_log.messages.clear();
+			OverlayScanner(fs, &m_log, IDelegate::LogLevel::Debug).scan({ sOverlay }, redirects, valid);
+
+			EXPECT_EQ(redirects.size(), 1U);
+			EXPECT_EQ(valid.size(), 1U);
+			EXPECT_EQ(valid.front() != 0, expectValid);
+			return std::move(redirects.front());
+		}
+
+		MemoryFileSystem  m_fs;
+		RecordingDelegate m_log;
+	};
+}
+
+TEST_F(OverlayScannerTest, CollectsAllDataFiles)
+{
+	const auto redirects = scan(m_fs);
+
+	EXPECT_EQ(redirects.size(), 7U);
+	EXPECT_STREQ(redirects.find(14000002), "/PIVOT/OVERLAYS/TEST//ROM2/VTABLE2.DAT");
+	EXPECT_STREQ(redirects.find(15000002), "/PIVOT/OVERLAYS/TEST//ROM2/FTABLE2.DAT");
+	EXPECT_STREQ(redirects.find(2001005), "/PIVOT/OVERLAYS/TEST//ROM2/1/5.DAT");
+	EXPECT_STREQ(redirects.find(2001006), "/PIVOT/OVERLAYS/TEST//ROM2/1/6.DAT");
+	EXPECT_STREQ(redirects.find(1), "/PIVOT/OVERLAYS/TEST//ROM/0/1.DAT");
+	EXPECT_STREQ(redirects.find(22001002), "/pivot/overlays/test/sound2/win/se/se001/se001002.spw");
+	EXPECT_STREQ(redirects.find(30000058), "/pivot/overlays/test/sound/win/music/data/music058.bgw");
+
+	/* canonical paths always use single backslashes below the overlay */
+	const std::string canonical = redirects.canonicalAt(redirects.indexOf(2001005));
+	EXPECT_NE(canonical.find("test\\ROM2\\1\\5.DAT"), std::string::npos) << canonical;
+
+	EXPECT_TRUE(m_log.contains("WARNING: ignoring invalid DAT (not VTABLE/FTABLE) '/PIVOT/OVERLAYS/TEST//ROM2/OTHER.DAT'"));
+}
+
+TEST_F(OverlayScannerTest, MissingAndEmptyOverlays)
+{
+	MemoryFileSystem fs;
+	fs.addDirectory(sOverlay);
+
+	std::vector<RedirectTable> redirects;
+	std::vector<char> valid;
+	OverlayScanner(fs, &m_log, IDelegate::LogLevel::Discard).scan({ sOverlay, "/pivot/overlays/missing" }, redirects, valid);
+
+	ASSERT_EQ(valid.size(), 2U);
+	EXPECT_EQ(valid[0], 0);
+	EXPECT_EQ(valid[1], 0);
+	EXPECT_TRUE(redirects[0].empty());
+	EXPECT_TRUE(redirects[1].empty());
+
+	/* only the existing overlay gets an index */
+	EXPECT_NE(fs.mapFile(OverlayScanner::indexPath(sOverlay)), nullptr);
+	EXPECT_EQ(fs.mapFile(OverlayScanner::indexPath("/pivot/overlays/missing")), nullptr);
+}
+
+TEST_F(OverlayScannerTest, UnchangedOverlayIsReadFromTheIndex)
+{
+	const auto first = scan(m_fs);
+	ASSERT_NE(m_fs.mapFile(OverlayScanner::indexPath(sOverlay)), nullptr);
+
+	CountingFileSystem counting(m_fs);
+	const auto second = scan(counting);
+
+	EXPECT_EQ(counting.listings.load(), 0U);
+	EXPECT_TRUE(m_log.contains("(indexed)"));
+
+	ASSERT_EQ(second.size(), first.size());
+	for (size_t i = 0; i < first.size(); ++i)
+	{
+		EXPECT_EQ(second.keyAt(i), first.keyAt(i));
+		EXPECT_STREQ(second.pathAt(i), first.pathAt(i));
+		EXPECT_STREQ(second.canonicalAt(i), first.canonicalAt(i));
+	}
+}
+
+TEST_F(OverlayScannerTest, ChangedDataDirectoryIsListedAgain)
+{
+	scan(m_fs);
+	m_fs.addFile(sOverlay + "/ROM2/1/7.DAT");
+
+	CountingFileSystem counting(m_fs);
+	const auto redirects = scan(counting);
+
+	/* the layout is still valid, only ROM2/1 itself is listed again */
+	EXPECT_TRUE(m_log.contains("(indexed)"));
+	EXPECT_EQ(counting.listings.load(), 1U);
+	EXPECT_STREQ(redirects.find(2001007), "/PIVOT/OVERLAYS/TEST//ROM2/1/7.DAT");
+	EXPECT_EQ(redirects.size(), 8U);
+}
+
+TEST_F(OverlayScannerTest, NewDirectoryInvalidatesTheLayout)
+{
+	scan(m_fs);
+	m_fs.addFile(sOverlay + "/ROM2/2/1.DAT");
+
+	const auto redirects = scan(m_fs);
+
+	EXPECT_TRUE(m_log.contains("(rescan)"));
+	EXPECT_STREQ(redirects.find(2002001), "/PIVOT/OVERLAYS/TEST//ROM2/2/1.DAT");
+	EXPECT_EQ(redirects.size(), 8U);
+}
+
+TEST_F(OverlayScannerTest, CorruptIndexIsIgnored)
+{
+	const auto first = scan(m_fs);
+	m_fs.replaceFile(OverlayScanner::indexPath(sOverlay), std::vector<char>(64, 'x'));
+
+	const auto second = scan(m_fs);
+	EXPECT_EQ(second.size(), first.size());
+	EXPECT_TRUE(m_log.contains("(rescan)"));
+}
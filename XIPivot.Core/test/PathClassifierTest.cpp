@@ -0,0 +1,134 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PathClassifier.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+using XiPivot::Core::PathClassifier;
+
+TEST(PathClassifier, NullAndPlainPaths)
+{
+	EXPECT_FALSE(PathClassifier::classify(nullptr).intercept());
+	EXPECT_FALSE(PathClassifier::classify("").intercept());
+	EXPECT_FALSE(PathClassifier::classify("C:\\Windows\\System32\\kernel32.dll").intercept());
+	EXPECT_FALSE(PathClassifier::classify("C:\\Games\\FINAL FANTASY XI\\romance\\readme.txt").intercept());
+}
+
+TEST(PathClassifier, DenormalisedRomPath)
+{
+	const char *path = "C:\\Program Files (x86)\\PlayOnline\\SquareEnix\\FINAL FANTASY XI//ROM2/13/37.DAT";
+	const auto res = PathClassifier::classify(path);
+
+	EXPECT_EQ(res.flags, PathClassifier::RomPath);
+	ASSERT_NE(res.romSuffix, nullptr);
+	EXPECT_STREQ(res.romSuffix, "//ROM2/13/37.DAT");
+	EXPECT_EQ(res.lastRomSuffix, nullptr);
+	EXPECT_EQ(res.audioSuffix, nullptr);
+}
+
+TEST(PathClassifier, RegularRomPath)
+{
+	const char *path = "C:\\Games\\FINAL FANTASY XI\\ROM\\ROM3\\1\\2.DAT";
+	const auto res = PathClassifier::classify(path);
+
+	EXPECT_EQ(res.flags, PathClassifier::RomPath);
+	EXPECT_EQ(res.romSuffix, nullptr);
+	/* the last "\ROM" is the one that starts the data path */
+	ASSERT_NE(res.lastRomSuffix, nullptr);
+	EXPECT_STREQ(res.lastRomSuffix, "\\ROM3\\1\\2.DAT");
+}
+
+TEST(PathClassifier, SoundEffectPath)
+{
+	const char *path = "C:\\Games\\FINAL FANTASY XI\\sound2\\win\\se\\se001\\se001002.spw";
+	const auto res = PathClassifier::classify(path);
+
+	EXPECT_EQ(res.flags, PathClassifier::SoundEffectPath);
+	ASSERT_NE(res.audioSuffix, nullptr);
+	EXPECT_STREQ(res.audioSuffix, "2\\win\\se\\se001\\se001002.spw");
+}
+
+TEST(PathClassifier, MusicPath)
+{
+	const char *path = "C:\\Games\\FINAL FANTASY XI\\sound\\win\\music\\data\\music058.bgw";
+	const auto res = PathClassifier::classify(path);
+
+	EXPECT_EQ(res.flags, PathClassifier::MusicPath);
+	ASSERT_NE(res.audioSuffix, nullptr);
+	EXPECT_STREQ(res.audioSuffix, "d\\win\\music\\data\\music058.bgw");
+}
+
+TEST(PathClassifier, ForwardSlashAudioIsNotRedirected)
+{
+	/* only regular paths are used for sound and music, the flag is set but there is no suffix */
+	const auto res = PathClassifier::classify("C:/Games/FINAL FANTASY XI/sound2/win/se/se001/se001002.spw");
+
+	EXPECT_EQ(res.flags, PathClassifier::SoundEffectPath);
+	EXPECT_EQ(res.audioSuffix, nullptr);
+}
+
+TEST(PathClassifier, MarkersAcrossBlockBoundaries)
+{
+	/* move a ROM marker over every offset of a 16 byte block and against the terminator */
+	for (size_t padding = 0; padding < 48; ++padding)
+	{
+		const std::string path = "C:\\" + std::string(padding, 'x') + "//ROM4/1/2.DAT";
+		const auto res = PathClassifier::classify(path.c_str());
+
+		ASSERT_EQ(res.flags, PathClassifier::RomPath) << "padding " << padding;
+		ASSERT_NE(res.romSuffix, nullptr) << "padding " << padding;
+		EXPECT_STREQ(res.romSuffix, "//ROM4/1/2.DAT") << "padding " << padding;
+	}
+}
+
+#if defined(XIPIVOT_PATH_CLASSIFIER_SSE2)
+TEST(PathClassifier, ScalarAndSSE2Agree)
+{
+	const char *markers[] = { "//ROM2/13/37.DAT", "\\ROM\\1\\2.DAT", "\\sound2\\win\\se\\se001\\se001002.spw",
+	                          "\\sound\\win\\music\\data\\music058.bgw", "/win/se/x", "\\romance\\readme.txt" };
+
+	for (const char *marker : markers)
+	{
+		for (size_t padding = 0; padding < 48; ++padding)
+		{
+			const std::string path = "C:\\" + std::string(padding, 'x') + marker;
+			const auto scalar = PathClassifier::classifyScalar(path.c_str());
+			const auto sse2 = PathClassifier::classifySSE2(path.c_str());
+
+			ASSERT_EQ(scalar.flags, sse2.flags) << path;
+			ASSERT_EQ(scalar.romSuffix, sse2.romSuffix) << path;
+			ASSERT_EQ(scalar.lastRomSuffix, sse2.lastRomSuffix) << path;
+			ASSERT_EQ(scalar.audioSuffix, sse2.audioSuffix) << path;
+		}
+	}
+}
+#endif
@@ -0,0 +1,129 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PathIndex.h"
+
+#include <gtest/gtest.h>
+
+using XiPivot::Core::PathIndex;
+
+TEST(PathIndex, RomPaths)
+{
+	/* the examples from PathIndex::pathToIndex */
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM/0/0.DAT"), 0);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM/0/1.DAT"), 1);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM1/2/3.DAT"), 1002003);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM1/22/33.DAT"), 1022033);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM1/222/333.DAT"), 1222333);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM9/999/999.DAT"), 9999999);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM10/999/999.DAT"), 10999999);
+}
+
+TEST(PathIndex, RomTables)
+{
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM/VTABLE.DAT"), 14000000);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM/FTABLE.DAT"), 15000000);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM2/VTABLE2.DAT"), 14000002);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM2/FTABLE2.DAT"), 15000002);
+}
+
+TEST(PathIndex, RomInvalid)
+{
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM2/1/readme.txt"), -1);
+	EXPECT_EQ(PathIndex::pathToIndex("//ROM2/x1/2.DAT"), -1);
+}
+
+TEST(PathIndex, RomSuffixMatchesDenormalisedPath)
+{
+	/* regular paths start right after "\ROM" and have to end up with the same key */
+	EXPECT_EQ(PathIndex::romSuffixToIndex("2\\1\\5.DAT"), PathIndex::pathToIndex("//ROM2/1/5.DAT"));
+	EXPECT_EQ(PathIndex::romSuffixToIndex("\\0\\1.DAT"), PathIndex::pathToIndex("//ROM/0/1.DAT"));
+	EXPECT_EQ(PathIndex::romSuffixToIndex("3\\VTABLE3.DAT"), PathIndex::pathToIndex("//ROM3/VTABLE3.DAT"));
+}
+
+TEST(PathIndex, SoundEffects)
+{
+	EXPECT_EQ(PathIndex::pathToIndexAudio("2/win/se/se001/se001002.spw"), 22001002);
+	EXPECT_EQ(PathIndex::pathToIndexAudio("2\\win\\se\\se001\\se001002.spw"), 22001002);
+	/* the base "sound" directory has no number */
+	EXPECT_EQ(PathIndex::pathToIndexAudio("d/win/se/se123/se123456.spw"), 20123456);
+	EXPECT_EQ(PathIndex::pathToIndexAudio("2/win/se/se001/seXXX002.spw"), -1);
+}
+
+TEST(PathIndex, Music)
+{
+	EXPECT_EQ(PathIndex::pathToIndexAudio("9/win/music/data/music058.bgw"), 39000058);
+	EXPECT_EQ(PathIndex::pathToIndexAudio("9\\win\\music\\data\\music058.bgw"), 39000058);
+	EXPECT_EQ(PathIndex::pathToIndexAudio("d/win/music/data/music123.bgw"), 30000123);
+	EXPECT_EQ(PathIndex::pathToIndexAudio("9/win/music/data/musicABC.bgw"), -1);
+}
+
+TEST(PathIndex, KeyRangesDontOverlap)
+{
+	EXPECT_LT(PathIndex::pathToIndex("//ROM9/999/999.DAT"), PathIndex::pathToIndex("//ROM/VTABLE.DAT"));
+	EXPECT_LT(PathIndex::pathToIndex("//ROM9/FTABLE9.DAT"), PathIndex::pathToIndexAudio("d/win/se/se000/se000000.spw"));
+	EXPECT_LT(PathIndex::pathToIndexAudio("9/win/se/se999/se999999.spw"), PathIndex::pathToIndexAudio("d/win/music/data/music000.bgw"));
+}
+
+TEST(PathIndex, IndexToPath)
+{
+	EXPECT_EQ(PathIndex::indexToPath(PathIndex::pathToIndex("//ROM/0/1.DAT")), "ROM\\0\\1.DAT");
+	EXPECT_EQ(PathIndex::indexToPath(PathIndex::pathToIndex("//ROM2/13/37.DAT")), "ROM2\\13\\37.DAT");
+	EXPECT_EQ(PathIndex::indexToPath(PathIndex::pathToIndex("//ROM10/999/999.DAT")), "ROM10\\999\\999.DAT");
+	EXPECT_EQ(PathIndex::indexToPath(PathIndex::pathToIndex("//ROM/VTABLE.DAT")), "ROM\\VTABLE.DAT");
+	EXPECT_EQ(PathIndex::indexToPath(PathIndex::pathToIndex("//ROM3/FTABLE3.DAT")), "ROM3\\FTABLE3.DAT");
+	EXPECT_EQ(PathIndex::indexToPath(PathIndex::pathToIndexAudio("2\\win\\se\\se001\\se001002.spw")), "sound2\\win\\se\\se001\\se001002.spw");
+	EXPECT_EQ(PathIndex::indexToPath(PathIndex::pathToIndexAudio("d\\win\\se\\se123\\se123456.spw")), "sound\\win\\se\\se123\\se123456.spw");
+	EXPECT_EQ(PathIndex::indexToPath(PathIndex::pathToIndexAudio("9\\win\\music\\data\\music058.bgw")), "sound9\\win\\music\\data\\music058.bgw");
+	EXPECT_EQ(PathIndex::indexToPath(PathIndex::pathToIndexAudio("d\\win\\music\\data\\music123.bgw")), "sound\\win\\music\\data\\music123.bgw");
+}
+
+TEST(PathIndex, IndexToPathRoundTrip)
+{
+	/* every regular path produced has to map back onto its key */
+	for (const int32_t key : { 0, 1, 2001002, 9999999, 13123456, 14000000, 14000009, 15000004 })
+	{
+		const std::string path = PathIndex::indexToPath(key);
+		ASSERT_EQ(path.compare(0, 3, "ROM"), 0) << key;
+		EXPECT_EQ(PathIndex::romSuffixToIndex(path.c_str() + 3), key) << path;
+	}
+	for (const int32_t key : { 20000000, 22001002, 29999999, 30000000, 39000058 })
+	{
+		const std::string path = PathIndex::indexToPath(key);
+		ASSERT_EQ(path.compare(0, 5, "sound"), 0) << key;
+		EXPECT_EQ(PathIndex::pathToIndexAudio(path.c_str() + 4 + (path[5] != '\\')), key) << path;
+	}
+}
+
+TEST(PathIndex, IndexToPathInvalid)
+{
+	EXPECT_EQ(PathIndex::indexToPath(-1), "");
+	EXPECT_EQ(PathIndex::indexToPath(17000000), "");
+	EXPECT_EQ(PathIndex::indexToPath(31001000), "");
+	EXPECT_EQ(PathIndex::indexToPath(40000000), "");
+}
@@ -0,0 +1,186 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "RedirectTable.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using XiPivot::Core::RedirectTable;
+
+namespace
+{
+	RedirectTable makeTable(const std::vector<int32_t> &keys, const std::string &overlay)
+	{
+		RedirectTable::Builder builder;
+		for (const auto key : keys)
+		{
+			builder.add(key, overlay + "/" + std::to_string(key), overlay + "\\" + std::to_string(key));
+		}
+		return builder.build();
+	}
+}
+
+TEST(RedirectTable, EmptyTable)
+{
+	RedirectTable table;
+
+	EXPECT_TRUE(table.empty());
+	EXPECT_EQ(table.find(0), nullptr);
+	EXPECT_EQ(table.indexOf(-1), RedirectTable::npos);
+	EXPECT_FALSE(table.contains(1234));
+}
+
+TEST(RedirectTable, BuilderRejectsDuplicatesAndInvalidKeys)
+{
+	RedirectTable::Builder builder;
+
+	EXPECT_TRUE(builder.add(42, "first", "first"));
+	EXPECT_FALSE(builder.add(42, "second", "second"));
+	EXPECT_FALSE(builder.add(-1, "invalid", "invalid"));
+	EXPECT_EQ(builder.size(), 1U);
+
+	const auto table = builder.build();
+	EXPECT_EQ(builder.size(), 0U);
+	EXPECT_STREQ(table.find(42), "first");
+}
+
+TEST(RedirectTable, FindHitsAndMisses)
+{
+	/* keys spread over several filter blocks, including neighbours of the ones present */
+	const std::vector<int32_t> keys = { 0, 1, 1023, 1024, 2002003, 14000002, 22001002, 39000058 };
+	const auto table = makeTable(keys, "ovl");
+
+	ASSERT_EQ(table.size(), keys.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		/* entries are kept in key order */
+		EXPECT_EQ(table.keyAt(i), keys[i]);
+		EXPECT_EQ(table.indexOf(keys[i]), i);
+		EXPECT_TRUE(table.contains(keys[i]));
+		EXPECT_EQ(table.find(keys[i]), "ovl/" + std::to_string(keys[i]));
+		EXPECT_EQ(std::string(table.canonicalAt(i)), "ovl\\" + std::to_string(keys[i]));
+	}
+
+	for (const int32_t miss : { -1, 2, 1022, 1025, 2002002, 2002004, 14000000, 39000059, 2147483647 })
+	{
+		EXPECT_FALSE(table.contains(miss)) << miss;
+		EXPECT_EQ(table.find(miss), nullptr) << miss;
+	}
+}
+
+TEST(RedirectTable, MergeKeepsPriorityOrder)
+{
+	std::vector<RedirectTable> tables;
+	tables.emplace_back(makeTable({ 1, 3, 5 }, "high"));
+	tables.emplace_back(makeTable({ 2, 3, 4, 5 }, "mid"));
+	tables.emplace_back(makeTable({ 4, 5, 6 }, "low"));
+
+	const auto merged = RedirectTable::merge(tables);
+
+	ASSERT_EQ(merged.size(), 6U);
+	EXPECT_STREQ(merged.find(1), "high/1");
+	EXPECT_STREQ(merged.find(2), "mid/2");
+	EXPECT_STREQ(merged.find(3), "high/3");
+	EXPECT_STREQ(merged.find(4), "mid/4");
+	EXPECT_STREQ(merged.find(5), "high/5");
+	EXPECT_STREQ(merged.find(6), "low/6");
+	EXPECT_STREQ(merged.canonicalAt(merged.indexOf(6)), "low\\6");
+}
+
+TEST(RedirectTable, MergeReportsShadowedEntries)
+{
+	std::vector<RedirectTable> tables;
+	tables.emplace_back(makeTable({ 1, 3, 5 }, "high"));
+	tables.emplace_back(makeTable({ 2, 3, 4, 5 }, "mid"));
+	tables.emplace_back(makeTable({ 4, 5, 6 }, "low"));
+
+	std::vector<RedirectTable::ShadowedEntry> shadowed;
+	const auto merged = RedirectTable::merge(tables, &shadowed);
+
+	ASSERT_EQ(merged.size(), 6U);
+	ASSERT_EQ(shadowed.size(), 4U);
+	EXPECT_EQ(shadowed[0].key, 3);
+	EXPECT_EQ(shadowed[0].table, 1U);
+	EXPECT_EQ(shadowed[1].key, 4);
+	EXPECT_EQ(shadowed[1].table, 2U);
+	EXPECT_EQ(shadowed[2].key, 5);
+	EXPECT_EQ(shadowed[2].table, 1U);
+	EXPECT_EQ(shadowed[3].key, 5);
+	EXPECT_EQ(shadowed[3].table, 2U);
+}
+
+TEST(RedirectTable, ChangedKeysAfterRemovingAnOverlay)
+{
+	std::vector<RedirectTable> tables;
+	tables.emplace_back(makeTable({ 1, 3, 5 }, "high"));
+	tables.emplace_back(makeTable({ 2, 3, 4 }, "low"));
+
+	const auto before = RedirectTable::merge(tables);
+	tables.erase(tables.begin());
+	const auto after = RedirectTable::merge(tables);
+
+	/* 1 and 5 are gone, 3 falls back to "low" and 2 / 4 are untouched */
+	EXPECT_EQ(RedirectTable::changedKeys(before, after), (std::vector<int32_t>{ 1, 3, 5 }));
+	EXPECT_EQ(RedirectTable::changedKeys(after, before), (std::vector<int32_t>{ 1, 3, 5 }));
+	EXPECT_TRUE(RedirectTable::changedKeys(before, before).empty());
+}
+
+TEST(RedirectTable, ChangedKeysAfterReordering)
+{
+	std::vector<RedirectTable> tables;
+	tables.emplace_back(makeTable({ 1, 2, 3 }, "first"));
+	tables.emplace_back(makeTable({ 2, 3, 4 }, "second"));
+
+	const auto before = RedirectTable::merge(tables);
+	std::swap(tables[0], tables[1]);
+	const auto after = RedirectTable::merge(tables);
+
+	/* only the keys both overlays provide change their winner */
+	EXPECT_EQ(RedirectTable::changedKeys(before, after), (std::vector<int32_t>{ 2, 3 }));
+	EXPECT_STREQ(after.find(2), "second/2");
+}
+
+TEST(RedirectTable, ChangedKeysOfEmptyTables)
+{
+	const auto table = makeTable({ 7, 9 }, "overlay");
+
+	EXPECT_TRUE(RedirectTable::changedKeys(RedirectTable(), RedirectTable()).empty());
+	EXPECT_EQ(RedirectTable::changedKeys(RedirectTable(), table), (std::vector<int32_t>{ 7, 9 }));
+	EXPECT_EQ(RedirectTable::changedKeys(table, RedirectTable()), (std::vector<int32_t>{ 7, 9 }));
+}
+
+TEST(RedirectTable, MergeOfNothing)
+{
+	EXPECT_TRUE(RedirectTable::merge({}).empty());
+
+	std::vector<RedirectTable> tables(3);
+	EXPECT_TRUE(RedirectTable::merge(tables).empty());
+}
@@ -0,0 +1,134 @@
+/*
+ * 	Copyright (c) 2019-2024, Renee Koecher
+ * 	All rights reserved.
+ * 
+ * 	Redistribution and use in source and binary forms, with or without
+ * 	modification, are permitted provided that the following conditions are met :
+ * 
+ * 	* Redistributions of source code must retain the above copyright
+ * 	  notice, this list of conditions and the following disclaimer.
+ * 	* Redistributions in binary form must reproduce the above copyright
+ * 	  notice, this list of conditions and the following disclaimer in the
+ * 	  documentation and/or other materials provided with the distribution.
+ * 	* Neither the name of XIPivot nor the
+ * 	  names of its contributors may be used to endorse or promote products
+ * 	  derived from this software without specific prior written permission.
+ * 
+ * 	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * 	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * 	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * 	DISCLAIMED.IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * 	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * 	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * 	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * 	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * 	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * 	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* offline decoder for the binary hook traces written by XiPivot::Core::HookTracer
+ *
+ * usage: XIPivot.TraceDecode <pivot-hooks.bin> [--csv]
+ */
+
+#include "TraceFormat.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace XiPivot::Core;
+
+namespace
+{
+	std::string flagNames(uint16_t flags)
+	{
+		static const struct { uint16_t flag; const char* name; } names[] = {
+			{ TraceRedirected, "redirected" },
+			{ TraceCacheHit,   "hit" },
+			{ TraceCacheMiss,  "miss" },
+			{ TraceFromDisk,   "disk" },
+			{ TraceFallback,   "fallback" },
+			{ TraceFailed,     "failed" },
+		};
+
+		std::string res;
+		for (const auto& entry : names)
+		{
+			if (flags & entry.flag)
+			{
+				if (res.empty() == false)
+				{
+					res += '|';
+				}
+				res += entry.name;
+			}
+		}
+		return res.empty() ? "-" : res;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || (argc > 2 && strcmp(argv[2], "--csv") != 0))
+	{
+		fprintf(stderr, "usage: %s <pivot-hooks.bin> [--csv]\n", argv[0]);
+		return 1;
+	}
+	const bool csv = (argc > 2);
+
+	FILE* in = fopen(argv[1], "rb");
+	if (in == nullptr)
+	{
+		fprintf(stderr, "unable to open '%s'\n", argv[1]);
+		return 1;
+	}
+
+	TraceFileHeader header;
+	if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != sHookTraceMagic)
+	{
+		fprintf(stderr, "'%s' is not a hook trace\n", argv[1]);
+		fclose(in);
+		return 1;
+	}
+	if (header.version != sHookTraceVersion || header.frequency == 0)
+	{
+		fprintf(stderr, "unsupported trace version %u\n", header.version);
+		fclose(in);
+		return 1;
+	}
+
+	if (csv)
+	{
+		printf("time_ms,thread,event,flags,key,duration_us,arg\n");
+	}
+	else
+	{
+		printf("%12s %8s %-16s %-24s %10s %10s %s\n", "time_ms", "thread", "event", "flags", "key", "dur_us", "arg");
+	}
+
+	TraceRecord record;
+	size_t count = 0;
+	while (fread(&record, sizeof(record), 1, in) == 1)
+	{
+		/* records are flushed per thread, times can step back between threads */
+		const double timeMs = (static_cast<double>(record.ticks) - static_cast<double>(header.startTicks)) * 1000.0 / static_cast<double>(header.frequency);
+		const std::string flags = flagNames(record.flags);
+
+		if (csv)
+		{
+			printf("%.3f,%u,%s,%s,%d,%u,%llu\n", timeMs, record.threadId, traceEventName(record.event), flags.c_str(),
+				record.pathKey, record.durationUs, static_cast<unsigned long long>(record.arg));
+		}
+		else
+		{
+			printf("%12.3f %8u %-16s %-24s %10d %10u %llu\n", timeMs, record.threadId, traceEventName(record.event), flags.c_str(),
+				record.pathKey, record.durationUs, static_cast<unsigned long long>(record.arg));
+		}
+		++count;
+	}
+	fclose(in);
+
+	fprintf(stderr, "%zu records\n", count);
+	return 0;
+}
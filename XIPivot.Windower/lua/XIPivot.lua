@@ -45,6 +45,9 @@ defaults.overlays  = L{}
 defaults.cache_enabled = false
 defaults.cache_size = 0x80000000
 defaults.cache_max_age = 600
+defaults.cache_mode = 'heap'
+defaults.cache_prefetch = false
+defaults.cache_policy = 'lru'
 
 settings = config.load(defaults)
 config.save(settings, 'all')
@@ -54,7 +57,7 @@ require('_XIPivot')
 
 config.register(settings, function(_settings)
 	_XIPivot.disable()
-	_XIPivot.setup_cache(_settings.cache_enabled, _settings.cache_size, _settings.cache_max_age)
+	_XIPivot.setup_cache(_settings.cache_enabled, _settings.cache_size, _settings.cache_max_age, _settings.cache_mode, _settings.cache_prefetch, _settings.cache_policy)
 
 	-- try to unload any active overlays in case this is not the first call
 	for _,overlay in ipairs(_XIPivot.diagnostics()['overlays']) do
@@ -90,7 +93,10 @@ windower.register_event('addon command', function(command, ...)
 		windower.add_to_chat(8, _addon.name .. ' v.' .. _addon.version)
 		windower.add_to_chat(8, '   add overlay_dir - Adds a path to be searched for DAT overlays')
 		windower.add_to_chat(8, '   remove overlay_dir - Removes a path from the DAT overlays')
+		windower.add_to_chat(8, '   move overlay_dir priority - Moves an active overlay to a new priority (0 is the highest)')
 		windower.add_to_chat(8, '   status - Print status and diagnostic info')
+		windower.add_to_chat(8, '   telemetry [reset] - Print (and optionally reset) cache latencies and the most opened files')
+		windower.add_to_chat(8, '   trace start|stop - Start or stop the binary trace of all file operations (pivot-hooks.bin)')
 
 	elseif command == 'add' or command == 'a' then
 		if not args[1] then
@@ -121,6 +127,20 @@ windower.register_event('addon command', function(command, ...)
 		end
 		config.save(settings)
 
+	elseif command == 'move' or command == 'm' then
+		if not args[1] or not tonumber(args[2]) then
+			error('Invalid syntax: //pivot move <relative overlay path> <priority>')
+			return
+		end
+
+		if _XIPivot.move_overlay(args[1], tonumber(args[2])) == true then
+			settings.overlays = L(_XIPivot.diagnostics()['overlays'])
+			config.save(settings)
+			windower.add_to_chat(8, 'moved overlay "' .. args[1] .. '"')
+		else
+			windower.add_to_chat(8, 'failed to move "' .. args[1] .. '"')
+		end
+
 	elseif command == 'status' or command == 's' then
 		local stats = _XIPivot.diagnostics()
 		windower.add_to_chat(127,'- diagnostics')
@@ -132,7 +152,36 @@ windower.register_event('addon command', function(command, ...)
 		windower.add_to_chat(127, '-  root_path: "' .. stats['root_path'] .. '"')
 		windower.add_to_chat(127, '-  overlays :')
 		for prio, path in ipairs(stats['overlays']) do
-			windower.add_to_chat(127, '-      [' .. prio .. ']: ' .. path)
+			windower.add_to_chat(127, '-      [' .. (prio - 1) .. ']: ' .. path)
+		end
+		windower.add_to_chat(127, '-  cache    : ' .. stats['cache_policy'] .. ', ' .. string.format('%.1f', stats['cache_hit_ratio'] * 100) .. '% hits')
+		windower.add_to_chat(127, '-  compressed: ' .. stats['cache_compressed'] .. ' files, ' .. string.format('%.2f', stats['cache_compressed_size'] / 1048576) .. 'mb')
+
+	elseif command == 'telemetry' or command == 't' then
+		local telemetry = _XIPivot.telemetry(args[1] == 'reset')
+		windower.add_to_chat(127,'- cache telemetry')
+		for _, op in ipairs(telemetry['latency']) do
+			windower.add_to_chat(127, string.format('-  %-12s: %d, mean %dus, p50 %dus, p95 %dus, p99 %dus, max %dus',
+				op['name'], op['count'], op['mean'], op['p50'], op['p95'], op['p99'], op['max']))
+		end
+		windower.add_to_chat(127, string.format('-  served      : %.2fmb from cache, %.2fmb from disk', telemetry['bytes_cache'] / 1048576, telemetry['bytes_disk'] / 1048576))
+		for reason, count in pairs(telemetry['evictions']) do
+			windower.add_to_chat(127, string.format('-  evicted     : %d (%s)', count, reason))
+		end
+		for _, key in ipairs(telemetry['top_keys']) do
+			windower.add_to_chat(127, string.format('-  key %-8d: opened %d times', key['key'], key['count']))
+		end
+
+	elseif command == 'trace' then
+		if args[1] ~= 'start' and args[1] ~= 'stop' then
+			error('Invalid syntax: //pivot trace start|stop')
+			return
+		end
+
+		if _XIPivot.hook_trace(args[1] == 'start') == true then
+			windower.add_to_chat(8, 'hook trace ' .. (args[1] == 'start' and 'started' or 'stopped'))
+		else
+			windower.add_to_chat(8, 'failed to start the hook trace')
 		end
 	end
 end)
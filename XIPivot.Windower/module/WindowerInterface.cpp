@@ -28,9 +28,11 @@
 
 #include "WindowerInterface.h"
 #include "MemCache.h"
+#include "HookTracer.h"
 
 #include <ctime>
 #include <cstdio>
+#include <cstring>
 
 namespace
 {
@@ -63,11 +65,15 @@ namespace XiPivot
 
 			{ "add_overlay"    , WindowerInterface::lua_addOverlayPath },
 			{ "remove_overlay" , WindowerInterface::lua_removeOverlayPath },
+			{ "move_overlay"   , WindowerInterface::lua_moveOverlayPath },
+			{ "set_overlay_order", WindowerInterface::lua_setOverlayOrder },
 
 			{ "setup_cache"    , WindowerInterface::lua_setupCache },
 			{ "on_tick"        , WindowerInterface::lua_onTick },
 
 			{ "diagnostics"    , WindowerInterface::lua_getDiagnostics },
+			{ "telemetry"      , WindowerInterface::lua_getTelemetry },
+			{ "hook_trace"     , WindowerInterface::lua_hookTrace },
 
 			{ NULL, NULL }
 		};
@@ -84,15 +90,23 @@ namespace XiPivot
 		if (self->m_cacheConfig.enabled)
 		{
 			Core::MemCache::instance().setCacheAllocation(self->m_cacheConfig.allocation);
+			Core::MemCache::instance().setCacheMode(self->m_cacheConfig.mapped ? Core::MemCache::CacheMode::Mapped : Core::MemCache::CacheMode::Heap);
+			if (self->m_cacheConfig.policy != Core::MemCache::instance().getEvictionPolicy())
+			{
+				Core::MemCache::instance().setEvictionPolicy(Core::EvictionPolicy::create(self->m_cacheConfig.policy));
+			}
 			res &= Core::MemCache::instance().setupHooks();
+			Core::MemCache::instance().setPrefetch(self->m_cacheConfig.prefetch, self->rootPath());
 		}
 		else
 		{
+			Core::MemCache::instance().setPrefetch(false, "");
 			Core::MemCache::instance().releaseHooks();
 			Core::MemCache::instance().setCacheAllocation(0);
 		}
 
 		res &= instance<WindowerInterface>()->setupHooks();
+		self->prefetchRedirects();
 
 		lua_pushboolean(L, res ? TRUE : FALSE);
 		return 1;
@@ -105,11 +119,14 @@ namespace XiPivot
 
 		if (self->m_cacheConfig.enabled)
 		{
+			Core::MemCache::instance().setPrefetch(false, "");
 			res &= Core::MemCache::instance().releaseHooks();
 			Core::MemCache::instance().setCacheAllocation(0);
 		}
 
 		res &= instance<WindowerInterface>()->releaseHooks();
+		Core::HookTracer::instance().stop();
+		self->m_asyncLog.stop();
 
 		lua_pushboolean(L, res ? TRUE : FALSE);
 		return 1;
@@ -124,6 +141,9 @@ namespace XiPivot
 		}
 
 		auto self = instance<WindowerInterface>();
+
+		/* the worker has to be done with m_logOut before it can be closed */
+		self->m_asyncLog.stop();
 		if (self->m_logOut.is_open())
 		{
 			self->m_logOut.flush();
@@ -135,7 +155,8 @@ namespace XiPivot
 			self->m_logOut.open("pivot.log", std::ofstream::out | std::ofstream::app);
 			if (self->m_logOut.is_open())
 			{
-				instance<WindowerInterface>()->setLogProvider(self);
+				self->m_asyncLog.start(self);
+				instance<WindowerInterface>()->setLogProvider(&self->m_asyncLog);
 				instance<WindowerInterface>()->setDebugLog(true);
 			}
 		}
@@ -191,6 +212,42 @@ namespace XiPivot
 		return 0;
 	}
 
+	int WindowerInterface::lua_moveOverlayPath(lua_State *L)
+	{
+		if (lua_gettop(L) != 2 || !lua_isstring(L, 1) || !lua_isnumber(L, 2) || lua_tointeger(L, 2) < 0)
+		{
+			lua_pushstring(L, "invalid arguments, expected `string`,`number` (>= 0)");
+			lua_error(L);
+		}
+		lua_pushboolean(L, instance<WindowerInterface>()->moveOverlay(lua_tostring(L, 1), static_cast<size_t>(lua_tointeger(L, 2))) ? TRUE : FALSE);
+		return 1;
+	}
+
+	int WindowerInterface::lua_setOverlayOrder(lua_State *L)
+	{
+		if (lua_gettop(L) != 1 || !lua_istable(L, 1))
+		{
+			lua_pushstring(L, "a valid table argument is required");
+			lua_error(L);
+		}
+
+		std::vector<std::string> overlayPaths;
+		for (int i = 1; ; ++i)
+		{
+			lua_rawgeti(L, 1, i);
+			if (!lua_isstring(L, -1))
+			{
+				lua_pop(L, 1);
+				break;
+			}
+			overlayPaths.emplace_back(lua_tostring(L, -1));
+			lua_pop(L, 1);
+		}
+
+		lua_pushboolean(L, instance<WindowerInterface>()->setOverlayOrder(overlayPaths) ? TRUE : FALSE);
+		return 1;
+	}
+
 	int WindowerInterface::lua_getDiagnostics(lua_State *L)
 	{
 		/* push a table to hold the diagnostics as a whole */
@@ -213,20 +270,128 @@ namespace XiPivot
 		}
 
 		lua_setfield(L, -2, "overlays");
+
+		const auto stats = Core::MemCache::instance().getCacheStats();
+		lua_pushstring(L, stats.policy);
+		lua_setfield(L, -2, "cache_policy");
+
+		lua_pushnumber(L, stats.policyHitRatio);
+		lua_setfield(L, -2, "cache_hit_ratio");
+
+		lua_pushinteger(L, stats.compressedObjects);
+		lua_setfield(L, -2, "cache_compressed");
+
+		lua_pushinteger(L, stats.compressedSize);
+		lua_setfield(L, -2, "cache_compressed_size");
+		return 1;
+	}
+
+	int WindowerInterface::lua_getTelemetry(lua_State* L)
+	{
+		if (lua_gettop(L) > 1 || (lua_gettop(L) == 1 && !lua_isboolean(L, 1)))
+		{
+			lua_pushstring(L, "invalid arguments, expected [`bool`]");
+			lua_error(L);
+		}
+
+		const auto telemetry = Core::MemCache::instance().getTelemetry(10);
+		if (lua_gettop(L) == 1 && lua_toboolean(L, 1) == TRUE)
+		{
+			Core::MemCache::instance().resetTelemetry();
+		}
+
+		lua_createtable(L, 0, 5);
+
+		lua_createtable(L, static_cast<int>(telemetry.latency.size()), 0);
+		for (size_t i = 0; i < telemetry.latency.size(); ++i)
+		{
+			const auto& latency = telemetry.latency[i];
+
+			lua_createtable(L, 0, 7);
+			lua_pushstring(L, Core::CacheTelemetry::operationName(static_cast<Core::CacheTelemetry::Operation>(i)));
+			lua_setfield(L, -2, "name");
+			lua_pushnumber(L, static_cast<lua_Number>(latency.count));
+			lua_setfield(L, -2, "count");
+			lua_pushnumber(L, static_cast<lua_Number>(latency.meanUs()));
+			lua_setfield(L, -2, "mean");
+			lua_pushnumber(L, static_cast<lua_Number>(latency.percentileUs(0.5)));
+			lua_setfield(L, -2, "p50");
+			lua_pushnumber(L, static_cast<lua_Number>(latency.percentileUs(0.95)));
+			lua_setfield(L, -2, "p95");
+			lua_pushnumber(L, static_cast<lua_Number>(latency.percentileUs(0.99)));
+			lua_setfield(L, -2, "p99");
+			lua_pushnumber(L, static_cast<lua_Number>(latency.maxUs));
+			lua_setfield(L, -2, "max");
+			lua_rawseti(L, -2, static_cast<int>(i) + 1);
+		}
+		lua_setfield(L, -2, "latency");
+
+		lua_pushnumber(L, static_cast<lua_Number>(telemetry.bytesFromCache));
+		lua_setfield(L, -2, "bytes_cache");
+
+		lua_pushnumber(L, static_cast<lua_Number>(telemetry.bytesFromDisk));
+		lua_setfield(L, -2, "bytes_disk");
+
+		lua_createtable(L, 0, static_cast<int>(telemetry.evictions.size()));
+		for (size_t i = 0; i < telemetry.evictions.size(); ++i)
+		{
+			lua_pushinteger(L, telemetry.evictions[i]);
+			lua_setfield(L, -2, Core::CacheTelemetry::evictReasonName(static_cast<Core::CacheTelemetry::EvictReason>(i)));
+		}
+		lua_setfield(L, -2, "evictions");
+
+		lua_createtable(L, static_cast<int>(telemetry.topKeys.size()), 0);
+		int i = 0;
+		for (const auto& key : telemetry.topKeys)
+		{
+			lua_createtable(L, 0, 2);
+			lua_pushinteger(L, key.first);
+			lua_setfield(L, -2, "key");
+			lua_pushinteger(L, key.second);
+			lua_setfield(L, -2, "count");
+			lua_rawseti(L, -2, ++i);
+		}
+		lua_setfield(L, -2, "top_keys");
+		return 1;
+	}
+
+	int WindowerInterface::lua_hookTrace(lua_State* L)
+	{
+		if (lua_gettop(L) != 1 || !lua_isboolean(L, 1))
+		{
+			lua_pushstring(L, "a valid boolean argument is required");
+			lua_error(L);
+		}
+
+		bool res = true;
+		if (lua_toboolean(L, 1) == TRUE)
+		{
+			res = Core::HookTracer::instance().start(instance<WindowerInterface>()->rootPath() + "/pivot-hooks.bin");
+		}
+		else
+		{
+			Core::HookTracer::instance().stop();
+		}
+
+		lua_pushboolean(L, res ? TRUE : FALSE);
 		return 1;
 	}
 
 	int WindowerInterface::lua_setupCache(lua_State* L)
 	{
-		if (lua_gettop(L) != 3 || !lua_isboolean(L, 1) || !lua_isnumber(L, 2) || !lua_isnumber(L, 3))
+		if (lua_gettop(L) < 3 || lua_gettop(L) > 6 || !lua_isboolean(L, 1) || !lua_isnumber(L, 2) || !lua_isnumber(L, 3) ||
+			(lua_gettop(L) >= 4 && !lua_isstring(L, 4)) || (lua_gettop(L) >= 5 && !lua_isboolean(L, 5)) || (lua_gettop(L) == 6 && !lua_isstring(L, 6)))
 		{
-			lua_pushstring(L, "invalid arguments, expected `bool`,`number`,`number`");
+			lua_pushstring(L, "invalid arguments, expected `bool`,`number`,`number`[,`string`[,`bool`[,`string`]]]");
 			lua_error(L);
 		}
 		auto self = instance<WindowerInterface>();
 		self->m_cacheConfig.enabled = lua_toboolean(L, 1) == TRUE;
 		self->m_cacheConfig.allocation = lua_tointeger(L, 2);
 		self->m_cacheConfig.maxAge = lua_tointeger(L, 3);
+		self->m_cacheConfig.mapped = lua_gettop(L) >= 4 && strcmp(lua_tostring(L, 4), "mapped") == 0;
+		self->m_cacheConfig.prefetch = lua_gettop(L) >= 5 && lua_toboolean(L, 5) == TRUE;
+		self->m_cacheConfig.policy = (lua_gettop(L) == 6 && Core::EvictionPolicy::create(lua_tostring(L, 6)) != nullptr) ? lua_tostring(L, 6) : "lru";
 
 		return 0;
 	}
@@ -257,7 +422,7 @@ namespace XiPivot
 		m_logOut << logPrefix(level) << " " << message << std::endl;
 	}
 
-	void WindowerInterface::logMessageF(LogLevel level, std::string fmt, ...)
+	void WindowerInterface::logMessageF(LogLevel level, const char* fmt, ...)
 	{
 		if (level == LogLevel::Discard || m_logOut.is_open() == false)
 		{
@@ -267,7 +432,7 @@ namespace XiPivot
 		char msgBuf[512];
 		va_list args;
 		__crt_va_start(args, fmt);
-		vsnprintf_s(msgBuf, sizeof(msgBuf), fmt.c_str(), args);
+		vsnprintf_s(msgBuf, sizeof(msgBuf), fmt, args);
 		__crt_va_end(args);
 
 		m_logOut << logPrefix(level) << " " << msgBuf << std::endl;
@@ -40,6 +40,7 @@ extern "C"
 
 #include "Redirector.h"
 #include "Delegate.h"
+#include "AsyncDelegate.h"
 
 namespace XiPivot
 {
@@ -99,6 +100,21 @@ namespace XiPivot
 			 */
 			static int lua_removeOverlayPath(lua_State *L);
 
+			/* internally calls Redirector::moveOverlay
+			 *
+			 * arguments: [1] - string: the relative overlay path
+			 * arguments: [2] - number: the new priority of the overlay (0 is the highest)
+			 * returns: a boolean representing the operation result
+			 */
+			static int lua_moveOverlayPath(lua_State *L);
+
+			/* internally calls Redirector::setOverlayOrder
+			 *
+			 * arguments: [1] - table: all active relative overlay paths in the new order
+			 * returns: a boolean representing the operation result
+			 */
+			static int lua_setOverlayOrder(lua_State *L);
+
 			/* collects some of the internal data of the Redirector 
 			 *
 			 * arguments: none
@@ -106,16 +122,44 @@ namespace XiPivot
 			 *  { 
 			 *		"enabled": <boolean>,
 			 *      "root_path": <string>,
-			 *      "overlays": { <string>, <string>, ... }
+			 *      "overlays": { <string>, <string>, ... },
+			 *      "cache_policy": <string>,
+			 *      "cache_hit_ratio": <number>
 			 *  }
 			 */
 			static int lua_getDiagnostics(lua_State *L);
 
+			/* query (and optionally reset) the memory cache telemetry
+			 *
+			 * arguments: [1] - bool (optional): reset the telemetry after reading it
+			 * returns: a table of the following make-up
+			 *  {
+			 *      "latency": { { "name": <string>, "count": <number>, "mean": <number>,
+			 *                     "p50": <number>, "p95": <number>, "p99": <number>, "max": <number> }, ... },
+			 *      "bytes_cache": <number>,
+			 *      "bytes_disk": <number>,
+			 *      "evictions": { <reason>: <number>, ... },
+			 *      "top_keys": { { "key": <number>, "count": <number> }, ... }
+			 *  }
+			 *  all latencies are in microseconds
+			 */
+			static int lua_getTelemetry(lua_State *L);
+
+			/* start or stop the binary trace of all intercepted file operations
+			 *
+			 * arguments: [1] - bool: start tracing to <rootPath>/pivot-hooks.bin (replacing it) or stop
+			 * returns: true if tracing could be started (always true when stopping)
+			 */
+			static int lua_hookTrace(lua_State *L);
+
 			/* configure the internal memory cache for DAT files 
 			 *
 			 * arguments: [1] - bool: set caching enabled / disabled
 			 * arguments: [2] - int: max allowed cache allocation in byte
 			 * arguments: [3] - int: time between cache purges / max unused age (in seconds)
+			 * arguments: [4] - string (optional): "heap" (default) or "mapped"
+			 * arguments: [5] - bool (optional): prefetch files in the background
+			 * arguments: [6] - string (optional): eviction policy, "lru" (default) or "s3fifo"
 			 * returns: none
 			 */
 			static int lua_setupCache(lua_State *L);
@@ -129,7 +173,7 @@ namespace XiPivot
 
 			/* IDelegate */
 			virtual void logMessage(LogLevel level, std::string message) override;
-			virtual void logMessageF(LogLevel level, std::string fmt, ...) override;
+			virtual void logMessageF(LogLevel level, const char* fmt, ...) override;
 
 		private:
 			/* local backup of the cache state */
@@ -138,12 +182,18 @@ namespace XiPivot
 				bool   enabled = false; /* cache state */
 
 				size_t allocation;  /* max allocation size in bytes*/
+				bool   mapped;      /* use memory-mapped cache objects */
+				bool   prefetch;    /* run the background prefetch worker */
+				std::string policy; /* name of the eviction policy */
 
 				time_t maxAge;      /* max time in seconds between purges / max object age */
 				time_t nextPurge;   /* timestamp of the next purge */
 			} m_cacheConfig;
 
 			std::ofstream m_logOut;
+
+			/* writes to m_logOut in the background, hooks only queue their messages */
+			Core::AsyncDelegate m_asyncLog;
 	};
 }
 